@@ -356,7 +356,8 @@ static void PaletteEffect(FrameT *frame, PaletteT *src, PaletteT *dst) {
 
     src = src->next;
   }
-  
+
+  PaletteChanged(dst);
   LoadPalette(dst);
 }
 
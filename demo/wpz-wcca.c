@@ -141,8 +141,12 @@ void SetupResources() {
   ResAdd("ColorFunc", NewColorFunc());
   ResAdd("EffectPal", NewPalette(256));
 
-  ResAdd("WeCanBg1Img", NewPixBuf(PIXBUF_CLUT, WIDTH, HEIGHT));
-  PixBufBlit(R_("WeCanBg1Img"), 0, 0, R_("WeCanBgImg"), NULL);
+  {
+    RectT rect = { 0, 0, WIDTH, HEIGHT };
+
+    /* Left part of the background, used as a layer without copying it. */
+    ResAdd("WeCanBg1Img", NewPixBufView(R_("WeCanBgImg"), &rect));
+  }
 
   {
     MeshT *mesh = R_("PotatoMesh");
@@ -11,6 +11,7 @@ static const int DEPTH = 8;
 static PixBufT *canvas;
 static PixBufT *buffer;
 static PixBufT *image;
+static BlurBufferT *scratch;
 
 static void Load() {
   LoadPngImage(&image, NULL, "data/samkaat-absinthe.png");
@@ -23,6 +24,7 @@ static void UnLoad() {
 static void Init() {
   canvas = NewPixBuf(PIXBUF_CLUT, WIDTH, HEIGHT);
   buffer = NewPixBuf(PIXBUF_CLUT, WIDTH, HEIGHT);
+  scratch = NewBlurBuffer(WIDTH, 1);
 
   InitDisplay(WIDTH, HEIGHT, DEPTH);
 }
@@ -32,6 +34,7 @@ static void Kill() {
 
   MemUnref(canvas);
   MemUnref(buffer);
+  MemUnref(scratch);
 }
 
 static bool init = true;
@@ -45,7 +48,7 @@ static void Render(int frameNumber) {
   }
 
   if (effect == 0)
-    BlurV3(canvas, buffer);
+    BlurV3(canvas, buffer, scratch);
   if (effect == 1)
     BlurH3(canvas, buffer);
 
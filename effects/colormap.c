@@ -1,6 +1,7 @@
 #include "std/fastmath.h"
 #include "std/math.h"
 #include "gfx/blit.h"
+#include "gfx/colormap.h"
 #include "gfx/png.h"
 #include "tools/gradient.h"
 
@@ -20,8 +21,8 @@ static PaletteT *imagePal;
 
 static void Load() {
   LoadPngImage(&image, &imagePal, "data/samkaat-absinthe.png");
-  LoadPngImage(&darken, NULL, "data/samkaat-absinthe-darken.png");
-  LoadPngImage(&lighten, NULL, "data/samkaat-absinthe-lighten.png");
+  darken = NewColorMapCached(imagePal, COLORMAP_DARKEN, "data");
+  lighten = NewColorMapCached(imagePal, COLORMAP_LIGHTEN, "data");
 }
 
 static void UnLoad() {
@@ -1,9 +1,9 @@
 #include <math.h>
 
 
-#include "gfx/blit.h"
 #include "gfx/spline.h"
 #include "gfx/line.h"
+#include "gfx/sprite.h"
 #include "tools/curves.h"
 #include "txtgen/procedural.h"
 
@@ -21,6 +21,9 @@ const int FLARES = 6;
 static PointT *points;
 static PixBufT *flare;
 static PixBufT *canvas;
+static SpriteBatchT *sprites;
+static PointT *position;
+static uint8_t *image;
 static SplineT *splineX;
 static SplineT *splineY;
 
@@ -29,11 +32,17 @@ static void Init() {
 
   canvas = NewPixBuf(PIXBUF_CLUT, WIDTH, HEIGHT);
   PixBufClear(canvas);
+  PixBufEnableDirty(canvas);
 
   flare = NewPixBuf(PIXBUF_GRAY, 32, 32);
   GeneratePixels(flare, (GenPixelFuncT)LightNormalFalloff, &lightRadius);
   PixBufSetBlitMode(flare, BLIT_ADDITIVE_CLIP);
 
+  sprites = NewSpriteBatch(WIDTH, HEIGHT, FLARES);
+  SpriteBatchSetImage(sprites, 0, flare);
+  position = NewTable(PointT, FLARES);
+  image = NewTable(uint8_t, FLARES);
+
   splineX = NewSpline(4, TRUE);
   splineY = NewSpline(4, TRUE);
   splineX->knots[0].value = 64;
@@ -58,6 +67,9 @@ static void Kill() {
   MemUnref(points);
   MemUnref(flare);
   MemUnref(canvas);
+  MemUnref(sprites);
+  MemUnref(position);
+  MemUnref(image);
   MemUnref(splineX);
   MemUnref(splineY);
 }
@@ -66,7 +78,7 @@ static int curve = 8;
 static const int lastCurve = 9;
 
 static void Render(int frameNumber) {
-  PixBufClear(canvas);
+  PixBufEraseDirty(canvas, NULL);
 
   {
     float t = (float)frameNumber / CYCLEFRAMES;
@@ -133,17 +145,15 @@ static void Render(int frameNumber) {
       DrawLine(canvas, points[i-1].x, points[i-1].y, points[i].x, points[i].y);
     }
 
-    for (i = 2; i < FLARES; i++) {
-      size_t p = SEGMENTS * i / (FLARES - 1);
+    for (i = 2; i < FLARES; i++)
+      position[i - 2] = points[SEGMENTS * i / (FLARES - 1)];
 
-      PixBufBlit(canvas, 
-                 points[p].x - flare->width / 2,
-                 points[p].y - flare->height / 2,
-                 flare, NULL);
-    }
+    SpriteBatchReset(sprites);
+    SpriteBatchAdd(sprites, position, image, NULL, FLARES - 2);
+    SpriteBatchRender(sprites, canvas);
   }
 
-  c2p1x1_8_c5_bm(canvas->data, GetCurrentBitMap(), WIDTH, HEIGHT, 0, 0);
+  C2PDirty(canvas, GetCurrentBitMap(), NULL);
 }
 
 static void HandleEvent(InputEventT *event) {
@@ -3,6 +3,7 @@
 #include "engine/ms3d.h"
 #include "engine/object.h"
 #include "engine/scene.h"
+#include "engine/simplify.h"
 #include "gfx/png.h"
 #include "system/input.h"
 
@@ -13,10 +14,28 @@ const int HEIGHT = 256;
 const int DEPTH = 8;
 
 static PixBufT *canvas;
+static PixBufT *texture;
 static SceneT *scene;
 static MeshT *mesh;
 static PaletteT *palette;
 
+/* Gathered for each render mode and reported when the effect is killed. */
+typedef struct RenderStats {
+  int frames;
+  float polygons;
+  /* edges set up for rasterization vs. all edges of the mesh */
+  float edgeScans, edges;
+  /* span buffer only, pixels covered by polygons vs. pixels written */
+  float pixelsIn, pixelsOut;
+} RenderStatsT;
+
+static const char *RenderModeName[] = {
+  "wireframe", "antialiased wireframe", "filled", "flat shading",
+  "gouraud shading", "span buffer", "texture mapping"
+};
+
+static RenderStatsT Stats[RENDER_TEXTURE_MAPPING + 1];
+
 static void Load() {
 #if 0
   ResAdd("Mesh", NewMeshFromFile("data/shattered_ball.robj"));
@@ -29,7 +48,11 @@ static void Load() {
 
   CalculateSurfaceNormals(mesh);
   NormalizeMeshSize(mesh);
+  CalculateVertexNormals(mesh);
+  CalculateSphericalMapping(mesh);
   MeshApplyPalette(mesh, palette);
+  MeshGenerateLOD(mesh, 3);
+  QuantizeMesh(mesh);
 
   RenderMode = RENDER_GOURAUD_SHADING;
   RenderAllFaces = false;
@@ -40,20 +63,67 @@ static void UnLoad() {
 }
 
 static void Init() {
+  SceneObjectT *object;
+
   canvas = NewPixBuf(PIXBUF_CLUT, WIDTH, HEIGHT);
   PixBufClear(canvas);
 
+  /* Checkerboard made of first two surface colors. */
+  texture = NewPixBuf(PIXBUF_CLUT, 64, 64);
+  {
+    uint8_t c0 = mesh->surface[0].color.clut;
+    uint8_t c1 = mesh->surface[1 % mesh->surfaceNum].color.clut;
+    int x, y;
+
+    for (y = 0; y < 64; y++)
+      for (x = 0; x < 64; x++)
+        PutPixel(texture, x, y, ((x ^ y) & 8) ? c0 : c1);
+  }
+
+  object = NewSceneObject("Object", mesh);
+  object->texture = texture;
+
   scene = NewScene();
-  SceneAddObject(scene, NewSceneObject("Object", mesh));
+  SceneAddObject(scene, object);
 
   InitDisplay(WIDTH, HEIGHT, DEPTH);
   LoadPalette(palette);
 }
 
+static void LogStats() {
+  int i;
+
+  for (i = 0; i <= RENDER_TEXTURE_MAPPING; i++) {
+    RenderStatsT *stats = &Stats[i];
+
+    if (!stats->frames)
+      continue;
+
+    LOG("Rendered %d frames in %s mode, %d polygons per frame.",
+        stats->frames, RenderModeName[i],
+        (int)(stats->polygons / stats->frames));
+
+    if (stats->edgeScans > 0.0f)
+      LOG("Set up %d of %d edges per frame (saved %d).",
+          (int)(stats->edgeScans / stats->frames),
+          (int)(stats->edges / stats->frames),
+          (int)((stats->edges - stats->edgeScans) / stats->frames));
+
+    if (stats->pixelsOut > 0.0f)
+      LOG("Span buffer wrote %d of %d pixels per frame (overdraw %.2f).",
+          (int)(stats->pixelsOut / stats->frames),
+          (int)(stats->pixelsIn / stats->frames),
+          stats->pixelsIn / stats->pixelsOut);
+  }
+}
+
 static void Kill() {
   KillDisplay();
 
+  LogStats();
+
   MemUnref(canvas);
+  MemUnref(texture);
   MemUnref(scene);
 }
 
@@ -75,8 +145,31 @@ static void Render(int frameNumber_) {
   RenderFlatShading = true;
   PixBufSetColorMap(canvas, R_("ColorMap"), -32);
 #endif
-  PROFILE(RenderScene)
-    RenderScene(scene, canvas);
+  if (RenderMode == RENDER_SPAN_BUFFER) {
+    PROFILE(RenderSpanBuffer)
+      RenderScene(scene, canvas);
+  } else if (RenderMode == RENDER_FLAT_SHADING) {
+    PROFILE(RenderFlatShading)
+      RenderScene(scene, canvas);
+  } else {
+    PROFILE(RenderScene)
+      RenderScene(scene, canvas);
+  }
+
+  {
+    SceneObjectT *object = GetObject(scene, "Object");
+    RenderStatsT *stats = &Stats[RenderMode];
+
+    stats->frames++;
+    stats->polygons += object->polygonCount;
+    stats->edgeScans += object->edgeScanCount;
+    stats->edges += object->lodMesh->edgeNum;
+
+    if (RenderMode == RENDER_SPAN_BUFFER) {
+      stats->pixelsIn += object->scratch->spanBuffer->pixelsIn;
+      stats->pixelsOut += object->scratch->spanBuffer->pixelsOut;
+    }
+  }
 
   c2p1x1_8_c5_bm(canvas->data, GetCurrentBitMap(), WIDTH, HEIGHT, 0, 0);
 }
@@ -98,7 +191,7 @@ static void HandleEvent(InputEventT *event) {
 
   if (KEY_RELEASED(event, KEY_RETURN)) {
     RenderMode++;
-    if (RenderMode > 4)
+    if (RenderMode > RENDER_TEXTURE_MAPPING)
       RenderMode = 0;
 
     if (RenderMode < RENDER_FILLED)
@@ -106,6 +199,9 @@ static void HandleEvent(InputEventT *event) {
     else
       RenderAllFaces = false;
   }
+
+  if (KEY_RELEASED(event, KEY_B))
+    RenderBinned = !RenderBinned;
 }
 
 EffectT Effect = { "Object3D", Load, UnLoad, Init, Kill, Render, HandleEvent };
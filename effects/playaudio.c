@@ -1,6 +1,7 @@
 #include "std/math.h"
 #include "audio/stream.h"
 #include "gfx/blit.h"
+#include "gfx/colormap.h"
 #include "gfx/line.h"
 #include "gfx/palette.h"
 #include "gfx/png.h"
@@ -28,7 +29,7 @@ static AudioStreamT *audio;
 
 static void Load() {
   LoadPngImage(&image, &imagePal, "data/samkaat-absinthe.png");
-  LoadPngImage(&darken, NULL, "data/samkaat-absinthe-darken.png");
+  darken = NewColorMapCached(imagePal, COLORMAP_DARKEN, "data");
   audio = AudioStreamOpen("data/chembro.wav");
 }
 
@@ -0,0 +1,65 @@
+#include <math.h>
+
+#include "gfx/affine.h"
+#include "gfx/ms2d.h"
+#include "gfx/palette.h"
+#include "gfx/png.h"
+
+#include "startup.h"
+
+const int WIDTH = 320;
+const int HEIGHT = 256;
+const int DEPTH = 8;
+
+static PixBufT *canvas;
+static PixBufT *texture;
+static PaletteT *texturePal;
+static MatrixStack2D *ms;
+static AffineEdgeT edge = AFFINE_WRAP;
+
+static void Load() {
+  LoadPngImage(&texture, &texturePal, "data/texture.png");
+}
+
+static void UnLoad() {
+  MemUnref(texture);
+  MemUnref(texturePal);
+}
+
+static void Init() {
+  canvas = NewPixBuf(PIXBUF_CLUT, WIDTH, HEIGHT);
+  ms = NewMatrixStack2D();
+
+  InitDisplay(WIDTH, HEIGHT, DEPTH);
+  LoadPalette(texturePal);
+}
+
+static void Kill() {
+  KillDisplay();
+
+  MemUnref(ms);
+  MemUnref(canvas);
+}
+
+static void Render(int frameNumber) {
+  float zoom = 1.25f + sin(frameNumber * 3.14159265f / 90.0f);
+
+  /* Maps screen into texture, so it's built in reverse order. */
+  StackReset(ms);
+  PushTranslation2D(ms, -WIDTH / 2, -HEIGHT / 2);
+  PushRotation2D(ms, (float)frameNumber);
+  PushScaling2D(ms, zoom, zoom);
+  PushTranslation2D(ms, 2.0f * frameNumber, frameNumber);
+
+  PROFILE(PixBufBlitAffine)
+    PixBufBlitAffine(canvas, texture, GetMatrix2D(ms, 0), edge);
+  PROFILE(C2P)
+    c2p1x1_8_c5_bm(canvas->data, GetCurrentBitMap(), WIDTH, HEIGHT, 0, 0);
+}
+
+static void HandleEvent(InputEventT *event) {
+  if (KEY_RELEASED(event, KEY_RIGHT) || KEY_RELEASED(event, KEY_LEFT))
+    edge = (edge == AFFINE_WRAP) ? AFFINE_CLAMP : AFFINE_WRAP;
+}
+
+EffectT Effect = { "RotoZoom", Load, UnLoad, Init, Kill, Render, HandleEvent };
@@ -114,6 +114,8 @@ static void PaletteEffect(int frameNumber, PaletteT *src, PaletteT *dst,
       HSL2RGB(&hsl, &dst->colors[i]);
     }
 
+    PaletteChanged(dst);
+
     src = src->next;
     dst = dst->next;
     func++;
@@ -0,0 +1,107 @@
+#include "engine/clipping.h"
+
+static inline void Lerp(ClipVertexT *d, ClipVertexT *a, ClipVertexT *b,
+                        float t)
+{
+  d->x = a->x + (b->x - a->x) * t;
+  d->y = a->y + (b->y - a->y) * t;
+  d->z = a->z + (b->z - a->z) * t;
+  d->u = a->u + (b->u - a->u) * t;
+  d->v = a->v + (b->v - a->v) * t;
+  d->c = a->c + (b->c - a->c) * t;
+}
+
+/*
+ * In screen space u / z' and v / z' (where z' is the real depth) change
+ * linearly, so they have to be multiplied by inverse depth before
+ * interpolation and divided afterwards.
+ */
+static inline void LerpPerspective(ClipVertexT *d, ClipVertexT *a,
+                                   ClipVertexT *b, float t)
+{
+  float az = a->z, bz = b->z;
+  float z = az + (bz - az) * t;
+
+  d->x = a->x + (b->x - a->x) * t;
+  d->y = a->y + (b->y - a->y) * t;
+  d->z = z;
+  d->u = (a->u * az + (b->u * bz - a->u * az) * t) / z;
+  d->v = (a->v * az + (b->v * bz - a->v * az) * t) / z;
+  d->c = a->c + (b->c - a->c) * t;
+}
+
+int ClipPolygonNear(ClipVertexT *dst, ClipVertexT *src, int n, float near) {
+  ClipVertexT *prev = &src[n - 1];
+  int i, m = 0;
+
+  for (i = 0; i < n; prev = &src[i++]) {
+    ClipVertexT *cur = &src[i];
+    bool prevIn = prev->z <= near;
+    bool curIn = cur->z <= near;
+
+    if (prevIn != curIn)
+      Lerp(&dst[m++], prev, cur, (near - prev->z) / (cur->z - prev->z));
+
+    if (curIn)
+      dst[m++] = *cur;
+  }
+
+  return m;
+}
+
+typedef enum { CLIP_LEFT, CLIP_TOP, CLIP_RIGHT, CLIP_BOTTOM } ClipEdgeT;
+
+static inline float Distance(ClipVertexT *p, ClipEdgeT edge, float limit) {
+  switch (edge) {
+    case CLIP_LEFT:
+      return p->x - limit;
+    case CLIP_TOP:
+      return p->y - limit;
+    case CLIP_RIGHT:
+      return limit - p->x;
+    default:
+      return limit - p->y;
+  }
+}
+
+/* One step of Sutherland-Hodgman algorithm. */
+static int ClipPolygonEdge(ClipVertexT *dst, ClipVertexT *src, int n,
+                           ClipEdgeT edge, float limit)
+{
+  ClipVertexT *prev = &src[n - 1];
+  float prevDist = Distance(prev, edge, limit);
+  int i, m = 0;
+
+  for (i = 0; i < n; i++) {
+    ClipVertexT *cur = &src[i];
+    float curDist = Distance(cur, edge, limit);
+
+    if ((prevDist >= 0.0f) != (curDist >= 0.0f))
+      LerpPerspective(&dst[m++], prev, cur, prevDist / (prevDist - curDist));
+
+    if (curDist >= 0.0f)
+      dst[m++] = *cur;
+
+    prev = cur;
+    prevDist = curDist;
+  }
+
+  return m;
+}
+
+int ClipPolygon2D(ClipVertexT *dst, ClipVertexT *src, int n,
+                  float xmin, float ymin, float xmax, float ymax)
+{
+  ClipVertexT tmp[CLIP_MAX];
+
+  n = ClipPolygonEdge(tmp, src, n, CLIP_LEFT, xmin);
+  if (n < 3)
+    return 0;
+  n = ClipPolygonEdge(dst, tmp, n, CLIP_TOP, ymin);
+  if (n < 3)
+    return 0;
+  n = ClipPolygonEdge(tmp, dst, n, CLIP_RIGHT, xmax);
+  if (n < 3)
+    return 0;
+  return ClipPolygonEdge(dst, tmp, n, CLIP_BOTTOM, ymax);
+}
@@ -0,0 +1,30 @@
+#ifndef __ENGINE_CLIPPING_H__
+#define __ENGINE_CLIPPING_H__
+
+#include "std/types.h"
+
+/*
+ * Polygon vertex with attributes that are interpolated while clipping.  Before
+ * projection (x, y, z) are view space coordinates.  After projection (x, y)
+ * are screen coordinates and z is the inverse depth.
+ */
+typedef struct ClipVertex {
+  float x, y, z;
+  float u, v;
+  float c;
+} ClipVertexT;
+
+/* Maximum number of vertices a clipped triangle can have. */
+#define CLIP_MAX 9
+
+/* Keeps the part of polygon in front of the plane z = near (i.e. z <= near). */
+int ClipPolygonNear(ClipVertexT *dst, ClipVertexT *src, int n, float near);
+
+/*
+ * Clips projected polygon to given rectangle.  Texture coordinates are
+ * interpolated in perspective correct way, shade is interpolated linearly.
+ */
+int ClipPolygon2D(ClipVertexT *dst, ClipVertexT *src, int n,
+                  float xmin, float ymin, float xmax, float ymax);
+
+#endif
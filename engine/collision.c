@@ -0,0 +1,42 @@
+#include "engine/collision.h"
+
+void PlaneActorInit(CollisionActorT *actor, PlaneT *plane) {
+  actor->object = plane;
+  actor->distance = (DistanceFuncT)PointDistanceFromPlane;
+  actor->bound = NULL;
+}
+
+void SphereActorInit(CollisionActorT *actor, SphereT *sphere) {
+  actor->object = sphere;
+  actor->distance = (DistanceFuncT)PointDistanceFromSphere;
+  actor->bound = sphere;
+}
+
+bool DetectCollision(CollisionActorT *actor,
+                     Vector3D *before, Vector3D *after)
+{
+  float d0 = actor->distance(actor->object, before);
+  float d1 = actor->distance(actor->object, after);
+
+  /*
+   * Landing exactly on the surface counts as crossing it, while leaving it
+   * does not, so a particle resting on the surface is not hit again.
+   */
+  if (d0 > 0.0f)
+    return BOOL(d1 <= 0.0f);
+  if (d0 < 0.0f)
+    return BOOL(d1 >= 0.0f);
+  return false;
+}
+
+CollisionActorT *FindCollision(CollisionActorT *actors, size_t num,
+                               Vector3D *before, Vector3D *after)
+{
+  size_t i;
+
+  for (i = 0; i < num; i++)
+    if (DetectCollision(&actors[i], before, after))
+      return &actors[i];
+
+  return NULL;
+}
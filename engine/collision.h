@@ -1,14 +1,29 @@
 #ifndef __ENGINE_COLLISION_H__
 #define __ENGINE_COLLISION_H__
 
+#include "std/types.h"
+#include "engine/plane.h"
+#include "engine/sphere.h"
+
+/* Signed distance, negative values are inside of the object. */
 typedef float (*DistanceFuncT)(PtrT object, Vector3D *point);
 
 typedef struct CollisionActor {
   PtrT object;
-  DistanceFuncT *distance;
+  DistanceFuncT distance;
+  /* NULL for unbounded objects, i.e. planes */
+  SphereT *bound;
 } CollisionActorT;
 
+void PlaneActorInit(CollisionActorT *actor, PlaneT *plane);
+void SphereActorInit(CollisionActorT *actor, SphereT *sphere);
+
+/* Checks if a point moving from before to after crosses actor's surface. */
 bool DetectCollision(CollisionActorT *actor,
                      Vector3D *before, Vector3D *after);
 
+/* Returns the first actor that is hit by moving point or NULL. */
+CollisionActorT *FindCollision(CollisionActorT *actors, size_t num,
+                               Vector3D *before, Vector3D *after);
+
 #endif
@@ -0,0 +1,216 @@
+#include <string.h>
+
+#include "std/debug.h"
+#include "std/memory.h"
+#include "engine/hashgrid.h"
+
+/* Cell ranges with more buckets than that are handled by linear scan. */
+#define MAX_BUCKETS 64
+
+static void DeleteHashGrid(HashGridT *self) {
+  MemUnref(self->first);
+  MemUnref(self->index);
+  MemUnref(self->bucket);
+}
+
+TYPEDECL(HashGridT, (FreeFuncT)DeleteHashGrid);
+
+HashGridT *NewHashGrid(float cellSize, size_t buckets) {
+  HashGridT *self = NewInstance(HashGridT);
+  size_t n = 1;
+
+  while (n < buckets)
+    n <<= 1;
+
+  self->cellSize = cellSize;
+  self->invCellSize = 1.0f / cellSize;
+  self->mask = n - 1;
+  self->first = NewTable(uint32_t, n + 1);
+
+  return self;
+}
+
+/* Rounds towards negative infinity, unlike conversion to integer. */
+static inline int CellCoord(HashGridT *self, float v) {
+  float f = v * self->invCellSize;
+  int c = (int)f;
+
+  return (f < c) ? c - 1 : c;
+}
+
+static inline uint32_t CellHash(HashGridT *self, int x, int y, int z) {
+  return (((uint32_t)x * 73856093U) ^ ((uint32_t)y * 19349663U) ^
+          ((uint32_t)z * 83492791U)) & self->mask;
+}
+
+void HashGridBuild(HashGridT *self, Vector3D *point, size_t num) {
+  uint32_t *first = self->first;
+  size_t buckets = self->mask + 1;
+  size_t i, total = 0;
+
+  if (!self->index || TableSize(self->index) < num) {
+    MemUnref(self->index);
+    MemUnref(self->bucket);
+    self->index = NewTable(uint32_t, num);
+    self->bucket = NewTable(uint32_t, num);
+  }
+
+  self->point = point;
+  self->pointNum = num;
+
+  memset(first, 0, sizeof(uint32_t) * (buckets + 1));
+
+  for (i = 0; i < num; i++) {
+    uint32_t b = CellHash(self, CellCoord(self, point[i].x),
+                          CellCoord(self, point[i].y),
+                          CellCoord(self, point[i].z));
+
+    self->bucket[i] = b;
+    first[b + 1]++;
+  }
+
+  for (i = 1; i <= buckets; i++) {
+    total += first[i];
+    first[i] = total;
+  }
+
+  /* Counting sort, first[b] ends up pointing at the end of bucket b. */
+  for (i = 0; i < num; i++)
+    self->index[first[self->bucket[i]]++] = i;
+
+  /* ... so shift it back by one bucket. */
+  memmove(first + 1, first, sizeof(uint32_t) * buckets);
+  first[0] = 0;
+}
+
+/*
+ * Different cells may hash into the same bucket, which must be visited only
+ * once.  Returns zero if there are too many of them.
+ */
+static size_t CollectBuckets(HashGridT *self, Vector3D *center, float radius,
+                             uint32_t *bucket)
+{
+  int x0 = CellCoord(self, center->x - radius);
+  int y0 = CellCoord(self, center->y - radius);
+  int z0 = CellCoord(self, center->z - radius);
+  int x1 = CellCoord(self, center->x + radius);
+  int y1 = CellCoord(self, center->y + radius);
+  int z1 = CellCoord(self, center->z + radius);
+  size_t n = 0;
+  int x, y, z;
+
+  if ((x1 - x0 + 1) * (y1 - y0 + 1) * (z1 - z0 + 1) > MAX_BUCKETS)
+    return 0;
+
+  for (z = z0; z <= z1; z++) {
+    for (y = y0; y <= y1; y++) {
+      for (x = x0; x <= x1; x++) {
+        uint32_t b = CellHash(self, x, y, z);
+        size_t i;
+
+        for (i = 0; i < n; i++)
+          if (bucket[i] == b)
+            break;
+
+        if (i == n)
+          bucket[n++] = b;
+      }
+    }
+  }
+
+  return n;
+}
+
+static inline bool IsWithin(Vector3D *a, Vector3D *b, float radius2) {
+  float dx = a->x - b->x;
+  float dy = a->y - b->y;
+  float dz = a->z - b->z;
+
+  return dx * dx + dy * dy + dz * dz < radius2;
+}
+
+size_t HashGridQuery(HashGridT *self, Vector3D *center, float radius,
+                     uint32_t *result, size_t maxResults)
+{
+  uint32_t bucket[MAX_BUCKETS];
+  size_t buckets = CollectBuckets(self, center, radius, bucket);
+  float radius2 = radius * radius;
+  size_t i, hits = 0;
+
+  /* Without buckets all points are scanned as if they were in a single one. */
+  for (i = 0; i < max(buckets, 1); i++) {
+    size_t k = buckets ? self->first[bucket[i]] : 0;
+    size_t end = buckets ? self->first[bucket[i] + 1] : self->pointNum;
+
+    for (; k < end; k++) {
+      uint32_t j = buckets ? self->index[k] : k;
+
+      if (IsWithin(&self->point[j], center, radius2)) {
+        if (hits < maxResults)
+          result[hits] = j;
+        hits++;
+      }
+    }
+  }
+
+  return hits;
+}
+
+void HashGridForEachPair(HashGridT *self, float radius,
+                         HashGridPairFuncT func, PtrT data)
+{
+  float radius2 = radius * radius;
+  size_t i;
+
+  ASSERT(radius <= self->cellSize,
+         "Radius %f is greater than cell size %f.", radius, self->cellSize);
+
+  for (i = 0; i < self->pointNum; i++) {
+    Vector3D *p = &self->point[i];
+    uint32_t bucket[MAX_BUCKETS];
+    size_t buckets = CollectBuckets(self, p, radius, bucket);
+    size_t b;
+
+    for (b = 0; b < buckets; b++) {
+      size_t k = self->first[bucket[b]];
+      size_t end = self->first[bucket[b] + 1];
+
+      for (; k < end; k++) {
+        uint32_t j = self->index[k];
+
+        if (j > i && IsWithin(&self->point[j], p, radius2))
+          func(data, i, j);
+      }
+    }
+  }
+}
+
+size_t HashGridCollide(HashGridT *self, CollisionActorT *actor,
+                       Vector3D *center, float radius, Vector3D *after,
+                       uint32_t *result, size_t maxResults)
+{
+  uint32_t bucket[MAX_BUCKETS];
+  size_t buckets = CollectBuckets(self, center, radius, bucket);
+  float radius2 = radius * radius;
+  size_t i, hits = 0;
+
+  /* Without buckets all points are scanned as if they were in a single one. */
+  for (i = 0; i < max(buckets, 1); i++) {
+    size_t k = buckets ? self->first[bucket[i]] : 0;
+    size_t end = buckets ? self->first[bucket[i] + 1] : self->pointNum;
+
+    for (; k < end; k++) {
+      uint32_t j = buckets ? self->index[k] : k;
+
+      if (IsWithin(&self->point[j], center, radius2) &&
+          DetectCollision(actor, &self->point[j], &after[j]))
+      {
+        if (hits < maxResults)
+          result[hits] = j;
+        hits++;
+      }
+    }
+  }
+
+  return hits;
+}
@@ -0,0 +1,56 @@
+#ifndef __ENGINE_HASHGRID_H__
+#define __ENGINE_HASHGRID_H__
+
+#include "std/types.h"
+#include "engine/collision.h"
+
+/*
+ * Uniform grid of cubic cells, that are hashed into a fixed number of
+ * buckets, so the space doesn't have to be bounded.  Points are sorted by
+ * bucket each time the grid is built, hence there's no allocation per frame.
+ * Queries work best if their radius is not greater than the cell size.
+ */
+typedef struct HashGrid {
+  float cellSize;
+  float invCellSize;
+  uint32_t mask;
+
+  /* points from the last build, not owned */
+  Vector3D *point;
+  size_t pointNum;
+
+  /* points in bucket i are index[first[i]] .. index[first[i+1]-1] */
+  uint32_t *first;
+  uint32_t *index;
+  uint32_t *bucket;
+} HashGridT;
+
+typedef void (*HashGridPairFuncT)(PtrT data, size_t i, size_t j);
+
+/* Number of buckets is rounded up to a power of two. */
+HashGridT *NewHashGrid(float cellSize, size_t buckets);
+
+void HashGridBuild(HashGridT *self, Vector3D *point, size_t num);
+
+/*
+ * Stores indices of points within radius from center in result.  Returns the
+ * number of all such points, so if it's greater than maxResults some were not
+ * stored.
+ */
+size_t HashGridQuery(HashGridT *self, Vector3D *center, float radius,
+                     uint32_t *result, size_t maxResults);
+
+/* Calls func once for each pair of points closer than radius. */
+void HashGridForEachPair(HashGridT *self, float radius,
+                         HashGridPairFuncT func, PtrT data);
+
+/*
+ * Particle vs. object queries: points that cross actor's surface moving to
+ * position given in after[] are stored in result.  Returns the number of all
+ * such points, so if it's greater than maxResults some were not stored.
+ */
+size_t HashGridCollide(HashGridT *self, CollisionActorT *actor,
+                       Vector3D *center, float radius, Vector3D *after,
+                       uint32_t *result, size_t maxResults);
+
+#endif
@@ -0,0 +1,109 @@
+#include "std/debug.h"
+#include "std/fastmath.h"
+#include "std/memory.h"
+#include "engine/light.h"
+
+LightSetT DefaultLightSet = {
+  1, 0.0f, {{ LIGHT_DIRECTIONAL, { 0.0f, 0.0f, 1.0f }, 1.0f, 0.0f }}
+};
+
+LightSetT *NewLightSet(float ambient) {
+  LightSetT *self = NewRecord(LightSetT);
+
+  self->ambient = ambient;
+
+  return self;
+}
+
+static LightT *LightSetAdd(LightSetT *self, LightTypeT type,
+                           float x, float y, float z, float intensity)
+{
+  LightT *light;
+
+  ASSERT(self->count < LIGHT_MAX, "Too many lights (max %d).", LIGHT_MAX);
+
+  light = &self->light[self->count++];
+  light->type = type;
+  light->vector.x = x;
+  light->vector.y = y;
+  light->vector.z = z;
+  light->intensity = intensity;
+
+  return light;
+}
+
+LightT *LightSetAddDirectional(LightSetT *self, float x, float y, float z,
+                               float intensity)
+{
+  LightT *light = LightSetAdd(self, LIGHT_DIRECTIONAL, x, y, z, intensity);
+
+  V3D_NormalizeToUnit(&light->vector, &light->vector);
+
+  return light;
+}
+
+LightT *LightSetAddPoint(LightSetT *self, float x, float y, float z,
+                         float intensity, float radius)
+{
+  LightT *light = LightSetAdd(self, LIGHT_POINT, x, y, z, intensity);
+
+  light->radius = radius;
+
+  return light;
+}
+
+__regargs static float
+LightIntensity(LightSetT *self, Vector3D *normal, Vector3D *position) {
+  float intensity = self->ambient;
+  Vector3D n = *normal;
+  int i;
+
+  if (n.z < 0.0f)
+    V3D_Scale(&n, &n, -1.0f);
+
+  for (i = 0; i < self->count; i++) {
+    LightT *light = &self->light[i];
+
+    if (light->type == LIGHT_DIRECTIONAL) {
+      float cosine = V3D_Dot(&n, &light->vector);
+
+      if (cosine > 0.0f)
+        intensity += cosine * light->intensity;
+    } else {
+      Vector3D l;
+      float cosine;
+
+      V3D_Sub(&l, &light->vector, position);
+
+      cosine = V3D_Dot(&n, &l);
+
+      if (cosine > 0.0f) {
+        float invDist = FastInvSqrt(V3D_Dot(&l, &l));
+        float k = cosine * invDist * light->intensity;
+
+        if (light->radius > 0.0f) {
+          float fade = 1.0f - 1.0f / (invDist * light->radius);
+
+          k = (fade > 0.0f) ? k * fade : 0.0f;
+        }
+
+        intensity += k;
+      }
+    }
+  }
+
+  return intensity;
+}
+
+void LightSetShade(LightSetT *self, uint8_t *shade, Vector3D *normal,
+                   Vector3D *position, uint16_t *index, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    size_t k = index ? index[i] : i;
+    int value = (int)(LightIntensity(self, &normal[k], &position[k]) * 255.0f);
+
+    shade[k] = (value > 255) ? 255 : value;
+  }
+}
@@ -0,0 +1,51 @@
+#ifndef __ENGINE_LIGHT_H__
+#define __ENGINE_LIGHT_H__
+
+#include "engine/vector3d.h"
+
+#define LIGHT_MAX 4
+
+typedef enum { LIGHT_DIRECTIONAL, LIGHT_POINT } LightTypeT;
+
+/*
+ * Lights are given in view space, i.e. they don't move with objects.  For
+ * directional light the vector points towards the light source, for point
+ * light it's the position of the source.
+ */
+typedef struct Light {
+  LightTypeT type;
+  Vector3D vector;
+  float intensity;
+  /* point light doesn't reach further than that (zero means infinity) */
+  float radius;
+} LightT;
+
+typedef struct LightSet {
+  size_t count;
+  float ambient;
+  LightT light[LIGHT_MAX];
+} LightSetT;
+
+LightSetT *NewLightSet(float ambient);
+
+LightT *LightSetAddDirectional(LightSetT *self, float x, float y, float z,
+                               float intensity);
+LightT *LightSetAddPoint(LightSetT *self, float x, float y, float z,
+                         float intensity, float radius);
+
+/*
+ * Evaluates all lights in a single pass over given elements (all n of them if
+ * index is NULL, otherwise the ones listed in index).  Normals must be unit
+ * vectors; those facing away from the viewer are flipped, so both sides of a
+ * surface are lit.  Intensity is clamped and quantized to [0, 255] range.
+ */
+void LightSetShade(LightSetT *self, uint8_t *shade, Vector3D *normal,
+                   Vector3D *position, uint16_t *index, size_t n);
+
+/*
+ * Single directional light along view axis, that is what the renderer used
+ * before lights were introduced.
+ */
+extern LightSetT DefaultLightSet;
+
+#endif
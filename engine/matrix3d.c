@@ -130,6 +130,87 @@ void Transform3D_2(Vector3D *dst, Vector3D *src, int n, Matrix3D *m) {
   }
 }
 
+bool IsAffine3D(Matrix3D *m) {
+  return (M(m,0,3) == 0.0f && M(m,1,3) == 0.0f &&
+          M(m,2,3) == 0.0f && M(m,3,3) == 1.0f);
+}
+
+/* 36 multiplications instead of 64 for the general case. */
+void MultiplyAffine3D(Matrix3D *d, Matrix3D *a, Matrix3D *b) {
+  int i, j;
+
+  for (i = 0; i < 4; i++) {
+    float a0 = M(a,i,0);
+    float a1 = M(a,i,1);
+    float a2 = M(a,i,2);
+
+    for (j = 0; j < 3; j++)
+      M(d,i,j) = a0 * M(b,0,j) + a1 * M(b,1,j) + a2 * M(b,2,j);
+  }
+
+  for (j = 0; j < 3; j++)
+    M(d,3,j) += M(b,3,j);
+
+  M(d,0,3) = 0.0f;
+  M(d,1,3) = 0.0f;
+  M(d,2,3) = 0.0f;
+  M(d,3,3) = 1.0f;
+}
+
+void LoadAffine3D(Affine3D *d, Matrix3D *m) {
+  int i, j;
+
+  for (i = 0; i < 3; i++)
+    for (j = 0; j < 4; j++)
+      (*d)[i][j] = M(m,j,i);
+}
+
+/*
+ * Coefficients are kept in local variables, so they're not reloaded after
+ * each store to destination, which may alias the matrix as far as the
+ * compiler knows.
+ */
+void TransformAffine3D(Vector3D *dst, Vector3D *src, int n, Affine3D *m) {
+  float *c = &(*m)[0][0];
+  float m00 = c[0], m10 = c[1], m20 = c[2],  m30 = c[3];
+  float m01 = c[4], m11 = c[5], m21 = c[6],  m31 = c[7];
+  float m02 = c[8], m12 = c[9], m22 = c[10], m32 = c[11];
+
+  while (--n >= 0) {
+    float x = src->x;
+    float y = src->y;
+    float z = src->z;
+
+    dst->x = m00 * x + m10 * y + m20 * z + m30;
+    dst->y = m01 * x + m11 * y + m21 * z + m31;
+    dst->z = m02 * x + m12 * y + m22 * z + m32;
+
+    src++;
+    dst++;
+  }
+}
+
+void TransformNormalsAffine3D(Vector3D *dst, Vector3D *src, int n,
+                              Affine3D *m)
+{
+  float *c = &(*m)[0][0];
+  float m00 = c[0], m10 = c[1], m20 = c[2];
+  float m01 = c[4], m11 = c[5], m21 = c[6];
+  float m02 = c[8], m12 = c[9], m22 = c[10];
+
+  while (--n >= 0) {
+    float x = src->x;
+    float y = src->y;
+    float z = src->z;
+
+    dst->x = m00 * x + m10 * y + m20 * z;
+    dst->y = m01 * x + m11 * y + m21 * z;
+    dst->z = m02 * x + m12 * y + m22 * z;
+
+    src++;
+    dst++;
+  }
+}
 
 /*
  * Lightwave coordinate system:
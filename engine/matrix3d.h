@@ -5,6 +5,13 @@
 
 typedef float Matrix3D[4][4];
 
+/*
+ * Affine part of Matrix3D stored transposed, i.e. each row holds the
+ * coefficients for one output coordinate followed by translation.  Batched
+ * kernels read it sequentially.
+ */
+typedef float Affine3D[3][4];
+
 Matrix3D *NewMatrix3D();
 
 void Multiply3D(Matrix3D *d, Matrix3D *a, Matrix3D *b);
@@ -18,6 +25,14 @@ void LoadPerspective3D(Matrix3D *d,
                        float viewerX, float viewerY, float viewerZ);
 void Transform3D(Vector3D *dst, Vector3D *src, int n, Matrix3D *m);
 void Transform3D_2(Vector3D *dst, Vector3D *src, int n, Matrix3D *m);
+
+/* Both matrices must have the last column set to (0, 0, 0, 1). */
+bool IsAffine3D(Matrix3D *m);
+void MultiplyAffine3D(Matrix3D *d, Matrix3D *a, Matrix3D *b);
+void LoadAffine3D(Affine3D *d, Matrix3D *m);
+void TransformAffine3D(Vector3D *dst, Vector3D *src, int n, Affine3D *m);
+void TransformNormalsAffine3D(Vector3D *dst, Vector3D *src, int n,
+                              Affine3D *m);
 void ProjectTo2D(Vector3D *dst, Vector3D *src, int n,
                  float viewerX, float viewerY, float viewerZ);
 void LoadCameraFromVector(Matrix3D *camera,
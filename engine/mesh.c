@@ -13,10 +13,25 @@ static void DeleteSurface(SurfaceT *surface) {
 TYPEDECL(SurfaceT, (FreeFuncT)DeleteSurface);
 
 static void DeleteMesh(MeshT *mesh) {
+  size_t i;
+
+  for (i = 0; i < mesh->morphNum; i++) {
+    MemUnref(mesh->morph[i].name);
+    MemUnref(mesh->morph[i].index);
+    MemUnref(mesh->morph[i].delta);
+  }
+
+  MemUnref(mesh->morph);
+  MemUnref(mesh->lod);
   MemUnref(mesh->vertexToPoly.vertex);
   MemUnref(mesh->vertexToPoly.indices);
+  MemUnref(mesh->edge);
   MemUnref(mesh->surfaceNormal);
   MemUnref(mesh->vertexNormal);
+  MemUnref(mesh->texCoord);
+  MemUnref(mesh->qVertex);
+  MemUnref(mesh->qSurfaceNormal);
+  MemUnref(mesh->qVertexNormal);
   MemUnref(mesh->surface);
   MemUnref(mesh->polygon);
   MemUnref(mesh->vertex);
@@ -55,8 +70,6 @@ typedef struct DiskSurface {
   char name[0];
 } DiskSurfaceT;
 
-static void MeshCalculateEdges(MeshT *mesh);
-
 MeshT *NewMeshFromFile(const char *fileName) {
   DiskMeshT *header = ReadFileSimple(fileName);
 
@@ -132,7 +145,7 @@ __regargs static bool EdgeCmp(const PtrT a, const PtrT b) {
     return (e1->p[0] < e2->p[0]);
 }
 
-static void MeshCalculateEdges(MeshT *mesh) {
+void MeshCalculateEdges(MeshT *mesh) {
   TriangleEdgeT *edges = NewTable(TriangleEdgeT, mesh->polygonNum * 3);
   int i, j;
 
@@ -260,6 +273,22 @@ void NormalizeMeshSize(MeshT *mesh) {
  * "The vertex list for each polygon should begin at a convex vertex and
  * proceed clockwise as seen from the visible side of the polygon."
  */
+static void CalculateSurfaceNormal(Vector3D *normal, TriangleT *polygon,
+                                   Vector3D *vertex)
+{
+  Vector3D u, v;
+
+  size_t p1 = polygon->p[0];
+  size_t p2 = polygon->p[1];
+  size_t p3 = polygon->p[2];
+
+  V3D_Sub(&u, &vertex[p1], &vertex[p2]);
+  V3D_Sub(&v, &vertex[p2], &vertex[p3]);
+
+  V3D_Cross(normal, &u, &v);
+  V3D_NormalizeToUnit(normal, normal);
+}
+
 void CalculateSurfaceNormals(MeshT *mesh) {
   size_t i;
 
@@ -268,20 +297,9 @@ void CalculateSurfaceNormals(MeshT *mesh) {
 
   mesh->surfaceNormal = NewTable(Vector3D, mesh->polygonNum);
 
-  for (i = 0; i < mesh->polygonNum; i++) {
-    Vector3D *normal = &mesh->surfaceNormal[i];
-    Vector3D u, v;
-
-    size_t p1 = mesh->polygon[i].p[0];
-    size_t p2 = mesh->polygon[i].p[1];
-    size_t p3 = mesh->polygon[i].p[2];
-
-    V3D_Sub(&u, &mesh->vertex[p1], &mesh->vertex[p2]);
-    V3D_Sub(&v, &mesh->vertex[p2], &mesh->vertex[p3]);
-
-    V3D_Cross(normal, &u, &v);
-    V3D_NormalizeToUnit(normal, normal);
-  }
+  for (i = 0; i < mesh->polygonNum; i++)
+    CalculateSurfaceNormal(&mesh->surfaceNormal[i], &mesh->polygon[i],
+                           mesh->vertex);
 }
 
 /*
@@ -333,21 +351,92 @@ void CalculateVertexToPolygonMap(MeshT *mesh) {
  * Vertex normal vector is defined as averaged normal of all adjacent polygons.
  * Assumption is made that each vertex belong to at least one polygon.
  */
+static void CalculateVertexNormal(Vector3D *normal, IndexArrayT *polygons,
+                                  Vector3D *surfaceNormal)
+{
+  Vector3D sum = { 0.0f, 0.0f, 0.0f };
+  size_t j;
+
+  for (j = 0; j < polygons->count; j++)
+    V3D_Add(&sum, &sum, &surfaceNormal[polygons->index[j]]);
+
+  V3D_Normalize(normal, &sum, 1.0f);
+}
+
 void CalculateVertexNormals(MeshT *mesh) {
-  size_t i, j;
+  size_t i;
+
+  if (mesh->vertexNormal)
+    PANIC("Already added vertex normals to mesh %p.", mesh);
 
   mesh->vertexNormal = NewTable(Vector3D, mesh->vertexNum);
 
-  for (i = 0; i < mesh->vertexNum; i++) {
-    Vector3D normal = { 0.0f, 0.0f, 0.0f };
+  for (i = 0; i < mesh->vertexNum; i++)
+    CalculateVertexNormal(&mesh->vertexNormal[i],
+                          &mesh->vertexToPoly.vertex[i], mesh->surfaceNormal);
+}
+
+/*
+ * For deformed meshes only.  Vertices, surface and vertex normals belong to
+ * a deformed copy of the mesh.  Given a list of vertices that were moved, it
+ * recalculates normals of adjacent polygons and then of all vertices that
+ * belong to these polygons.  Some normals may be calculated more than once,
+ * but for small changes it's still much cheaper than a full update.
+ */
+void UpdateMeshNormals(MeshT *mesh, Vector3D *vertex,
+                       Vector3D *surfaceNormal, Vector3D *vertexNormal,
+                       uint16_t *changed, size_t count)
+{
+  IndexArrayT *vertexToPoly = mesh->vertexToPoly.vertex;
+  size_t i, j, k;
 
-    for (j = 0; j < mesh->vertexToPoly.vertex[i].count; j++) {
-      uint16_t p = mesh->vertexToPoly.vertex[i].index[j];
+  for (i = 0; i < count; i++) {
+    IndexArrayT *polygons = &vertexToPoly[changed[i]];
 
-      V3D_Add(&normal, &normal, &mesh->surfaceNormal[p]);
+    for (j = 0; j < polygons->count; j++) {
+      uint16_t p = polygons->index[j];
+
+      CalculateSurfaceNormal(&surfaceNormal[p], &mesh->polygon[p], vertex);
     }
+  }
+
+  if (!vertexNormal)
+    return;
+
+  for (i = 0; i < count; i++) {
+    IndexArrayT *polygons = &vertexToPoly[changed[i]];
+
+    for (j = 0; j < polygons->count; j++) {
+      TriangleT *polygon = &mesh->polygon[polygons->index[j]];
 
-    V3D_Normalize(&mesh->vertexNormal[i], &normal, 1.0f);
+      for (k = 0; k < 3; k++) {
+        uint16_t v = polygon->p[k];
+
+        CalculateVertexNormal(&vertexNormal[v], &vertexToPoly[v],
+                              surfaceNormal);
+      }
+    }
+  }
+}
+
+/*
+ * Generates texture coordinates by projecting vertices onto a sphere centered
+ * at the origin.  Works best after the mesh was centered.
+ */
+void CalculateSphericalMapping(MeshT *mesh) {
+  size_t i;
+
+  if (!mesh->texCoord)
+    mesh->texCoord = NewTable(TexCoordT, mesh->vertexNum);
+
+  for (i = 0; i < mesh->vertexNum; i++) {
+    Vector3D *vertex = &mesh->vertex[i];
+    float r = V3D_Length(vertex);
+
+    if (r > 0.0f) {
+      mesh->texCoord[i].u = 0.5f + atan2(vertex->z, vertex->x) / (2 * M_PI);
+      mesh->texCoord[i].v = 0.5f - asin(vertex->y / r) / M_PI;
+    }
   }
 }
 
@@ -359,5 +448,151 @@ void MeshApplyPalette(MeshT *mesh, PaletteT *palette) {
   int i;
 
   for (i = 0; i < mesh->surfaceNum; i++)
-    surface[i].color.clut = PaletteFindNearest(palette, surface[i].color.rgb);
+    surface[i].color.clut =
+      PaletteFindNearestExact(palette, surface[i].color.rgb);
+}
+
+static OctNormalT *QuantizeNormals(Vector3D *normal, size_t n) {
+  OctNormalT *qNormal = NewTable(OctNormalT, n);
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    EncodeOctNormal(&qNormal[i], &normal[i]);
+
+  return qNormal;
+}
+
+/*
+ * Replaces vertices and normals with their quantized counterparts.  Positions
+ * are mapped onto 16-bit integers spanning the bounding box of the mesh and
+ * normals are encoded in octahedral form.  Must be called when all other
+ * calculations on the mesh were done, because float tables are released.
+ */
+void QuantizeMesh(MeshT *mesh) {
+  Vector3D min = mesh->vertex[0];
+  Vector3D max = mesh->vertex[0];
+  Vector3D inv;
+  size_t before, after;
+  size_t i;
+
+  ASSERT(!mesh->qVertex, "Mesh %p already quantized.", mesh);
+  ASSERT(!mesh->morphNum, "Cannot quantize mesh %p with morph targets.", mesh);
+
+  for (i = 1; i < mesh->vertexNum; i++) {
+    Vector3D *v = &mesh->vertex[i];
+
+    if (v->x < min.x) min.x = v->x;
+    if (v->y < min.y) min.y = v->y;
+    if (v->z < min.z) min.z = v->z;
+    if (v->x > max.x) max.x = v->x;
+    if (v->y > max.y) max.y = v->y;
+    if (v->z > max.z) max.z = v->z;
+  }
+
+  V3D_Add(&mesh->qOffset, &min, &max);
+  V3D_Scale(&mesh->qOffset, &mesh->qOffset, 0.5f);
+  V3D_Sub(&mesh->qScale, &max, &mesh->qOffset);
+  V3D_Scale(&mesh->qScale, &mesh->qScale, 1.0f / 32767.0f);
+
+  inv.x = (mesh->qScale.x > 0.0f) ? (1.0f / mesh->qScale.x) : 0.0f;
+  inv.y = (mesh->qScale.y > 0.0f) ? (1.0f / mesh->qScale.y) : 0.0f;
+  inv.z = (mesh->qScale.z > 0.0f) ? (1.0f / mesh->qScale.z) : 0.0f;
+
+  mesh->qVertex = NewTable(QuantVertexT, mesh->vertexNum);
+
+  for (i = 0; i < mesh->vertexNum; i++) {
+    Vector3D *v = &mesh->vertex[i];
+    QuantVertexT *q = &mesh->qVertex[i];
+
+    q->x = lroundf((v->x - mesh->qOffset.x) * inv.x);
+    q->y = lroundf((v->y - mesh->qOffset.y) * inv.y);
+    q->z = lroundf((v->z - mesh->qOffset.z) * inv.z);
+  }
+
+  before = sizeof(Vector3D) * mesh->vertexNum;
+  after = sizeof(QuantVertexT) * mesh->vertexNum;
+
+  if (mesh->surfaceNormal) {
+    mesh->qSurfaceNormal = QuantizeNormals(mesh->surfaceNormal,
+                                           mesh->polygonNum);
+    before += sizeof(Vector3D) * mesh->polygonNum;
+    after += sizeof(OctNormalT) * mesh->polygonNum;
+  }
+
+  if (mesh->vertexNormal) {
+    mesh->qVertexNormal = QuantizeNormals(mesh->vertexNormal,
+                                          mesh->vertexNum);
+    before += sizeof(Vector3D) * mesh->vertexNum;
+    after += sizeof(OctNormalT) * mesh->vertexNum;
+  }
+
+  MemUnref(mesh->vertex);
+  MemUnref(mesh->surfaceNormal);
+  MemUnref(mesh->vertexNormal);
+
+  mesh->vertex = NULL;
+  mesh->surfaceNormal = NULL;
+  mesh->vertexNormal = NULL;
+
+  LOG("Quantized mesh %p: %d bytes instead of %d.",
+      mesh, (int)after, (int)before);
+
+  if (mesh->lod)
+    QuantizeMesh(mesh->lod);
+}
+
+/*
+ * Adds a morph target given as complete shape of the mesh (i.e. a vertex
+ * table of the same size).  Only vertices that differ from the base mesh are
+ * stored as displacements.
+ */
+MorphTargetT *MeshAddMorphTarget(MeshT *mesh, const char *name,
+                                 Vector3D *shape)
+{
+  const float epsilon = 1e-5f;
+  MorphTargetT *morph;
+  size_t i, n;
+
+  ASSERT(mesh->vertex, "Cannot add morph target to quantized mesh.");
+
+  if (mesh->morph)
+    mesh->morph = TableResize(mesh->morph, mesh->morphNum + 1);
+  else
+    mesh->morph = NewTable(MorphTargetT, 1);
+
+  morph = &mesh->morph[mesh->morphNum++];
+
+  for (i = 0, n = 0; i < mesh->vertexNum; i++) {
+    Vector3D delta;
+
+    V3D_Sub(&delta, &shape[i], &mesh->vertex[i]);
+
+    if (fabsf(delta.x) > epsilon || fabsf(delta.y) > epsilon ||
+        fabsf(delta.z) > epsilon)
+      n++;
+  }
+
+  morph->name = StrDup(name);
+  morph->count = n;
+  morph->index = NewTable(uint16_t, max(n, 1));
+  morph->delta = NewTable(Vector3D, max(n, 1));
+
+  for (i = 0, n = 0; i < mesh->vertexNum; i++) {
+    Vector3D delta;
+
+    V3D_Sub(&delta, &shape[i], &mesh->vertex[i]);
+
+    if (fabsf(delta.x) > epsilon || fabsf(delta.y) > epsilon ||
+        fabsf(delta.z) > epsilon)
+    {
+      morph->index[n] = i;
+      morph->delta[n] = delta;
+      n++;
+    }
+  }
+
+  LOG("Morph target '%s' moves %d of %d vertices.",
+      name, (int)n, (int)mesh->vertexNum);
+
+  return morph;
 }
@@ -3,6 +3,7 @@
 
 #include "std/types.h"
 #include "engine/vector3d.h"
+#include "engine/quantized.h"
 #include "gfx/palette.h"
 
 typedef struct Edge {
@@ -25,6 +26,20 @@ typedef struct IndexMap {
   uint16_t *indices;
 } IndexMapT;
 
+typedef struct TexCoord {
+  float u, v;
+} TexCoordT;
+
+/*
+ * Sparse set of vertex displacements.  Only vertices that move are stored.
+ */
+typedef struct MorphTarget {
+  char *name;
+  uint16_t count;
+  uint16_t *index;
+  Vector3D *delta;
+} MorphTargetT;
+
 typedef struct Surface {
   char *name;
   bool sideness;
@@ -39,6 +54,7 @@ typedef struct Mesh {
   uint32_t polygonNum;
   uint32_t surfaceNum;
   uint32_t edgeNum;
+  uint32_t morphNum;
 
   Vector3D *vertex;
   TriangleT *polygon;
@@ -51,6 +67,22 @@ typedef struct Mesh {
   /* useful for lighting and backface culling */
   Vector3D *surfaceNormal;
   Vector3D *vertexNormal;
+
+  /* morph targets, relative to vertex positions (optional) */
+  MorphTargetT *morph;
+
+  /* texture coordinates in [0.0, 1.0] range (optional) */
+  TexCoordT *texCoord;
+
+  /* quantized storage, replaces vertices and normals (optional) */
+  QuantVertexT *qVertex;
+  OctNormalT *qSurfaceNormal;
+  OctNormalT *qVertexNormal;
+  Vector3D qScale, qOffset;
+
+  /* next coarser level of detail and bounding radius (optional) */
+  struct Mesh *lod;
+  float radius;
 } MeshT;
 
 MeshT *NewMesh(uint32_t vertices, uint32_t triangles, uint32_t surfaces);
@@ -58,9 +90,19 @@ MeshT *NewMeshFromFile(const char *fileName);
 void NormalizeMeshSize(MeshT *mesh);
 void CenterMeshPosition(MeshT *mesh);
 
+void MeshCalculateEdges(MeshT *mesh);
+
 void CalculateSurfaceNormals(MeshT *mesh);
 void CalculateVertexToPolygonMap(MeshT *mesh);
 void CalculateVertexNormals(MeshT *mesh);
+void UpdateMeshNormals(MeshT *mesh, Vector3D *vertex,
+                       Vector3D *surfaceNormal, Vector3D *vertexNormal,
+                       uint16_t *changed, size_t count);
+void CalculateSphericalMapping(MeshT *mesh);
+void QuantizeMesh(MeshT *mesh);
+
+MorphTargetT *MeshAddMorphTarget(MeshT *mesh, const char *name,
+                                 Vector3D *shape);
 
 void MeshApplyPalette(MeshT *mesh, PaletteT *palette);
 
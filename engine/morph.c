@@ -0,0 +1,187 @@
+#include "std/debug.h"
+#include "std/math.h"
+#include "std/memory.h"
+#include "engine/morph.h"
+
+static void DeleteMorphState(MorphStateT *self) {
+  MemUnref(self->weight);
+  MemUnref(self->applied);
+  MemUnref(self->vertex);
+  MemUnref(self->surfaceNormal);
+  MemUnref(self->vertexNormal);
+  MemUnref(self->changed);
+  MemUnref(self->moved);
+  MemUnref(self->first);
+  MemUnref(self->target);
+  MemUnref(self->delta);
+}
+
+TYPEDECL(MorphStateT, (FreeFuncT)DeleteMorphState);
+
+/*
+ * Gathers deltas of all morph targets by vertex, so that every moved vertex
+ * can be calculated at once.
+ */
+static void MorphStateSortByVertex(MorphStateT *self) {
+  MeshT *mesh = self->mesh;
+  uint32_t *first = NewTable(uint32_t, mesh->vertexNum + 1);
+  size_t entries = 0;
+  size_t i, j;
+
+  for (i = 0; i < mesh->morphNum; i++) {
+    MorphTargetT *morph = &mesh->morph[i];
+
+    for (j = 0; j < morph->count; j++)
+      first[morph->index[j]]++;
+
+    entries += morph->count;
+  }
+
+  self->moved = NewTable(uint16_t, max(mesh->vertexNum, 1));
+  self->first = NewTable(uint32_t, mesh->vertexNum + 1);
+  self->target = NewTable(uint16_t, max(entries, 1));
+  self->delta = NewTable(Vector3D, max(entries, 1));
+
+  /* Turn counts into offsets to where deltas of each vertex are stored. */
+  for (i = 0, entries = 0; i < mesh->vertexNum; i++) {
+    size_t count = first[i];
+
+    if (count) {
+      self->first[self->movedNum] = entries;
+      self->moved[self->movedNum++] = i;
+    }
+
+    first[i] = entries;
+    entries += count;
+  }
+
+  self->first[self->movedNum] = entries;
+
+  for (i = 0; i < mesh->morphNum; i++) {
+    MorphTargetT *morph = &mesh->morph[i];
+
+    for (j = 0; j < morph->count; j++) {
+      uint32_t k = first[morph->index[j]]++;
+
+      self->target[k] = i;
+      self->delta[k] = morph->delta[j];
+    }
+  }
+
+  MemUnref(first);
+}
+
+MorphStateT *NewMorphState(MeshT *mesh) {
+  MorphStateT *self = NewInstance(MorphStateT);
+
+  ASSERT(mesh->vertex && mesh->surfaceNormal,
+         "Mesh %p lacks vertices or surface normals.", mesh);
+
+  self->mesh = mesh;
+  self->weight = NewTable(float, max(mesh->morphNum, 1));
+  self->applied = NewTable(float, max(mesh->morphNum, 1));
+  self->vertex = MemClone(mesh->vertex);
+  self->surfaceNormal = MemClone(mesh->surfaceNormal);
+  if (mesh->vertexNormal)
+    self->vertexNormal = MemClone(mesh->vertexNormal);
+  self->changed = NewTable(uint16_t, mesh->vertexNum);
+
+  MorphStateSortByVertex(self);
+
+  return self;
+}
+
+void MorphStateSetKeyframe(MorphStateT *self, float frame) {
+  int n = self->mesh->morphNum;
+  int k;
+  float t;
+  int i;
+
+  for (i = 0; i < n; i++)
+    self->weight[i] = 0.0f;
+
+  /* Negative frames would give negative weights or write before the table. */
+  if (frame <= 0.0f || n == 0)
+    return;
+
+  if (frame >= n) {
+    self->weight[n - 1] = 1.0f;
+    return;
+  }
+
+  k = (int)frame;
+  t = frame - k;
+
+  /* Keyframe k is the base mesh for k == 0, or target k - 1 otherwise. */
+  if (k > 0)
+    self->weight[k - 1] = 1.0f - t;
+
+  self->weight[k] = t;
+}
+
+/*
+ * Vertices are calculated in a single pass over the deltas sorted by vertex.
+ * A vertex is only written if any of its morph targets changed weight since
+ * the last update.  It is always rebuilt from the base position, so no error
+ * is accumulated over frames.
+ */
+bool MorphStateUpdate(MorphStateT *self) {
+  MeshT *mesh = self->mesh;
+  Vector3D *base = mesh->vertex;
+  Vector3D *vertex = self->vertex;
+  float *weight = self->weight;
+  float *applied = self->applied;
+  uint16_t *changed = self->changed;
+  uint16_t *target = self->target;
+  Vector3D *delta = self->delta;
+  uint32_t *first = self->first;
+  size_t changedNum = 0;
+  size_t i;
+
+  for (i = 0; i < mesh->morphNum; i++)
+    if (weight[i] != applied[i])
+      break;
+
+  if (i == mesh->morphNum) {
+    self->changedNum = 0;
+    return false;
+  }
+
+  for (i = 0; i < self->movedNum; i++) {
+    uint16_t k = self->moved[i];
+    uint32_t j = first[i];
+    uint32_t last = first[i + 1];
+    float x = base[k].x;
+    float y = base[k].y;
+    float z = base[k].z;
+    bool dirty = false;
+
+    for (; j < last; j++) {
+      float w = weight[target[j]];
+
+      if (w != applied[target[j]])
+        dirty = true;
+
+      x += delta[j].x * w;
+      y += delta[j].y * w;
+      z += delta[j].z * w;
+    }
+
+    if (dirty) {
+      vertex[k].x = x;
+      vertex[k].y = y;
+      vertex[k].z = z;
+      changed[changedNum++] = k;
+    }
+  }
+
+  for (i = 0; i < mesh->morphNum; i++)
+    applied[i] = weight[i];
+
+  self->changedNum = changedNum;
+
+  UpdateMeshNormals(mesh, vertex, self->surfaceNormal, self->vertexNormal,
+                    changed, changedNum);
+
+  return true;
+}
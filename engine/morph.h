@@ -0,0 +1,51 @@
+#ifndef __ENGINE_MORPH_H__
+#define __ENGINE_MORPH_H__
+
+#include "engine/mesh.h"
+
+/*
+ * Per object copy of the mesh geometry deformed by morph targets.  Weights
+ * are meant to be set every frame, e.g. from timeline envelopes.
+ */
+typedef struct MorphState {
+  MeshT *mesh;
+
+  float *weight;
+  /* weights used in previous update */
+  float *applied;
+
+  Vector3D *vertex;
+  Vector3D *surfaceNormal;
+  Vector3D *vertexNormal;
+
+  /* vertices moved in the last update */
+  uint16_t *changed;
+  size_t changedNum;
+
+  /*
+   * Morph targets rearranged by vertex: deltas of moved vertex i are stored
+   * at entries [first[i], first[i + 1]) along with their target numbers.
+   */
+  uint16_t *moved;
+  size_t movedNum;
+  uint32_t *first;
+  uint16_t *target;
+  Vector3D *delta;
+} MorphStateT;
+
+MorphStateT *NewMorphState(MeshT *mesh);
+
+/*
+ * Treats morph targets as consecutive keyframes and sets weights to blend
+ * between two of them.  Frame 0.0 is the base mesh, 1.0 the first target,
+ * and so on.  Frames out of range are clamped.
+ */
+void MorphStateSetKeyframe(MorphStateT *self, float frame);
+
+/*
+ * Applies morph targets with changed weights.  Returns false if the shape
+ * stays the same as after previous update.
+ */
+bool MorphStateUpdate(MorphStateT *self);
+
+#endif
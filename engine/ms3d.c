@@ -11,7 +11,10 @@ static void Compose3D(MatrixStack3D *ms) {
     Matrix3D *a = (Matrix3D *)StackPeek(ms, 2);
     Matrix3D *b = (Matrix3D *)StackPeek(ms, 1);
 
-    Multiply3D(d, a, b);
+    if (IsAffine3D(a) && IsAffine3D(b))
+      MultiplyAffine3D(d, a, b);
+    else
+      Multiply3D(d, a, b);
   }
 }
 
@@ -3,6 +3,7 @@
 #include "std/memory.h"
 #include "std/quicksort.h"
 #include "std/table.h"
+#include "engine/clipping.h"
 #include "engine/object.h"
 #include "gfx/line.h"
 #include "gfx/triangle.h"
@@ -10,36 +11,138 @@
 
 RenderModeT RenderMode = RENDER_WIREFRAME;
 bool RenderAllFaces = false;
+bool RenderBinned = false;
 
-static void DeleteSceneObject(SceneObjectT *self) {
-  MemUnref(self->ms);
+static void DeleteObjectScratch(ObjectScratchT *self) {
   MemUnref(self->vertex);
   MemUnref(self->vertexExt);
   MemUnref(self->polygonExt);
   MemUnref(self->sortedPolygonExt);
   MemUnref(self->edgeScan);
   MemUnref(self->surfaceNormal);
-  MemUnref(self->name);
+  MemUnref(self->vertexNormal);
+  MemUnref(self->polygonCenter);
+  MemUnref(self->polygonShade);
+  MemUnref(self->vertexShade);
+  MemUnref(self->visible);
+  MemUnref(self->shadeTable);
+  MemUnref(self->spanBuffer);
+  MemUnref(self->tileBuffer);
 }
 
-TYPEDECL(SceneObjectT, (FreeFuncT)DeleteSceneObject);
+TYPEDECL(ObjectScratchT, (FreeFuncT)DeleteObjectScratch);
 
-SceneObjectT *NewSceneObject(const char *name, MeshT *mesh) {
-  SceneObjectT *self = NewInstance(SceneObjectT);
+static ObjectScratchT *NewObjectScratch(MeshT *mesh) {
+  ObjectScratchT *self = NewInstance(ObjectScratchT);
 
-  self->name = StrDup(name);
   self->mesh = mesh;
-  self->ms = NewMatrixStack3D();
+  self->sortedMesh = mesh;
   self->vertex = NewTable(Vector3D, mesh->vertexNum);
   self->vertexExt = NewTable(VertexExtT, mesh->vertexNum);
   self->polygonExt = NewTable(PolygonExtT, mesh->polygonNum);
   self->sortedPolygonExt = (PolygonExtT **)NewTableAdapter(self->polygonExt);
   self->edgeScan = NewTable(EdgeScanT, mesh->edgeNum);
   self->surfaceNormal = NewTable(Vector3D, mesh->polygonNum);
+  self->vertexNormal = NewTable(Vector3D, mesh->vertexNum);
+  self->polygonCenter = NewTable(Vector3D, mesh->polygonNum);
+  self->polygonShade = NewTable(uint8_t, mesh->polygonNum);
+  self->vertexShade = NewTable(uint8_t, mesh->vertexNum);
+  self->visible = NewTable(uint16_t, mesh->polygonNum);
 
   return self;
 }
 
+static void DeleteSceneObject(SceneObjectT *self) {
+  MemUnref(self->ms);
+  MemUnref(self->morph);
+  MemUnref(self->name);
+
+  if (--self->scratch->users == 0)
+    MemUnref(self->scratch);
+}
+
+TYPEDECL(SceneObjectT, (FreeFuncT)DeleteSceneObject);
+
+static SceneObjectT *NewSceneObjectWithScratch(const char *name, MeshT *mesh,
+                                               ObjectScratchT *scratch)
+{
+  SceneObjectT *self = NewInstance(SceneObjectT);
+
+  self->name = StrDup(name);
+  self->mesh = mesh;
+  self->lodMesh = mesh;
+  self->lodRadius = 64.0f;
+  self->ms = NewMatrixStack3D();
+  self->scratch = scratch;
+  self->scratch->users++;
+
+  if (mesh->morphNum)
+    self->morph = NewMorphState(mesh);
+
+  return self;
+}
+
+static size_t TableBytes(PtrT table) {
+  return table ? TableSize(table) * TableElemSize(table) : 0;
+}
+
+size_t SceneObjectMemoryUsage(SceneObjectT *self) {
+  size_t bytes = sizeof(SceneObjectT) + 32 * sizeof(Matrix3D);
+
+  if (self->morph) {
+    MorphStateT *morph = self->morph;
+
+    bytes += sizeof(MorphStateT);
+    bytes += TableBytes(morph->weight) + TableBytes(morph->applied);
+    bytes += TableBytes(morph->vertex) + TableBytes(morph->surfaceNormal);
+    bytes += TableBytes(morph->vertexNormal) + TableBytes(morph->changed);
+    bytes += TableBytes(morph->moved) + TableBytes(morph->first);
+    bytes += TableBytes(morph->target) + TableBytes(morph->delta);
+  }
+
+  return bytes;
+}
+
+static size_t ObjectScratchMemoryUsage(ObjectScratchT *self) {
+  return (sizeof(ObjectScratchT) +
+          TableBytes(self->vertex) + TableBytes(self->vertexExt) +
+          TableBytes(self->polygonExt) + TableBytes(self->sortedPolygonExt) +
+          TableBytes(self->edgeScan) + TableBytes(self->surfaceNormal) +
+          TableBytes(self->vertexNormal) + TableBytes(self->polygonCenter) +
+          TableBytes(self->polygonShade) + TableBytes(self->vertexShade) +
+          TableBytes(self->visible));
+}
+
+SceneObjectT *NewSceneObject(const char *name, MeshT *mesh) {
+  SceneObjectT *self =
+    NewSceneObjectWithScratch(name, mesh, NewObjectScratch(mesh));
+
+  LOG("Object '%s' uses %d bytes and %d bytes of scratch buffers.",
+      name, (int)SceneObjectMemoryUsage(self),
+      (int)ObjectScratchMemoryUsage(self->scratch));
+
+  return self;
+}
+
+SceneObjectT *NewSceneObjectInstance(const char *name, SceneObjectT *original) {
+  SceneObjectT *self =
+    NewSceneObjectWithScratch(name, original->mesh, original->scratch);
+
+  self->lodRadius = original->lodRadius;
+  self->lights = original->lights;
+  self->texture = original->texture;
+
+  LOG("Instance '%s' of '%s' uses %d bytes (%d objects share buffers).",
+      name, original->name, (int)SceneObjectMemoryUsage(self),
+      (int)self->scratch->users);
+
+  return self;
+}
+
+static inline bool IsPowerOfTwo(size_t x) {
+  return x && !(x & (x - 1));
+}
+
 static inline bool SortByDepth(const PolygonExtT *a, const PolygonExtT *b) {
   return a->depth < b->depth;
 }
@@ -47,7 +150,9 @@ static inline bool SortByDepth(const PolygonExtT *a, const PolygonExtT *b) {
 QUICKSORT(PolygonExtT, SortByDepth);
 
 static void UpdatePolygonExt(PolygonExtT *polygonExt, TriangleT *polygon,
-                             size_t polygonNum, Vector3D *vertex, Vector3D *normal)
+                             size_t polygonNum, Vector3D *vertex,
+                             Vector3D *normal, Vector3D *center,
+                             bool updateNormals)
 {
   int i;
 
@@ -63,7 +168,11 @@ static void UpdatePolygonExt(PolygonExtT *polygonExt, TriangleT *polygon,
      * NOTE: Don't use floating point comparison (i.e. max function) to select
      * a value. It's fragile and may be non-deterministic.
      */
-    polyExt->depth = (vertex[p1].z + vertex[p2].z + vertex[p3].z) / 3.0f;
+    center[i].x = (vertex[p1].x + vertex[p2].x + vertex[p3].x) / 3.0f;
+    center[i].y = (vertex[p1].y + vertex[p2].y + vertex[p3].y) / 3.0f;
+    center[i].z = (vertex[p1].z + vertex[p2].z + vertex[p3].z) / 3.0f;
+
+    polyExt->depth = center[i].z;
 
 #if 0
     /* Calculate angle between camera and surface normal. */
@@ -77,8 +186,12 @@ static void UpdatePolygonExt(PolygonExtT *polygonExt, TriangleT *polygon,
       angle = V3D_Dot(&cameraToFace, &unitNormal);
     }
 #endif
-    V3D_NormalizeToUnit(&polyExt->normal, &normal[i]);
+    if (!updateNormals)
+      continue;
 
+    V3D_NormalizeToUnit(&normal[i], &normal[i]);
+
+    polyExt->normal = normal[i];
 
     if (polyExt->normal.z > 0)
       polyExt->flags |= 1;
@@ -87,90 +200,402 @@ static void UpdatePolygonExt(PolygonExtT *polygonExt, TriangleT *polygon,
   }
 }
 
+/* Vertex flags. */
+#define VF_LEFT      1
+#define VF_RIGHT     2
+#define VF_TOP       4
+#define VF_BOTTOM    8
+#define VF_OFFSCREEN (VF_LEFT | VF_RIGHT | VF_TOP | VF_BOTTOM)
+/* outside of guard band, i.e. too far to be handled by clipped rasterizer */
+#define VF_GUARD     16
+/* in front of near plane, projected position is not valid */
+#define VF_NEAR      32
+
+#define VIEWER_Z   (-160.0f)
+#define NEAR_Z     (-0.125f)
+#define GUARD_BAND 1024
+
 static void UpdateVertexExt(PixBufT *canvas, VertexExtT *dst, Vector3D *src, int vertexNum) {
   const float viewerX = canvas->width / 2;
   const float viewerY = canvas->height / 2;
-  const float viewerZ = -160.0f;
+  const float viewerZ = VIEWER_Z;
   int i;
 
   for (i = 0; i < vertexNum; i++) {
-    float invZ = viewerZ / src[i].z;
-    float fx = src[i].x * invZ + viewerX;
-    float fy = src[i].y * invZ + viewerY;
-    int x = lroundf(fx);
-    int y = lroundf(fy);
+    float invZ, fx, fy;
+    int x, y;
     uint8_t flags = 0;
 
+    if (src[i].z > NEAR_Z) {
+      dst[i].x = 0.0f;
+      dst[i].y = 0.0f;
+      dst[i].invZ = 0.0f;
+      dst[i].flags = VF_NEAR;
+      continue;
+    }
+
+    invZ = viewerZ / src[i].z;
+    fx = src[i].x * invZ + viewerX;
+    fy = src[i].y * invZ + viewerY;
+
+    if (fx < -GUARD_BAND || fx > canvas->width + GUARD_BAND ||
+        fy < -GUARD_BAND || fy > canvas->height + GUARD_BAND)
+      flags |= VF_GUARD;
+
+    x = lroundf(fx);
+    y = lroundf(fy);
+
     if (x < 0)
-      flags |= 1;
+      flags |= VF_LEFT;
     else if (x > canvas->width - 1)
-      flags |= 2;
+      flags |= VF_RIGHT;
 
     if (y < 0)
-      flags |= 4;
+      flags |= VF_TOP;
     else if (y > canvas->height - 1)
-      flags |= 8;
+      flags |= VF_BOTTOM;
 
     dst[i].x = fx;
     dst[i].y = fy;
+    dst[i].invZ = invZ;
     dst[i].flags = flags;
   }
 }
 
-static void
-UpdateVertexNormals(VertexExtT *vertexExt, IndexArrayT *indexArray,
-                    PolygonExtT *polygonExt, int vertexNum)
-{
+/*
+ * Vertex normals are precalculated for the mesh, so it's enough to rotate
+ * them with the matrix returned here.  Object matrix is assumed to scale
+ * uniformly (if at all), so the scale is removed using length of the first row.
+ */
+static void LoadNormalMatrix3D(Matrix3D *d, Matrix3D *m) {
+  float s = FastInvSqrt((*m)[0][0] * (*m)[0][0] +
+                        (*m)[0][1] * (*m)[0][1] +
+                        (*m)[0][2] * (*m)[0][2]);
   int i, j;
 
-  for (i = 0; i < vertexNum; i++) {
-    uint16_t count = indexArray[i].count;
-    uint16_t *index = indexArray[i].index;
-    Vector3D *normal = &vertexExt[i].normal;
+  for (i = 0; i < 3; i++)
+    for (j = 0; j < 3; j++)
+      (*d)[i][j] = (*m)[i][j] * s;
+}
 
-    normal->x = 0.0f;
-    normal->y = 0.0f;
-    normal->z = 0.0f;
+/*
+ * Light intensity is mapped onto color map columns, so that unlit surfaces
+ * are still visible and the brightest ones don't saturate to white.  Without
+ * color map the intensity itself is the color.
+ */
+static inline int ShadeColumn(int intensity) {
+  return min(intensity / 2 + 128 - 16, 255);
+}
 
-    for (j = 0; j < count; j++)
-      V3D_Add(normal, normal, &polygonExt[index[j]].normal);
+static void UpdateShadeTable(ObjectScratchT *self, PixBufT *canvas) {
+  uint8_t *cmap = canvas->blit.cmap;
+  size_t n = self->mesh->surfaceNum;
+  int i, j;
+
+  if (self->shadeTable && self->shadeTableCmap == cmap &&
+      self->shadeTableVersion == canvas->cmapVersion)
+    return;
+
+  if (!self->shadeTable)
+    self->shadeTable = NewTable(uint8_t, n * 256);
+
+  for (i = 0; i < n; i++) {
+    uint8_t *table = &self->shadeTable[i << 8];
+
+    for (j = 0; j < 256; j++) {
+      if (cmap)
+        table[j] = cmap[(i << 8) | ShadeColumn(j)];
+      else
+        table[j] = j;
+    }
+  }
+
+  self->shadeTableCmap = cmap;
+  self->shadeTableVersion = canvas->cmapVersion;
+}
+
+/* Polygons that won't be culled, those are the only ones worth lighting. */
+static size_t CollectVisiblePolygons(SceneObjectT *self) {
+  ObjectScratchT *scratch = self->scratch;
+  MeshT *mesh = self->lodMesh;
+  size_t i, n = 0;
 
-    V3D_Scale(normal, normal, 1.0f / (float)count);
+  for (i = 0; i < mesh->polygonNum; i++) {
+    TriangleT *polygon = &mesh->polygon[i];
+
+    if (RenderAllFaces || scratch->polygonExt[i].flags ||
+        mesh->surface[polygon->surface].sideness)
+      scratch->visible[n++] = i;
   }
+
+  return n;
 }
 
 __regargs static uint8_t
-DetermineSurfaceColor(PixBufT *canvas, SurfaceT *surface, PolygonExtT *polyExt,
-                      int color)
+DetermineSurfaceColor(SceneObjectT *self, SurfaceT *surface,
+                      PolygonExtT *polyExt, int color)
 {
-  if (RenderMode == RENDER_FLAT_SHADING) {
-    int shade = abs((int)(polyExt->normal.z * 255.0f));
+  if (RenderMode == RENDER_FLAT_SHADING || RenderMode == RENDER_SPAN_BUFFER) {
+    ObjectScratchT *scratch = self->scratch;
 
-    if (canvas->blit.cmap) {
-      shade = shade / 2 + 128 - 16;
+    return scratch->shadeTable[(color << 8) |
+                               scratch->polygonShade[polyExt->index]];
+  }
 
-      if (shade > 255)
-        shade = 255;
-#if 0
-      if (shade < 0)
-        shade = 0;
-#endif
+  return surface->color.clut;
+}
 
-      return canvas->blit.cmap[(color << 8) | shade];
+/*
+ * Edge scan is calculated only once per frame, the first time a visible
+ * polygon needs it.  Edges from previous frames are recognized by epoch.
+ */
+static EdgeScanT *GetEdgeScan(SceneObjectT *self, int i) {
+  ObjectScratchT *scratch = self->scratch;
+  EdgeScanT *edgeScan = &scratch->edgeScan[i];
+
+  if (edgeScan->epoch != scratch->epoch) {
+    VertexExtT *vertex = scratch->vertexExt;
+    EdgeT *edge = &self->lodMesh->edge[i];
+
+    float x1 = vertex[edge->p[0]].x;
+    float y1 = vertex[edge->p[0]].y;
+    float x2 = vertex[edge->p[1]].x;
+    float y2 = vertex[edge->p[1]].y;
+
+    if (y1 > y2) {
+      swapr(x1, x2);
+      swapr(y1, y2);
+    }
+
+    InitEdgeScan(edgeScan, y1, y2, x1, x2);
+
+    edgeScan->epoch = scratch->epoch;
+    self->edgeScanCount++;
+  }
+
+  return edgeScan;
+}
+
+static inline void ProjectClipVertex(PixBufT *canvas, ClipVertexT *v) {
+  float invZ = VIEWER_Z / v->z;
+
+  v->x = v->x * invZ + canvas->width / 2;
+  v->y = v->y * invZ + canvas->height / 2;
+  v->z = invZ;
+}
+
+/*
+ * Slow path for edges with a vertex in front of near plane or outside of
+ * guard band (or off screen for antialiased lines, which are not clipped by
+ * the line drawing routine).  The edge is clipped in view space and then to
+ * the screen.
+ */
+static void DrawClippedEdge(SceneObjectT *self, PixBufT *canvas,
+                            int p1, int p2, bool antialiased)
+{
+  ClipVertexT edge[2];
+  float t0 = 0.0f, t1 = 1.0f;
+  float dx, dy;
+  int i;
+
+  for (i = 0; i < 2; i++) {
+    Vector3D *v = &self->scratch->vertex[i ? p2 : p1];
+
+    edge[i].x = v->x;
+    edge[i].y = v->y;
+    edge[i].z = v->z;
+  }
+
+  if (edge[0].z > NEAR_Z && edge[1].z > NEAR_Z)
+    return;
+
+  if (edge[0].z > NEAR_Z || edge[1].z > NEAR_Z) {
+    ClipVertexT *in = (edge[0].z <= NEAR_Z) ? &edge[0] : &edge[1];
+    ClipVertexT *out = (edge[0].z <= NEAR_Z) ? &edge[1] : &edge[0];
+    float t = (NEAR_Z - in->z) / (out->z - in->z);
+
+    out->x = in->x + (out->x - in->x) * t;
+    out->y = in->y + (out->y - in->y) * t;
+    out->z = NEAR_Z;
+  }
+
+  ProjectClipVertex(canvas, &edge[0]);
+  ProjectClipVertex(canvas, &edge[1]);
+
+  /* Liang-Barsky against the screen. */
+  dx = edge[1].x - edge[0].x;
+  dy = edge[1].y - edge[0].y;
+
+  {
+    float p[4] = { -dx, dx, -dy, dy };
+    float q[4] = { edge[0].x, canvas->width - 1 - edge[0].x,
+                   edge[0].y, canvas->height - 1 - edge[0].y };
+
+    for (i = 0; i < 4; i++) {
+      if (p[i] == 0.0f) {
+        if (q[i] < 0.0f)
+          return;
+      } else {
+        float t = q[i] / p[i];
+
+        if (p[i] < 0.0f) {
+          if (t > t1)
+            return;
+          if (t > t0)
+            t0 = t;
+        } else {
+          if (t < t0)
+            return;
+          if (t < t1)
+            t1 = t;
+        }
+      }
+    }
+  }
+
+  {
+    float x0 = edge[0].x + dx * t0, y0 = edge[0].y + dy * t0;
+    float x1 = edge[0].x + dx * t1, y1 = edge[0].y + dy * t1;
+
+    if (antialiased)
+      DrawLineAA(canvas, x0, y0, x1, y1);
+    else
+      DrawLine(canvas, lroundf(x0), lroundf(y0), lroundf(x1), lroundf(y1));
+  }
+}
+
+/*
+ * Slow path for polygons that have a vertex in front of near plane or outside
+ * of guard band (or any vertex off screen in Gouraud shading mode).  The
+ * polygon is clipped in view space against near plane, projected, clipped
+ * in screen space and drawn as a triangle fan.
+ */
+static void RenderClippedPolygon(SceneObjectT *self, PixBufT *canvas,
+                                 TriangleT *polygon, int shade)
+{
+  ObjectScratchT *scratch = self->scratch;
+  MeshT *mesh = self->lodMesh;
+  ClipVertexT in[CLIP_MAX], out[CLIP_MAX];
+  int i, n = 3;
+
+  for (i = 0; i < 3; i++) {
+    int p = polygon->p[i];
+
+    in[i].x = scratch->vertex[p].x;
+    in[i].y = scratch->vertex[p].y;
+    in[i].z = scratch->vertex[p].z;
+    in[i].c = scratch->vertexShade[p];
+
+    if (self->texture && mesh->texCoord) {
+      in[i].u = mesh->texCoord[p].u * self->texture->width;
+      in[i].v = mesh->texCoord[p].v * self->texture->height;
+    } else {
+      in[i].u = 0.0f;
+      in[i].v = 0.0f;
+    }
+  }
+
+  n = ClipPolygonNear(out, in, n, NEAR_Z);
+
+  if (n < 3)
+    return;
+
+  for (i = 0; i < n; i++)
+    ProjectClipVertex(canvas, &out[i]);
+
+  /* Gouraud shaded triangle rasterizer doesn't clip at all. */
+  if (RenderMode == RENDER_GOURAUD_SHADING)
+    n = ClipPolygon2D(in, out, n, 0.0f, 0.0f,
+                      canvas->width - 1, canvas->height - 1);
+  else
+    n = ClipPolygon2D(in, out, n, -GUARD_BAND, -GUARD_BAND,
+                      canvas->width + GUARD_BAND, canvas->height + GUARD_BAND);
+
+  for (i = 1; i < n - 1; i++) {
+    ClipVertexT *v[3] = { &in[0], &in[i], &in[i + 1] };
+    int k;
+
+    switch (RenderMode) {
+      case RENDER_FILLED:
+      case RENDER_FLAT_SHADING:
+      case RENDER_SPAN_BUFFER:
+        {
+          EdgeScanT edge[3];
+          Vector3D point[3];
+
+          for (k = 0; k < 3; k++) {
+            ClipVertexT *a = v[k];
+            ClipVertexT *b = v[(k + 1) % 3];
+
+            if (a->y > b->y)
+              swapr(a, b);
+
+            InitEdgeScan(&edge[k], a->y, b->y, a->x, b->x);
+
+            point[k].x = v[k]->x;
+            point[k].y = v[k]->y;
+            point[k].z = v[k]->z;
+          }
+
+          if (RenderMode == RENDER_SPAN_BUFFER)
+            SpanBufferAddTriangle(scratch->spanBuffer,
+                                  &edge[0], &edge[1], &edge[2],
+                                  &point[0], &point[1], &point[2],
+                                  canvas->fgColor);
+          else if (RenderBinned)
+            TileBufferAddTriangle(scratch->tileBuffer,
+                                  &edge[0], &edge[1], &edge[2],
+                                  canvas->fgColor);
+          else
+            RasterizeTriangleClipped(canvas, &edge[0], &edge[1], &edge[2]);
+        }
+        break;
+
+      case RENDER_GOURAUD_SHADING:
+        {
+          TriPointC point[3];
+
+          for (k = 0; k < 3; k++) {
+            point[k].x = v[k]->x;
+            point[k].y = v[k]->y;
+            point[k].c = v[k]->c;
+          }
+
+          DrawTriangleC(canvas, &point[0], &point[1], &point[2]);
+        }
+        break;
+
+      case RENDER_TEXTURE_MAPPING:
+        if (self->texture && mesh->texCoord) {
+          TriPointUV point[3];
+
+          for (k = 0; k < 3; k++) {
+            point[k].x = v[k]->x;
+            point[k].y = v[k]->y;
+            point[k].z = v[k]->z;
+            point[k].u = v[k]->u;
+            point[k].v = v[k]->v;
+          }
+
+          DrawTriangleUV(canvas, self->texture,
+                         &point[0], &point[1], &point[2], shade);
+        }
+        break;
+
+      default:
+        break;
     }
-    return shade;
   }
-  return surface->color.clut;
 }
 
 static void RenderObject(SceneObjectT *self, PixBufT *canvas) {
-  MeshT *mesh = self->mesh;
-  VertexExtT *vertex = self->vertexExt;
-  EdgeScanT *edge = self->edgeScan;
+  ObjectScratchT *scratch = self->scratch;
+  MeshT *mesh = self->lodMesh;
+  VertexExtT *vertex = scratch->vertexExt;
   int j;
 
   for (j = 0; j < mesh->polygonNum; j++) {
-    PolygonExtT *polyExt = self->sortedPolygonExt[j];
+    PolygonExtT *polyExt = scratch->sortedPolygonExt[j];
     TriangleT *polygon = &mesh->polygon[polyExt->index];
     EdgeScanT *e1, *e2, *e3;
     int p1 = polygon->p[0];
@@ -179,39 +604,74 @@ static void RenderObject(SceneObjectT *self, PixBufT *canvas) {
 
     SurfaceT *surface = &mesh->surface[polygon->surface];
 
-    if (vertex[p1].flags & vertex[p2].flags & vertex[p3].flags)
+    uint8_t flags = vertex[p1].flags | vertex[p2].flags | vertex[p3].flags;
+
+    /* All vertices are off one side of the screen or in front of near plane. */
+    if (vertex[p1].flags & vertex[p2].flags & vertex[p3].flags &
+        (VF_OFFSCREEN | VF_NEAR))
       continue;
 
     if (!RenderAllFaces && !polyExt->flags && !surface->sideness)
       continue;
 
+    self->polygonCount++;
+
     canvas->fgColor =
-      DetermineSurfaceColor(canvas, surface, polyExt, polygon->surface);
+      DetermineSurfaceColor(self, surface, polyExt, polygon->surface);
 
-    e1 = &edge[polygon->e[0]];
-    e2 = &edge[polygon->e[1]];
-    e3 = &edge[polygon->e[2]];
+    if (RenderMode >= RENDER_FILLED) {
+      bool clip = flags & (VF_NEAR | VF_GUARD);
+
+      if (RenderMode == RENDER_GOURAUD_SHADING)
+        clip = clip || (flags & VF_OFFSCREEN);
+
+      if (clip) {
+        int shade = ShadeColumn(scratch->polygonShade[polyExt->index]);
+
+        RenderClippedPolygon(self, canvas, polygon, shade);
+        continue;
+      }
+    }
+
+    e1 = GetEdgeScan(self, polygon->e[0]);
+    e2 = GetEdgeScan(self, polygon->e[1]);
+    e3 = GetEdgeScan(self, polygon->e[2]);
 
     switch (RenderMode) {
       case RENDER_WIREFRAME:
-        if (!e1->done && !(vertex[p1].flags & vertex[p2].flags)) {
-          if (vertex[p1].flags | vertex[p2].flags)
+        if (!e1->done &&
+            !(vertex[p1].flags & vertex[p2].flags & VF_OFFSCREEN)) {
+          uint8_t f = vertex[p1].flags | vertex[p2].flags;
+
+          if (f & (VF_NEAR | VF_GUARD))
+            DrawClippedEdge(self, canvas, p1, p2, false);
+          else if (f)
             DrawLine(canvas, e1->xs, e1->ys, e1->xe, e1->ye);
           else
             DrawLineUnsafe(canvas, e1->xs, e1->ys, e1->xe, e1->ye);
           e1->done = true;
         }
 
-        if (!e2->done && !(vertex[p2].flags & vertex[p3].flags)) {
-          if (vertex[p2].flags | vertex[p3].flags)
+        if (!e2->done &&
+            !(vertex[p2].flags & vertex[p3].flags & VF_OFFSCREEN)) {
+          uint8_t f = vertex[p2].flags | vertex[p3].flags;
+
+          if (f & (VF_NEAR | VF_GUARD))
+            DrawClippedEdge(self, canvas, p2, p3, false);
+          else if (f)
             DrawLine(canvas, e2->xs, e2->ys, e2->xe, e2->ye);
           else
             DrawLineUnsafe(canvas, e2->xs, e2->ys, e2->xe, e2->ye);
           e2->done = true;
         }
 
-        if (!e3->done && !(vertex[p1].flags & vertex[p3].flags)) {
-          if (vertex[p1].flags | vertex[p3].flags)
+        if (!e3->done &&
+            !(vertex[p1].flags & vertex[p3].flags & VF_OFFSCREEN)) {
+          uint8_t f = vertex[p1].flags | vertex[p3].flags;
+
+          if (f & (VF_NEAR | VF_GUARD))
+            DrawClippedEdge(self, canvas, p1, p3, false);
+          else if (f)
             DrawLine(canvas, e3->xs, e3->ys, e3->xe, e3->ye);
           else
             DrawLineUnsafe(canvas, e3->xs, e3->ys, e3->xe, e3->ye);
@@ -220,39 +680,43 @@ static void RenderObject(SceneObjectT *self, PixBufT *canvas) {
         break;
 
       case RENDER_WIREFRAME_AA:
-        if (!e1->done && !(vertex[p1].flags & vertex[p2].flags)) {
-          DrawLineAA(canvas, e1->xs, e1->ys, e1->xe, e1->ye);
+        if (!e1->done &&
+            !(vertex[p1].flags & vertex[p2].flags & VF_OFFSCREEN)) {
+          if (vertex[p1].flags | vertex[p2].flags)
+            DrawClippedEdge(self, canvas, p1, p2, true);
+          else
+            DrawLineAA(canvas, e1->xs, e1->ys, e1->xe, e1->ye);
           e1->done = true;
         }
 
-        if (!e2->done && !(vertex[p2].flags & vertex[p3].flags)) {
-          DrawLineAA(canvas, e2->xs, e2->ys, e2->xe, e2->ye);
+        if (!e2->done &&
+            !(vertex[p2].flags & vertex[p3].flags & VF_OFFSCREEN)) {
+          if (vertex[p2].flags | vertex[p3].flags)
+            DrawClippedEdge(self, canvas, p2, p3, true);
+          else
+            DrawLineAA(canvas, e2->xs, e2->ys, e2->xe, e2->ye);
           e2->done = true;
         }
 
-        if (!e3->done && !(vertex[p1].flags & vertex[p3].flags)) {
-          DrawLineAA(canvas, e3->xs, e3->ys, e3->xe, e3->ye);
+        if (!e3->done &&
+            !(vertex[p1].flags & vertex[p3].flags & VF_OFFSCREEN)) {
+          if (vertex[p1].flags | vertex[p3].flags)
+            DrawClippedEdge(self, canvas, p1, p3, true);
+          else
+            DrawLineAA(canvas, e3->xs, e3->ys, e3->xe, e3->ye);
           e3->done = true;
         }
         break;
 
       case RENDER_FILLED:
       case RENDER_FLAT_SHADING:
-        {
-          bool clipping = vertex[p1].flags | vertex[p2].flags | vertex[p3].flags;
-
-          if (!clipping) {
-            EdgeScanT *e1 = &edge[polygon->e[0]];
-            EdgeScanT *e2 = &edge[polygon->e[1]];
-            EdgeScanT *e3 = &edge[polygon->e[2]];
-            RasterizeTriangle(canvas, e1, e2, e3);
-          } else {
-            DrawTriangle(canvas,
-                         (TriPoint *)&vertex[p1],
-                         (TriPoint *)&vertex[p2], 
-                         (TriPoint *)&vertex[p3]);
-          }
-        }
+        if (RenderBinned)
+          TileBufferAddTriangle(scratch->tileBuffer, e1, e2, e3,
+                                canvas->fgColor);
+        else if (flags)
+          RasterizeTriangleClipped(canvas, e1, e2, e3);
+        else
+          RasterizeTriangle(canvas, e1, e2, e3);
         break;
 
       case RENDER_GOURAUD_SHADING:
@@ -261,70 +725,292 @@ static void RenderObject(SceneObjectT *self, PixBufT *canvas) {
 
           point[0].x = vertex[p1].x;
           point[0].y = vertex[p1].y;
-          point[0].c = fabsf(vertex[p1].normal.z) * 255.0f;
+          point[0].c = scratch->vertexShade[p1];
 
           point[1].x = vertex[p2].x;
           point[1].y = vertex[p2].y;
-          point[1].c = fabsf(vertex[p2].normal.z) * 255.0f;
+          point[1].c = scratch->vertexShade[p2];
 
           point[2].x = vertex[p3].x;
           point[2].y = vertex[p3].y;
-          point[2].c = fabsf(vertex[p3].normal.z) * 255.0f;
+          point[2].c = scratch->vertexShade[p3];
 
           DrawTriangleC(canvas, &point[0], &point[1], &point[2]);
         }
         break;
+
+      case RENDER_SPAN_BUFFER:
+        {
+          Vector3D point[3] = {
+            { vertex[p1].x, vertex[p1].y, vertex[p1].invZ },
+            { vertex[p2].x, vertex[p2].y, vertex[p2].invZ },
+            { vertex[p3].x, vertex[p3].y, vertex[p3].invZ }
+          };
+
+          SpanBufferAddTriangle(scratch->spanBuffer, e1, e2, e3,
+                                &point[0], &point[1], &point[2],
+                                canvas->fgColor);
+        }
+        break;
+
+      case RENDER_TEXTURE_MAPPING:
+        if (self->texture && mesh->texCoord) {
+          TexCoordT *uv = mesh->texCoord;
+          float tw = self->texture->width;
+          float th = self->texture->height;
+          int shade = ShadeColumn(scratch->polygonShade[polyExt->index]);
+          TriPointUV point[3];
+
+          point[0].x = vertex[p1].x;
+          point[0].y = vertex[p1].y;
+          point[0].z = vertex[p1].invZ;
+          point[0].u = uv[p1].u * tw;
+          point[0].v = uv[p1].v * th;
+
+          point[1].x = vertex[p2].x;
+          point[1].y = vertex[p2].y;
+          point[1].z = vertex[p2].invZ;
+          point[1].u = uv[p2].u * tw;
+          point[1].v = uv[p2].v * th;
+
+          point[2].x = vertex[p3].x;
+          point[2].y = vertex[p3].y;
+          point[2].z = vertex[p3].invZ;
+          point[2].u = uv[p3].u * tw;
+          point[2].v = uv[p3].v * th;
+
+          DrawTriangleUV(canvas, self->texture,
+                         &point[0], &point[1], &point[2], shade);
+        }
+        break;
     }
   }
 }
 
-void RenderSceneObject(SceneObjectT *self, PixBufT *canvas) {
+/*
+ * Estimates radius of the object on screen from the distance of its origin,
+ * so a whole level can be skipped before any vertex is transformed.
+ */
+static MeshT *SelectLOD(SceneObjectT *self) {
   MeshT *mesh = self->mesh;
+  Matrix3D *m = GetMatrix3D(self->ms, 0);
+  /* objects in front of the viewer have negative z */
+  float depth = -(*m)[3][2];
+  float scale, r, limit;
+
+  if (!mesh->lod || self->morph)
+    return mesh;
+
+  scale = sqrtf((*m)[0][0] * (*m)[0][0] + (*m)[0][1] * (*m)[0][1] +
+                (*m)[0][2] * (*m)[0][2]);
+
+  if (depth <= mesh->radius * scale)
+    return mesh;
+
+  r = mesh->radius * scale * fabsf(VIEWER_Z) / depth;
+
+  for (limit = self->lodRadius; mesh->lod && r < limit; limit *= 0.5f)
+    mesh = mesh->lod;
+
+  return mesh;
+}
+
+/*
+ * Normals left in scratch buffers by previous object are still valid if it
+ * had the same rotation and level of detail, e.g. copies of an object that
+ * differ only by position.
+ */
+static bool SameRotation(ObjectScratchT *scratch, MeshT *mesh, Matrix3D *m) {
+  int i, j;
+
+  if (scratch->normalMesh != mesh)
+    return false;
+
+  for (i = 0; i < 3; i++)
+    for (j = 0; j < 3; j++)
+      if (scratch->rotation[i][j] != (*m)[i][j])
+        return false;
+
+  return true;
+}
+
+static void SetRotation(ObjectScratchT *scratch, MeshT *mesh, Matrix3D *m) {
+  int i, j;
+
+  for (i = 0; i < 3; i++)
+    for (j = 0; j < 3; j++)
+      scratch->rotation[i][j] = (*m)[i][j];
+
+  scratch->normalMesh = mesh;
+  scratch->vertexNormalMesh = NULL;
+}
+
+void RenderSceneObjectWithLights(SceneObjectT *self, PixBufT *canvas,
+                                 LightSetT *lights)
+{
+  ObjectScratchT *scratch = self->scratch;
+  MeshT *mesh = SelectLOD(self);
+  Matrix3D *matrix = GetMatrix3D(self->ms, 0);
+  Vector3D *vertex = mesh->vertex;
+  Vector3D *surfaceNormal = mesh->surfaceNormal;
+  Vector3D *vertexNormal = mesh->vertexNormal;
+  Affine3D affine;
+  bool sameRotation;
+  bool binned = RenderBinned && (RenderMode == RENDER_FILLED ||
+                                 RenderMode == RENDER_FLAT_SHADING);
+
+  self->lodMesh = mesh;
+
+  /* Texture mapper itself is built without assertions. */
+  if (RenderMode == RENDER_TEXTURE_MAPPING && self->texture) {
+    PixBufT *texture = self->texture;
+
+    ASSERT(IsPowerOfTwo(texture->width) && IsPowerOfTwo(texture->height) &&
+           IsPowerOfTwo(texture->stride),
+           "Texture size (%d, %d) or stride %d is not a power of two.",
+           texture->width, texture->height, texture->stride);
+  }
+
+  /* Sorted polygons must refer to polygons of current level only. */
+  if (mesh != scratch->sortedMesh) {
+    size_t i;
+
+    for (i = 0; i < mesh->polygonNum; i++)
+      scratch->sortedPolygonExt[i] = &scratch->polygonExt[i];
+
+    scratch->sortedMesh = mesh;
+  }
+
+  /* Apply morph targets, the object uses deformed copy of the mesh. */
+  if (self->morph) {
+    MorphStateUpdate(self->morph);
+
+    vertex = self->morph->vertex;
+    surfaceNormal = self->morph->surfaceNormal;
+    vertexNormal = self->morph->vertexNormal;
+  }
+
+  LoadAffine3D(&affine, matrix);
 
   /* Apply vertex transformations. */
-  Transform3D(self->vertex, mesh->vertex, mesh->vertexNum,
-              GetMatrix3D(self->ms, 0));
+  if (mesh->qVertex)
+    TransformQuantized3D(scratch->vertex, mesh->qVertex, mesh->vertexNum,
+                         matrix, &mesh->qScale, &mesh->qOffset);
+  else
+    TransformAffine3D(scratch->vertex, vertex, mesh->vertexNum, &affine);
 
-  UpdateVertexExt(canvas, self->vertexExt, self->vertex, mesh->vertexNum);
+  UpdateVertexExt(canvas, scratch->vertexExt, scratch->vertex, mesh->vertexNum);
+
+  /* Morphed normals belong to the object, so they can't be reused. */
+  sameRotation = !self->morph && SameRotation(scratch, mesh, matrix);
 
   /* Apply transformations to surface normals */
-  Transform3D_2(self->surfaceNormal, mesh->surfaceNormal, mesh->polygonNum,
-                GetMatrix3D(self->ms, 0));
+  if (!sameRotation) {
+    if (mesh->qSurfaceNormal)
+      TransformOctNormals3D(scratch->surfaceNormal, mesh->qSurfaceNormal,
+                            mesh->polygonNum, matrix);
+    else
+      TransformNormalsAffine3D(scratch->surfaceNormal, surfaceNormal,
+                               mesh->polygonNum, &affine);
+
+    SetRotation(scratch, self->morph ? NULL : mesh, matrix);
+  }
 
   /* Calculate polygon normals & depths. */
-  UpdatePolygonExt(self->polygonExt, mesh->polygon, mesh->polygonNum,
-                   self->vertex, self->surfaceNormal);
+  UpdatePolygonExt(scratch->polygonExt, mesh->polygon, mesh->polygonNum,
+                   scratch->vertex, scratch->surfaceNormal,
+                   scratch->polygonCenter, !sameRotation);
 
-  if (RenderMode == RENDER_GOURAUD_SHADING)
-    UpdateVertexNormals(self->vertexExt, mesh->vertexToPoly.vertex,
-                        self->polygonExt, mesh->vertexNum);
+  if (RenderMode == RENDER_GOURAUD_SHADING &&
+      scratch->vertexNormalMesh != mesh)
+  {
+    Matrix3D m;
+
+    LoadIdentity3D(&m);
+    LoadNormalMatrix3D(&m, matrix);
+
+    if (mesh->qVertexNormal) {
+      TransformOctNormals3D(scratch->vertexNormal, mesh->qVertexNormal,
+                            mesh->vertexNum, &m);
+    } else {
+      ASSERT(vertexNormal, "Mesh has no vertex normals.");
 
-  /* Sort polygons by depth. */
-  QuickSortPolygonExtT(self->sortedPolygonExt, 0, mesh->polygonNum - 1);
+      LoadAffine3D(&affine, &m);
+      TransformNormalsAffine3D(scratch->vertexNormal, vertexNormal,
+                               mesh->vertexNum, &affine);
+    }
+
+    scratch->vertexNormalMesh = scratch->normalMesh;
+  }
 
-  /* Invalidate all edges */
+  /* Evaluate all lights in one pass over visible polygons or vertices. */
   {
-    VertexExtT *vertex = self->vertexExt;
-    int i;
+    if (!lights)
+      lights = self->lights ? self->lights : &DefaultLightSet;
+
+    if (RenderMode == RENDER_GOURAUD_SHADING) {
+      LightSetShade(lights, scratch->vertexShade, scratch->vertexNormal,
+                    scratch->vertex, NULL, mesh->vertexNum);
+    } else if (RenderMode >= RENDER_FLAT_SHADING) {
+      LightSetShade(lights, scratch->polygonShade, scratch->surfaceNormal,
+                    scratch->polygonCenter, scratch->visible,
+                    CollectVisiblePolygons(self));
+      UpdateShadeTable(scratch, canvas);
+    }
+  }
 
-    for (i = 0; i < mesh->edgeNum; i++) {
-      EdgeScanT *edgeScan = &self->edgeScan[i];
-      EdgeT *edge = &mesh->edge[i];
+  /*
+   * Sort polygons by depth.  Span buffer resolves visibility on its own, so
+   * the order of polygons doesn't matter in that case.
+   */
+  if (RenderMode != RENDER_SPAN_BUFFER)
+    QuickSortPolygonExtT(scratch->sortedPolygonExt, 0, mesh->polygonNum - 1);
 
-      float x1 = vertex[edge->p[0]].x;
-      float y1 = vertex[edge->p[0]].y;
-      float x2 = vertex[edge->p[1]].x;
-      float y2 = vertex[edge->p[1]].y;
+  /* Invalidate all edges. */
+  if (++scratch->epoch == 0)
+    scratch->epoch = 1;
 
-      if (y1 > y2) {
-        swapr(x1, x2);
-        swapr(y1, y2);
-      }
+  self->edgeScanCount = 0;
+  self->polygonCount = 0;
+
+  if (RenderMode == RENDER_SPAN_BUFFER) {
+    SpanBufferT *sbuf = scratch->spanBuffer;
+
+    if (!sbuf || sbuf->width != canvas->width ||
+        sbuf->height != canvas->height)
+    {
+      MemUnref(sbuf);
+      scratch->spanBuffer = NewSpanBuffer(canvas->width, canvas->height,
+                                          canvas->height * 64);
+    }
+
+    SpanBufferReset(scratch->spanBuffer);
+  }
 
-      InitEdgeScan(edgeScan, y1, y2, x1, x2);
+  if (binned) {
+    TileBufferT *tbuf = scratch->tileBuffer;
+
+    if (!tbuf || tbuf->width != canvas->width ||
+        tbuf->height != canvas->height)
+    {
+      MemUnref(tbuf);
+      scratch->tileBuffer = NewTileBuffer(canvas->width, canvas->height,
+                                          mesh->polygonNum);
     }
+
+    TileBufferReset(scratch->tileBuffer);
   }
 
   /* Render the object. */
   RenderObject(self, canvas);
+
+  if (RenderMode == RENDER_SPAN_BUFFER)
+    SpanBufferRender(scratch->spanBuffer, canvas);
+
+  if (binned)
+    TileBufferRender(scratch->tileBuffer, canvas);
+}
+
+void RenderSceneObject(SceneObjectT *self, PixBufT *canvas) {
+  RenderSceneObjectWithLights(self, canvas, NULL);
 }
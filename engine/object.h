@@ -2,8 +2,12 @@
 #define __ENGINE_SCENE_OBJECT_H__
 
 #include "gfx/pixbuf.h"
+#include "engine/light.h"
 #include "engine/mesh.h"
 #include "engine/ms3d.h"
+#include "engine/morph.h"
+#include "engine/sbuffer.h"
+#include "engine/tbuffer.h"
 #include "engine/triangle.h"
 
 typedef enum {
@@ -11,11 +15,15 @@ typedef enum {
   RENDER_WIREFRAME_AA,
   RENDER_FILLED,
   RENDER_FLAT_SHADING,
-  RENDER_GOURAUD_SHADING
+  RENDER_GOURAUD_SHADING,
+  RENDER_SPAN_BUFFER,
+  RENDER_TEXTURE_MAPPING
 } RenderModeT;
 
 extern RenderModeT RenderMode;
 extern bool RenderAllFaces;
+/* Filled and flat shaded triangles are binned and rasterized tile by tile. */
+extern bool RenderBinned;
 
 typedef struct PolygonExt {
   uint16_t index;
@@ -27,24 +35,100 @@ typedef struct PolygonExt {
 typedef struct VertexExt {
   uint8_t flags;
   float x, y;
-  Vector3D normal;
+  float invZ;
 } VertexExtT;
 
-typedef struct SceneObject {
-  char *name;
+/*
+ * Buffers that are recalculated each time an object is rendered.  Objects
+ * made of the same mesh are rendered one after another, so they can share
+ * a single set of them.
+ */
+typedef struct ObjectScratch {
   MeshT *mesh;
+  uint32_t users;
 
-  MatrixStack3D *ms;
   Vector3D *vertex;
   VertexExtT *vertexExt;
   PolygonExtT *polygonExt;
   PolygonExtT **sortedPolygonExt;
   EdgeScanT *edgeScan;
   Vector3D *surfaceNormal;
+  Vector3D *vertexNormal;
+  Vector3D *polygonCenter;
+  SpanBufferT *spanBuffer;
+  TileBufferT *tileBuffer;
+
+  /* light intensities in [0, 255] range */
+  uint8_t *polygonShade;
+  uint8_t *vertexShade;
+  /* polygons that face the viewer or are double sided */
+  uint16_t *visible;
+
+  /*
+   * Maps surface index and intensity to a color, i.e. (surface << 8) | shade.
+   * Rebuilt when canvas color map or its version changes.
+   */
+  uint8_t *shadeTable;
+  uint8_t *shadeTableCmap;
+  uint32_t shadeTableVersion;
+
+  /* level of detail that sorted polygons refer to */
+  MeshT *sortedMesh;
+
+  /*
+   * Normals are left from the last object rendered.  They're reused if the
+   * next one has the same rotation and level of detail.
+   */
+  MeshT *normalMesh;
+  MeshT *vertexNormalMesh;
+  float rotation[3][3];
+
+  /* edge scans are set up lazily, those from other frames are stale */
+  uint32_t epoch;
+} ObjectScratchT;
+
+typedef struct SceneObject {
+  char *name;
+  MeshT *mesh;
+
+  MatrixStack3D *ms;
+  ObjectScratchT *scratch;
+
+  /* lights shared with the scene, default one is used if not set */
+  LightSetT *lights;
+
+  /* created if the mesh has morph targets, weights are set by user */
+  MorphStateT *morph;
+
+  /*
+   * Level of detail used in last frame.  Coarser level is taken each time
+   * projected radius of the mesh halves below lodRadius (in pixels).
+   */
+  MeshT *lodMesh;
+  float lodRadius;
+
+  /* polygons that passed culling in last frame */
+  uint32_t polygonCount;
+  uint32_t edgeScanCount;
+
+  /* used in texture mapping mode, not owned by the object */
+  PixBufT *texture;
 } SceneObjectT;
 
 SceneObjectT *NewSceneObject(const char *name, MeshT *mesh);
 
+/*
+ * Instance has its own transformation, lights, texture and morph weights,
+ * but refers to the mesh and scratch buffers of the original.
+ */
+SceneObjectT *NewSceneObjectInstance(const char *name, SceneObjectT *original);
+
+/* Bytes owned by the object, not counting the mesh and shared buffers. */
+size_t SceneObjectMemoryUsage(SceneObjectT *self);
+
 void RenderSceneObject(SceneObjectT *self, PixBufT *canvas);
+/* Given lights (unless NULL) are used instead of those set for the object. */
+void RenderSceneObjectWithLights(SceneObjectT *self, PixBufT *canvas,
+                                 LightSetT *lights);
 
 #endif
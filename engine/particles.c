@@ -0,0 +1,306 @@
+#include "std/debug.h"
+#include "std/fastmath.h"
+#include "std/memory.h"
+#include "std/random.h"
+#include "engine/particles.h"
+
+static void DeleteParticleSystem(ParticleSystemT *self) {
+  MemUnref(self->x);
+  MemUnref(self->y);
+  MemUnref(self->z);
+  MemUnref(self->vx);
+  MemUnref(self->vy);
+  MemUnref(self->vz);
+  MemUnref(self->age);
+  MemUnref(self->life);
+  MemUnref(self->grid);
+  MemUnref(self->position);
+  MemUnref(self->after);
+  MemUnref(self->hit);
+}
+
+TYPEDECL(ParticleSystemT, (FreeFuncT)DeleteParticleSystem);
+
+ParticleSystemT *NewParticleSystem(size_t capacity) {
+  ParticleSystemT *self = NewInstance(ParticleSystemT);
+
+  self->capacity = capacity;
+  self->x = NewTable(float, capacity);
+  self->y = NewTable(float, capacity);
+  self->z = NewTable(float, capacity);
+  self->vx = NewTable(float, capacity);
+  self->vy = NewTable(float, capacity);
+  self->vz = NewTable(float, capacity);
+  self->age = NewTable(uint16_t, capacity);
+  self->life = NewTable(uint16_t, capacity);
+
+  return self;
+}
+
+void ParticleSystemAddEmitter(ParticleSystemT *self,
+                              ParticleEmitterFuncT func, PtrT data)
+{
+  ASSERT(self->emitterNum < PS_MAX_EMITTERS, "Too many emitters.");
+
+  self->emitter[self->emitterNum].func = func;
+  self->emitter[self->emitterNum].data = data;
+  self->emitterNum++;
+}
+
+void ParticleSystemAddForce(ParticleSystemT *self,
+                            ParticleForceFuncT func, PtrT data)
+{
+  ASSERT(self->forceNum < PS_MAX_FORCES, "Too many forces.");
+
+  self->force[self->forceNum].func = func;
+  self->force[self->forceNum].data = data;
+  self->forceNum++;
+}
+
+void ParticleSystemSetActors(ParticleSystemT *self,
+                             CollisionActorT *actor, size_t num)
+{
+  self->actor = actor;
+  self->actorNum = num;
+}
+
+void ParticleSystemEnableGrid(ParticleSystemT *self, float cellSize) {
+  ASSERT(!self->grid, "Grid is already enabled.");
+
+  self->grid = NewHashGrid(cellSize, self->capacity);
+  self->position = NewTable(Vector3D, self->capacity);
+  self->after = NewTable(Vector3D, self->capacity);
+  self->hit = NewTable(uint32_t, self->capacity);
+}
+
+bool ParticleEmit(ParticleSystemT *self, Vector3D *position,
+                  Vector3D *velocity, uint16_t life)
+{
+  size_t i = self->count;
+
+  if (i >= self->capacity)
+    return false;
+
+  self->x[i] = position->x;
+  self->y[i] = position->y;
+  self->z[i] = position->z;
+  self->vx[i] = velocity->x;
+  self->vy[i] = velocity->y;
+  self->vz[i] = velocity->z;
+  self->age[i] = 0;
+  self->life[i] = life;
+  self->count++;
+
+  return true;
+}
+
+static void BuildGrid(ParticleSystemT *self) {
+  Vector3D *position = self->position;
+  size_t i;
+
+  for (i = 0; i < self->count; i++) {
+    position[i].x = self->x[i];
+    position[i].y = self->y[i];
+    position[i].z = self->z[i];
+  }
+
+  HashGridBuild(self->grid, position, self->count);
+}
+
+/*
+ * Positions at the end of step are predicted the same way as in Integrate.
+ * Returns the longest distance a particle moves.
+ */
+static float PredictPositions(ParticleSystemT *self, float dt) {
+  const float damping = 1.0f - self->drag * dt;
+  const float gx = self->gravity.x * dt;
+  const float gy = self->gravity.y * dt;
+  const float gz = self->gravity.z * dt;
+  Vector3D *after = self->after;
+  float step2 = 0.0f;
+  size_t i;
+
+  for (i = 0; i < self->count; i++) {
+    float dx = (self->vx[i] * damping + gx) * dt;
+    float dy = (self->vy[i] * damping + gy) * dt;
+    float dz = (self->vz[i] * damping + gz) * dt;
+
+    after[i].x = self->x[i] + dx;
+    after[i].y = self->y[i] + dy;
+    after[i].z = self->z[i] + dz;
+
+    step2 = max(step2, dx * dx + dy * dy + dz * dz);
+  }
+
+  return sqrtf(step2);
+}
+
+/*
+ * Particles that would cross a surface of any actor during this step are
+ * marked as dead.  A particle can only hit a bounded actor if it's closer to
+ * its bounding sphere than it moves within a step, so only those are looked
+ * up in the grid.  Unbounded actors test every particle.
+ */
+static void Collide(ParticleSystemT *self, float dt) {
+  float step = PredictPositions(self, dt);
+  size_t i, j;
+
+  for (i = 0; i < self->actorNum; i++) {
+    CollisionActorT *actor = &self->actor[i];
+    SphereT *bound = actor->bound;
+
+    if (bound) {
+      size_t hits = HashGridCollide(self->grid, actor, &bound->center,
+                                    bound->radius + step, self->after,
+                                    self->hit, self->capacity);
+
+      for (j = 0; j < hits; j++)
+        self->life[self->hit[j]] = 0;
+    } else {
+      for (j = 0; j < self->count; j++)
+        if (DetectCollision(actor, &self->position[j], &self->after[j]))
+          self->life[j] = 0;
+    }
+  }
+}
+
+/* Without the grid every particle is tested against every actor. */
+static void CollideLinear(ParticleSystemT *self, float dt) {
+  const float damping = 1.0f - self->drag * dt;
+  const float gx = self->gravity.x * dt;
+  const float gy = self->gravity.y * dt;
+  const float gz = self->gravity.z * dt;
+  size_t i;
+
+  for (i = 0; i < self->count; i++) {
+    Vector3D before = { self->x[i], self->y[i], self->z[i] };
+    Vector3D after = {
+      before.x + (self->vx[i] * damping + gx) * dt,
+      before.y + (self->vy[i] * damping + gy) * dt,
+      before.z + (self->vz[i] * damping + gz) * dt
+    };
+
+    if (FindCollision(self->actor, self->actorNum, &before, &after))
+      self->life[i] = 0;
+  }
+}
+
+/*
+ * Gravity, drag, velocity, position and age are updated in one pass without
+ * any branches.
+ */
+static void Integrate(ParticleSystemT *self, float dt) {
+  const float damping = 1.0f - self->drag * dt;
+  const float gx = self->gravity.x * dt;
+  const float gy = self->gravity.y * dt;
+  const float gz = self->gravity.z * dt;
+  float *__restrict__ x = self->x;
+  float *__restrict__ y = self->y;
+  float *__restrict__ z = self->z;
+  float *__restrict__ vx = self->vx;
+  float *__restrict__ vy = self->vy;
+  float *__restrict__ vz = self->vz;
+  uint16_t *__restrict__ age = self->age;
+  size_t i, n = self->count;
+
+  for (i = 0; i < n; i++) {
+    vx[i] = vx[i] * damping + gx;
+    vy[i] = vy[i] * damping + gy;
+    vz[i] = vz[i] * damping + gz;
+    x[i] += vx[i] * dt;
+    y[i] += vy[i] * dt;
+    z[i] += vz[i] * dt;
+    age[i]++;
+  }
+}
+
+/* Dead particles are replaced by the last ones, so the tables stay packed. */
+static void RemoveDead(ParticleSystemT *self) {
+  size_t i = 0, n = self->count;
+
+  while (i < n) {
+    if (self->age[i] < self->life[i]) {
+      i++;
+      continue;
+    }
+
+    n--;
+
+    self->x[i] = self->x[n];
+    self->y[i] = self->y[n];
+    self->z[i] = self->z[n];
+    self->vx[i] = self->vx[n];
+    self->vy[i] = self->vy[n];
+    self->vz[i] = self->vz[n];
+    self->age[i] = self->age[n];
+    self->life[i] = self->life[n];
+  }
+
+  self->count = n;
+}
+
+void ParticleSystemStep(ParticleSystemT *self, float dt) {
+  size_t i;
+
+  for (i = 0; i < self->emitterNum; i++) {
+    ParticleEmitterFuncT func = self->emitter[i].func;
+
+    func(self, self->emitter[i].data);
+  }
+
+  if (self->grid)
+    BuildGrid(self);
+
+  for (i = 0; i < self->forceNum; i++) {
+    ParticleForceFuncT func = self->force[i].func;
+
+    func(self, self->force[i].data, dt);
+  }
+
+  if (self->actorNum) {
+    if (self->grid)
+      Collide(self, dt);
+    else
+      CollideLinear(self, dt);
+  }
+
+  Integrate(self, dt);
+  RemoveDead(self);
+}
+
+void EmitFromPoint(ParticleSystemT *ps, PointEmitterT *emitter) {
+  size_t i;
+
+  for (i = 0; i < emitter->rate; i++) {
+    /* Uniformly distributed direction. */
+    float z = RandomFloat(&emitter->seed) * 2.0f - 1.0f;
+    float angle = RandomFloat(&emitter->seed) * 2.0f * M_PI;
+    float r = sqrtf(1.0f - z * z) * emitter->speed;
+    Vector3D velocity = { cosf(angle) * r, sinf(angle) * r,
+                          z * emitter->speed };
+
+    if (!ParticleEmit(ps, &emitter->position, &velocity, emitter->life))
+      break;
+  }
+}
+
+void ApplyAttractor(ParticleSystemT *ps, AttractorT *attractor, float dt) {
+  const float px = attractor->position.x;
+  const float py = attractor->position.y;
+  const float pz = attractor->position.z;
+  const float k = attractor->strength * dt;
+  size_t i;
+
+  for (i = 0; i < ps->count; i++) {
+    float dx = px - ps->x[i];
+    float dy = py - ps->y[i];
+    float dz = pz - ps->z[i];
+    /* softened inverse square law, so that it doesn't explode at center */
+    float l = FastInvSqrt(dx * dx + dy * dy + dz * dz + 1.0f);
+    float a = k * l * l * l;
+
+    ps->vx[i] += dx * a;
+    ps->vy[i] += dy * a;
+    ps->vz[i] += dz * a;
+  }
+}
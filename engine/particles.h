@@ -0,0 +1,98 @@
+#ifndef __ENGINE_PARTICLES_H__
+#define __ENGINE_PARTICLES_H__
+
+#include "engine/collision.h"
+#include "engine/hashgrid.h"
+
+#define PS_MAX_EMITTERS 4
+#define PS_MAX_FORCES   4
+
+typedef struct ParticleSystem ParticleSystemT;
+
+/* Emitters are called once per step and add particles with ParticleEmit. */
+typedef void (*ParticleEmitterFuncT)(ParticleSystemT *ps, PtrT data);
+/* Forces change velocities of all particles in a single loop. */
+typedef void (*ParticleForceFuncT)(ParticleSystemT *ps, PtrT data, float dt);
+
+typedef struct ParticleCallback {
+  PtrT func;
+  PtrT data;
+} ParticleCallbackT;
+
+/*
+ * Particles are kept in separate tables per component, packed at the front,
+ * so that each pass is a plain loop over [0, count).  A dead particle is
+ * replaced by the last one, hence indices are not stable between steps.
+ */
+struct ParticleSystem {
+  size_t count;
+  size_t capacity;
+
+  float *x, *y, *z;
+  float *vx, *vy, *vz;
+  uint16_t *age;
+  uint16_t *life;
+
+  /* uniform forces folded into integration */
+  Vector3D gravity;
+  float drag;
+
+  ParticleCallbackT emitter[PS_MAX_EMITTERS];
+  size_t emitterNum;
+  ParticleCallbackT force[PS_MAX_FORCES];
+  size_t forceNum;
+
+  /* particles that hit any of them die, not owned */
+  CollisionActorT *actor;
+  size_t actorNum;
+
+  /*
+   * Built at the start of each step, before forces are applied, if enabled
+   * by ParticleSystemEnableGrid.  Point i is particle i, so forces can look
+   * up neighbours.  Bounded actors test only particles close to them.
+   */
+  HashGridT *grid;
+  Vector3D *position;
+  /* positions at the end of step, and particles hit by an actor */
+  Vector3D *after;
+  uint32_t *hit;
+};
+
+ParticleSystemT *NewParticleSystem(size_t capacity);
+
+void ParticleSystemAddEmitter(ParticleSystemT *self,
+                              ParticleEmitterFuncT func, PtrT data);
+void ParticleSystemAddForce(ParticleSystemT *self,
+                            ParticleForceFuncT func, PtrT data);
+void ParticleSystemSetActors(ParticleSystemT *self,
+                             CollisionActorT *actor, size_t num);
+/* Cell size should be close to the radius of neighbour queries. */
+void ParticleSystemEnableGrid(ParticleSystemT *self, float cellSize);
+
+/* Returns false if there's no room for another particle. */
+bool ParticleEmit(ParticleSystemT *self, Vector3D *position,
+                  Vector3D *velocity, uint16_t life);
+
+void ParticleSystemStep(ParticleSystemT *self, float dt);
+
+/* Emits particles in random directions from a point. */
+typedef struct PointEmitter {
+  Vector3D position;
+  float speed;
+  /* particles emitted per step */
+  size_t rate;
+  uint16_t life;
+  int32_t seed;
+} PointEmitterT;
+
+void EmitFromPoint(ParticleSystemT *ps, PointEmitterT *emitter);
+
+/* Pulls particles towards a point with force falling with distance. */
+typedef struct Attractor {
+  Vector3D position;
+  float strength;
+} AttractorT;
+
+void ApplyAttractor(ParticleSystemT *ps, AttractorT *attractor, float dt);
+
+#endif
@@ -8,7 +8,7 @@ void PlaneNormalize(PlaneT *plane) {
 }
 
 void PlaneFromPointAndVector(PlaneT *plane, Vector3D *point, Vector3D *vector) {
-  V3D_Normalize(&plane->v, &plane->v, V3D_Length(vector));
+  V3D_NormalizeToUnit(&plane->v, vector);
   plane->d = -V3D_Dot(&plane->v, point);
 }
 
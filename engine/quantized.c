@@ -0,0 +1,106 @@
+#include "std/math.h"
+#include "engine/quantized.h"
+
+#define M(A,I,J) (*A)[I][J]
+
+#define QMAX 32767
+
+void EncodeOctNormal(OctNormalT *dst, Vector3D *src) {
+  float l = fabsf(src->x) + fabsf(src->y) + fabsf(src->z);
+  float u = src->x / l;
+  float v = src->y / l;
+
+  /* Fold the lower hemisphere over the diagonals. */
+  if (src->z < 0.0f) {
+    float fu = (1.0f - fabsf(v)) * ((u >= 0.0f) ? 1.0f : -1.0f);
+    float fv = (1.0f - fabsf(u)) * ((v >= 0.0f) ? 1.0f : -1.0f);
+
+    u = fu;
+    v = fv;
+  }
+
+  dst->u = lroundf(u * QMAX);
+  dst->v = lroundf(v * QMAX);
+}
+
+/*
+ * Decoding is done in integer units, since normalization gets rid of the
+ * scale anyway.
+ */
+static inline void OctNormalToVector(Vector3D *dst, OctNormalT *src) {
+  int u = src->u;
+  int v = src->v;
+  int z = QMAX - abs(u) - abs(v);
+  float x, y, l;
+
+  if (z < 0) {
+    int fu = QMAX - abs(v);
+    int fv = QMAX - abs(u);
+
+    u = (u >= 0) ? fu : -fu;
+    v = (v >= 0) ? fv : -fv;
+  }
+
+  x = u;
+  y = v;
+  l = FastInvSqrt(x * x + y * y + (float)(z * z));
+
+  dst->x = x * l;
+  dst->y = y * l;
+  dst->z = z * l;
+}
+
+void DecodeOctNormal(Vector3D *dst, OctNormalT *src) {
+  OctNormalToVector(dst, src);
+}
+
+/*
+ * Scale and offset are folded into the matrix, so dequantization costs only
+ * conversions from integers.
+ */
+void TransformQuantized3D(Vector3D *dst, QuantVertexT *src, int n,
+                          Matrix3D *m, Vector3D *scale, Vector3D *offset)
+{
+  float m00 = M(m,0,0) * scale->x;
+  float m01 = M(m,0,1) * scale->x;
+  float m02 = M(m,0,2) * scale->x;
+  float m10 = M(m,1,0) * scale->y;
+  float m11 = M(m,1,1) * scale->y;
+  float m12 = M(m,1,2) * scale->y;
+  float m20 = M(m,2,0) * scale->z;
+  float m21 = M(m,2,1) * scale->z;
+  float m22 = M(m,2,2) * scale->z;
+  float m30 = M(m,0,0) * offset->x + M(m,1,0) * offset->y +
+              M(m,2,0) * offset->z + M(m,3,0);
+  float m31 = M(m,0,1) * offset->x + M(m,1,1) * offset->y +
+              M(m,2,1) * offset->z + M(m,3,1);
+  float m32 = M(m,0,2) * offset->x + M(m,1,2) * offset->y +
+              M(m,2,2) * offset->z + M(m,3,2);
+  int i;
+
+  for (i = 0; i < n; i++) {
+    float x = src[i].x;
+    float y = src[i].y;
+    float z = src[i].z;
+
+    dst[i].x = m00 * x + m10 * y + m20 * z + m30;
+    dst[i].y = m01 * x + m11 * y + m21 * z + m31;
+    dst[i].z = m02 * x + m12 * y + m22 * z + m32;
+  }
+}
+
+void TransformOctNormals3D(Vector3D *dst, OctNormalT *src, int n,
+                           Matrix3D *m)
+{
+  int i;
+
+  for (i = 0; i < n; i++) {
+    Vector3D normal;
+
+    OctNormalToVector(&normal, &src[i]);
+
+    dst[i].x = M(m,0,0) * normal.x + M(m,1,0) * normal.y + M(m,2,0) * normal.z;
+    dst[i].y = M(m,0,1) * normal.x + M(m,1,1) * normal.y + M(m,2,1) * normal.z;
+    dst[i].z = M(m,0,2) * normal.x + M(m,1,2) * normal.y + M(m,2,2) * normal.z;
+  }
+}
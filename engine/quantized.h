@@ -0,0 +1,35 @@
+#ifndef __ENGINE_QUANTIZED_H__
+#define __ENGINE_QUANTIZED_H__
+
+#include "engine/matrix3d.h"
+
+/*
+ * Position quantized to 16-bit integers.  The real position is calculated as
+ * q * scale + offset, where scale and offset are given for the whole mesh.
+ */
+typedef struct QuantVertex {
+  int16_t x, y, z;
+} QuantVertexT;
+
+/*
+ * Unit vector in octahedral encoding, i.e. projected onto an octahedron that
+ * is unfolded onto a square.  Coordinates are in [-32767, 32767] range.
+ */
+typedef struct OctNormal {
+  int16_t u, v;
+} OctNormalT;
+
+void EncodeOctNormal(OctNormalT *dst, Vector3D *src);
+void DecodeOctNormal(Vector3D *dst, OctNormalT *src);
+
+/*
+ * Both kernels are counterparts of Transform3D and Transform3D_2, but
+ * dequantize their input on the fly.  Normals are returned as unit vectors
+ * if the matrix does not scale.
+ */
+void TransformQuantized3D(Vector3D *dst, QuantVertexT *src, int n,
+                          Matrix3D *m, Vector3D *scale, Vector3D *offset);
+void TransformOctNormals3D(Vector3D *dst, OctNormalT *src, int n,
+                           Matrix3D *m);
+
+#endif
@@ -0,0 +1,298 @@
+#include <string.h>
+
+#include "std/debug.h"
+#include "std/math.h"
+#include "std/memory.h"
+#include "engine/sbuffer.h"
+
+static void DeleteSpanBuffer(SpanBufferT *self) {
+  MemUnref(self->line);
+  MemUnref(self->span);
+}
+
+TYPEDECL(SpanBufferT, (FreeFuncT)DeleteSpanBuffer);
+
+SpanBufferT *NewSpanBuffer(size_t width, size_t height, size_t maxSpans) {
+  SpanBufferT *self = NewInstance(SpanBufferT);
+
+  self->width = width;
+  self->height = height;
+  self->line = NewTable(SpanT *, height);
+  self->span = NewTable(SpanT, maxSpans);
+  self->spanMax = maxSpans;
+
+  return self;
+}
+
+void SpanBufferReset(SpanBufferT *self) {
+  memset(self->line, 0, sizeof(SpanT *) * self->height);
+
+  self->spanNum = 0;
+  self->pixelsIn = 0;
+  self->pixelsOut = 0;
+}
+
+static inline SpanT *NewSpan(SpanBufferT *self, int xs, int xe,
+                             float z, float dz, uint8_t color, SpanT *next)
+{
+  SpanT *span;
+
+  if (self->spanNum >= self->spanMax)
+    return NULL;
+
+  span = &self->span[self->spanNum++];
+  span->next = next;
+  span->xs = xs;
+  span->xe = xe;
+  span->color = color;
+  span->z = z;
+  span->dz = dz;
+
+  return span;
+}
+
+/*
+ * Inserts span [xs, xe) into a sorted list of non-overlapping spans.  Parts of
+ * the span that are hidden behind existing spans are discarded, visible parts
+ * replace (or split) existing spans.  If depths of two spans cross, then the
+ * overlapping part is split at the intersection point.
+ *
+ * When the pool of spans is exhausted the rest of the span is dropped.
+ */
+__regargs static void
+SpanListInsert(SpanBufferT *self, SpanT **link, int xs, int xe,
+               float z, float dz, uint8_t color)
+{
+  while (xs < xe) {
+    SpanT *cur = *link;
+
+    /* Skip spans that lie entirely on the left. */
+    while (cur && cur->xe <= xs) {
+      link = &cur->next;
+      cur = *link;
+    }
+
+    if (!cur || cur->xs >= xe) {
+      SpanT *span = NewSpan(self, xs, xe, z, dz, color, cur);
+
+      if (span)
+        *link = span;
+      return;
+    }
+
+    if (xs < cur->xs) {
+      /* The part on the left of current span is visible. */
+      SpanT *span = NewSpan(self, xs, cur->xs, z, dz, color, cur);
+
+      if (!span)
+        return;
+
+      *link = span;
+      link = &span->next;
+      z += dz * (cur->xs - xs);
+      xs = cur->xs;
+    }
+
+    /* Now cur->xs <= xs < cur->xe, so resolve overlapping part. */
+    {
+      int end = min(xe, (int)cur->xe);
+      float oz = cur->z + cur->dz * (xs - cur->xs);
+      float d0 = z - oz;
+      float d1 = d0 + (dz - cur->dz) * (end - 1 - xs);
+
+      if ((d0 > 0.0f) != (d1 > 0.0f)) {
+        int split = xs + 1 + (int)(d0 / (cur->dz - dz));
+
+        if (split < end)
+          end = split;
+      }
+
+      if (d0 > 0.0f) {
+        /* New span is closer - overwrite [xs, end) range of current one. */
+        if (cur->xs < xs) {
+          SpanT *left = NewSpan(self, cur->xs, xs, cur->z, cur->dz,
+                                cur->color, cur);
+
+          if (!left)
+            return;
+
+          *link = left;
+          link = &left->next;
+          cur->xs = xs;
+          cur->z = oz;
+        }
+
+        if (cur->xe > end) {
+          SpanT *span = NewSpan(self, xs, end, z, dz, color, cur);
+
+          if (!span)
+            return;
+
+          *link = span;
+          link = &span->next;
+          cur->z += cur->dz * (end - xs);
+          cur->xs = end;
+        } else {
+          cur->z = z;
+          cur->dz = dz;
+          cur->color = color;
+          link = &cur->next;
+        }
+      } else if (end == cur->xe) {
+        link = &cur->next;
+      }
+
+      z += dz * (end - xs);
+      xs = end;
+    }
+  }
+}
+
+typedef struct DepthPlane {
+  float a, b, c;
+} DepthPlaneT;
+
+/*
+ * Inverse depth is linear in screen space, so it can be expressed as
+ * z(x, y) = a * x + b * y + c.
+ */
+static bool CalcDepthPlane(DepthPlaneT *plane,
+                           Vector3D *p1, Vector3D *p2, Vector3D *p3)
+{
+  float x1 = p2->x - p1->x;
+  float y1 = p2->y - p1->y;
+  float z1 = p2->z - p1->z;
+  float x2 = p3->x - p1->x;
+  float y2 = p3->y - p1->y;
+  float z2 = p3->z - p1->z;
+  float det = x1 * y2 - x2 * y1;
+
+  if (fabsf(det) < 1e-3f)
+    return false;
+
+  det = 1.0f / det;
+
+  plane->a = (z1 * y2 - z2 * y1) * det;
+  plane->b = (x1 * z2 - x2 * z1) * det;
+  plane->c = p1->z - plane->a * p1->x - plane->b * p1->y;
+
+  return true;
+}
+
+__attribute__((regparm(4))) static void
+SpanBufferAddSegment(SpanBufferT *self, EdgeScanT *left, EdgeScanT *right,
+                     int ys, int ye, DepthPlaneT *plane, uint8_t color)
+{
+  FP16 lx = left->x;
+  FP16 rx = right->x;
+  FP16 ldx = left->dx;
+  FP16 rdx = right->dx;
+  int width = self->width;
+
+  if (ye > self->height)
+    ye = self->height;
+
+  for (; ys < ye; ys++) {
+    if (ys >= 0) {
+      int xs = FP16_rintf(lx);
+      int xe = FP16_rintf(rx);
+
+      if (xs < 0)
+        xs = 0;
+      if (xe > width)
+        xe = width;
+
+      if (xs < xe) {
+        float z = plane->a * xs + plane->b * ys + plane->c;
+
+        self->pixelsIn += xe - xs;
+
+        SpanListInsert(self, &self->line[ys], xs, xe, z, plane->a, color);
+      }
+    }
+
+    lx = FP16_add(lx, ldx);
+    rx = FP16_add(rx, rdx);
+  }
+
+  left->x = lx;
+  right->x = rx;
+}
+
+void SpanBufferAddTriangle(SpanBufferT *self,
+                           EdgeScanT *e1, EdgeScanT *e2, EdgeScanT *e3,
+                           Vector3D *p1, Vector3D *p2, Vector3D *p3,
+                           uint8_t color)
+{
+  DepthPlaneT plane;
+
+  if (!CalcDepthPlane(&plane, p1, p2, p3))
+    return;
+
+  if (e1->ys > e2->ys)
+    swapr(e1, e2);
+  if (e2->ys > e3->ys)
+    swapr(e2, e3);
+  if (e1->ye > e2->ye)
+    swapr(e1, e2);
+  if (e1->ye > e3->ye)
+    swapr(e1, e3);
+
+  {
+    EdgeScanT l12 = *e1;
+    EdgeScanT l13 = *e2; /* long one */
+    EdgeScanT l23 = *e3;
+    EdgeScanT *left;
+    EdgeScanT *right;
+    bool longOnRight;
+
+    if (l12.ys == l12.ye)
+      longOnRight = (l13.xs > l23.xs);
+    else if (l23.ys == l23.ye)
+      longOnRight = (l13.xe > l12.xe);
+    else
+      longOnRight = (l12.dx.v < l13.dx.v);
+
+    if (longOnRight) {
+      left = &l12; right = &l13;
+    } else {
+      left = &l13; right = &l12;
+    }
+
+    if (l12.ys != l12.ye)
+      SpanBufferAddSegment(self, left, right, l12.ys, l12.ye, &plane, color);
+
+    if (longOnRight) {
+      left = &l23;
+    } else {
+      right = &l23;
+    }
+
+    if (l23.ys != l23.ye)
+      SpanBufferAddSegment(self, left, right, l23.ys, l23.ye, &plane, color);
+  }
+}
+
+/*
+ * Each pixel covered by spans is written exactly once.
+ */
+void SpanBufferRender(SpanBufferT *self, PixBufT *canvas) {
+  uint8_t *pixels = canvas->data;
+  int y;
+
+  ASSERT(canvas->width == self->width && canvas->height == self->height,
+         "Canvas size does not match span buffer size.");
+
+  if (self->spanNum >= self->spanMax)
+    LOG("Span buffer overflow (%d spans).", (int)self->spanMax);
+
+  for (y = 0; y < self->height; y++, pixels += canvas->stride) {
+    SpanT *span;
+
+    for (span = self->line[y]; span; span = span->next) {
+      memset(pixels + span->xs, span->color, span->xe - span->xs);
+      PixBufMarkDirty(canvas, span->xs, y, span->xe - span->xs, 1);
+      self->pixelsOut += span->xe - span->xs;
+    }
+  }
+}
@@ -0,0 +1,47 @@
+#ifndef __ENGINE_SBUFFER_H__
+#define __ENGINE_SBUFFER_H__
+
+#include "gfx/pixbuf.h"
+#include "engine/triangle.h"
+#include "engine/vector3d.h"
+
+typedef struct Span SpanT;
+
+struct Span {
+  SpanT *next;
+  int16_t xs, xe;
+  uint8_t color;
+  /* inverse depth at xs and its change per pixel */
+  float z, dz;
+};
+
+typedef struct SpanBuffer {
+  size_t width, height;
+
+  /* per scanline list of non-overlapping spans sorted by x */
+  SpanT **line;
+
+  SpanT *span;
+  size_t spanNum;
+  size_t spanMax;
+
+  /* statistics: pixels covered by inserted spans vs. pixels written */
+  uint32_t pixelsIn;
+  uint32_t pixelsOut;
+} SpanBufferT;
+
+SpanBufferT *NewSpanBuffer(size_t width, size_t height, size_t maxSpans);
+
+/*
+ * Points are given in screen space, where z component is the inverse depth
+ * (a value that is greater for points closer to the viewer).
+ */
+void SpanBufferAddTriangle(SpanBufferT *self,
+                           EdgeScanT *e1, EdgeScanT *e2, EdgeScanT *e3,
+                           Vector3D *p1, Vector3D *p2, Vector3D *p3,
+                           uint8_t color);
+
+void SpanBufferRender(SpanBufferT *self, PixBufT *canvas);
+void SpanBufferReset(SpanBufferT *self);
+
+#endif
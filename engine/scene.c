@@ -4,6 +4,7 @@
 
 struct Scene {
   ListT *objects;
+  LightSetT *lights;
 };
 
 static void DeleteScene(SceneT *self) {
@@ -24,6 +25,10 @@ void SceneAddObject(SceneT *self, SceneObjectT *object) {
   ListPushBack(self->objects, object);
 }
 
+void SceneSetLights(SceneT *self, LightSetT *lights) {
+  self->lights = lights;
+}
+
 static CmpT CompareName(const SceneObjectT *obj, const char *name) {
   return strcmp(obj->name, name);
 }
@@ -40,7 +45,7 @@ SceneObjectT *GetObject(SceneT *self, const char *name) {
 
 void RenderScene(SceneT *self, PixBufT *canvas) {
   void RenderObject(SceneObjectT *obj) {
-    RenderSceneObject(obj, canvas);
+    RenderSceneObjectWithLights(obj, canvas, self->lights);
   }
 
   ListForEach(self->objects, (IterFuncT)RenderObject, NULL);
@@ -7,6 +7,8 @@ typedef struct Scene SceneT;
 
 SceneT *NewScene();
 void SceneAddObject(SceneT *self, SceneObjectT *object);
+/* Lights are not owned by the scene and override those set for objects. */
+void SceneSetLights(SceneT *self, LightSetT *lights);
 SceneObjectT *GetObject(SceneT *self, const char *name);
 MatrixStack3D *GetObjectTranslation(SceneT *self, const char *name);
 void RenderScene(SceneT *self, PixBufT *canvas);
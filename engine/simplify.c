@@ -0,0 +1,477 @@
+#include "std/debug.h"
+#include "std/math.h"
+#include "std/memory.h"
+#include "std/table.h"
+#include "engine/simplify.h"
+
+/*
+ * Symmetric 4x4 matrix, so only the upper triangle is stored:
+ *
+ * | a b c d |
+ * | b e f g |
+ * | c f h i |
+ * | d g i j |
+ */
+typedef struct Quadric {
+  float a, b, c, d, e, f, g, h, i, j;
+} QuadricT;
+
+static void QuadricAddPlane(QuadricT *q, Vector3D *n, float d, float w) {
+  q->a += w * n->x * n->x;
+  q->b += w * n->x * n->y;
+  q->c += w * n->x * n->z;
+  q->d += w * n->x * d;
+  q->e += w * n->y * n->y;
+  q->f += w * n->y * n->z;
+  q->g += w * n->y * d;
+  q->h += w * n->z * n->z;
+  q->i += w * n->z * d;
+  q->j += w * d * d;
+}
+
+static void QuadricAdd(QuadricT *d, QuadricT *a, QuadricT *b) {
+  d->a = a->a + b->a;
+  d->b = a->b + b->b;
+  d->c = a->c + b->c;
+  d->d = a->d + b->d;
+  d->e = a->e + b->e;
+  d->f = a->f + b->f;
+  d->g = a->g + b->g;
+  d->h = a->h + b->h;
+  d->i = a->i + b->i;
+  d->j = a->j + b->j;
+}
+
+/* Sum of squared distances of the point from planes accumulated in q. */
+static float QuadricError(QuadricT *q, Vector3D *v) {
+  float x = v->x, y = v->y, z = v->z;
+
+  return x * (q->a * x + 2.0f * (q->b * y + q->c * z + q->d)) +
+         y * (q->e * y + 2.0f * (q->f * z + q->g)) +
+         z * (q->h * z + 2.0f * q->i) + q->j;
+}
+
+typedef struct Collapse {
+  float cost;
+  /* vertex v is merged into u, which is moved to p */
+  uint16_t u, v;
+  Vector3D p;
+} CollapseT;
+
+__regargs static bool CollapseCmp(const PtrT a, const PtrT b) {
+  return ((const CollapseT *)a)->cost < ((const CollapseT *)b)->cost;
+}
+
+/*
+ * Works on a copy of the mesh.  Its edges and vertex to polygon map are
+ * calculated with the same routines as for rendering, but have to be rebuilt
+ * before each pass, since collapses change the topology.
+ */
+typedef struct Simplifier {
+  MeshT *mesh;
+  size_t alive;
+
+  QuadricT *quadric;
+  /* polygons removed in current pass */
+  bool *dead;
+  /* number of polygons sharing an edge */
+  uint16_t *valence;
+
+  /* vertices that cannot be moved in current pass */
+  bool *locked;
+
+  uint32_t *mark;
+  uint32_t markEpoch;
+} SimplifierT;
+
+/* Iterates over alive polygons containing vertex V, I is polygon number. */
+#define FOREACH_POLYGON(S, V, T, I)                                   \
+  for (T = 0; T < S->mesh->vertexToPoly.vertex[V].count; T++)         \
+    if (!S->dead[I = S->mesh->vertexToPoly.vertex[V].index[T]])
+
+static inline bool HasVertex(TriangleT *polygon, int v) {
+  return polygon->p[0] == v || polygon->p[1] == v || polygon->p[2] == v;
+}
+
+/* Drops polygons removed in previous pass and updates the topology. */
+static void UpdateTopology(SimplifierT *s) {
+  MeshT *mesh = s->mesh;
+  size_t i, n;
+
+  for (i = 0, n = 0; i < mesh->polygonNum; i++)
+    if (!s->dead[i])
+      mesh->polygon[n++] = mesh->polygon[i];
+
+  mesh->polygonNum = n;
+
+  for (i = 0; i < n; i++)
+    s->dead[i] = false;
+
+  MemUnref(mesh->edge);
+  MemUnref(mesh->vertexToPoly.vertex);
+  MemUnref(mesh->vertexToPoly.indices);
+
+  MeshCalculateEdges(mesh);
+  CalculateVertexToPolygonMap(mesh);
+}
+
+/*
+ * Vertices on boundary or non-manifold edges are locked, so the silhouette
+ * of open meshes is preserved.
+ */
+static void LockBoundary(SimplifierT *s) {
+  MeshT *mesh = s->mesh;
+  size_t i, k;
+
+  for (i = 0; i < mesh->vertexNum; i++)
+    s->locked[i] = false;
+
+  for (i = 0; i < mesh->edgeNum; i++)
+    s->valence[i] = 0;
+
+  for (i = 0; i < mesh->polygonNum; i++)
+    for (k = 0; k < 3; k++)
+      s->valence[mesh->polygon[i].e[k]]++;
+
+  for (i = 0; i < mesh->edgeNum; i++) {
+    if (s->valence[i] != 2) {
+      EdgeT *edge = &mesh->edge[i];
+
+      s->locked[edge->p[0]] = s->locked[edge->p[1]] = true;
+    }
+  }
+}
+
+/*
+ * Edge can be collapsed without changing topology if both vertices have
+ * exactly two common neighbours.
+ */
+static bool CheckLink(SimplifierT *s, int u, int v) {
+  uint32_t epoch = (s->markEpoch += 2);
+  size_t t, i;
+  int common = 0;
+  int k;
+
+  FOREACH_POLYGON(s, u, t, i) {
+    TriangleT *polygon = &s->mesh->polygon[i];
+
+    for (k = 0; k < 3; k++)
+      s->mark[polygon->p[k]] = epoch;
+  }
+
+  FOREACH_POLYGON(s, v, t, i) {
+    TriangleT *polygon = &s->mesh->polygon[i];
+
+    for (k = 0; k < 3; k++) {
+      int w = polygon->p[k];
+
+      if (w != u && w != v && s->mark[w] == epoch) {
+        s->mark[w] = epoch + 1;
+        common++;
+      }
+    }
+  }
+
+  return common == 2;
+}
+
+static void PolygonNormal(Vector3D *n, Vector3D *p0, Vector3D *p1,
+                          Vector3D *p2)
+{
+  Vector3D a, b;
+
+  V3D_Sub(&a, p1, p0);
+  V3D_Sub(&b, p2, p0);
+  V3D_Cross(n, &a, &b);
+}
+
+/* Checks if moving vertex w to p flips any of surrounding polygons. */
+static bool CheckFlip(SimplifierT *s, int w, int other, Vector3D *p) {
+  size_t t, i;
+
+  FOREACH_POLYGON(s, w, t, i) {
+    TriangleT *polygon = &s->mesh->polygon[i];
+    Vector3D *v[3], before, after;
+    int k;
+
+    if (HasVertex(polygon, other))
+      continue;
+
+    for (k = 0; k < 3; k++)
+      v[k] = &s->mesh->vertex[polygon->p[k]];
+
+    PolygonNormal(&before, v[0], v[1], v[2]);
+
+    for (k = 0; k < 3; k++)
+      if (polygon->p[k] == w)
+        v[k] = p;
+
+    PolygonNormal(&after, v[0], v[1], v[2]);
+
+    if (V3D_Dot(&before, &after) <= 0.0f)
+      return false;
+  }
+
+  return true;
+}
+
+static void Collapse(SimplifierT *s, int u, int v, Vector3D *p) {
+  size_t t, i;
+  int k;
+
+  s->mesh->vertex[u] = *p;
+  QuadricAdd(&s->quadric[u], &s->quadric[u], &s->quadric[v]);
+
+  FOREACH_POLYGON(s, v, t, i) {
+    TriangleT *polygon = &s->mesh->polygon[i];
+
+    if (HasVertex(polygon, u)) {
+      s->dead[i] = true;
+      s->alive--;
+    } else {
+      for (k = 0; k < 3; k++)
+        if (polygon->p[k] == v)
+          polygon->p[k] = u;
+    }
+  }
+}
+
+static void CalculateCollapse(SimplifierT *s, CollapseT *c, int u, int v) {
+  Vector3D *pu = &s->mesh->vertex[u];
+  Vector3D *pv = &s->mesh->vertex[v];
+  Vector3D pm;
+  QuadricT q;
+  float eu, ev, em;
+
+  QuadricAdd(&q, &s->quadric[u], &s->quadric[v]);
+
+  V3D_Add(&pm, pu, pv);
+  V3D_Scale(&pm, &pm, 0.5f);
+
+  eu = QuadricError(&q, pu);
+  ev = QuadricError(&q, pv);
+  em = QuadricError(&q, &pm);
+
+  c->u = u;
+  c->v = v;
+
+  if (em <= eu && em <= ev) {
+    c->cost = em;
+    c->p = pm;
+  } else if (eu <= ev) {
+    c->cost = eu;
+    c->p = *pu;
+  } else {
+    c->cost = ev;
+    c->p = *pv;
+  }
+}
+
+/*
+ * Each pass calculates the cost of collapsing every interior edge and then
+ * collapses the cheapest ones.  Vertices involved in a collapse are locked
+ * for the rest of the pass, because their costs are no longer valid.  A pass
+ * removes at most half of polygons above the target, so that costs are
+ * refreshed often enough.
+ */
+static bool SimplifyPass(SimplifierT *s, size_t target, CollapseT *collapse) {
+  size_t budget = max((s->alive - target + 1) / 2, 2);
+  size_t limit = (s->alive > target + budget) ? (s->alive - budget) : target;
+  size_t i, n = 0;
+  bool progress = false;
+
+  UpdateTopology(s);
+  LockBoundary(s);
+
+  for (i = 0; i < s->mesh->edgeNum; i++) {
+    EdgeT *edge = &s->mesh->edge[i];
+    int u = edge->p[0];
+    int v = edge->p[1];
+
+    if (!s->locked[u] && !s->locked[v])
+      CalculateCollapse(s, &collapse[n++], u, v);
+  }
+
+  if (n == 0)
+    return false;
+
+  TableSort(collapse, CollapseCmp, 0, n - 1);
+
+  for (i = 0; i < n && s->alive > limit; i++) {
+    CollapseT *c = &collapse[i];
+
+    if (s->locked[c->u] || s->locked[c->v])
+      continue;
+
+    if (!CheckLink(s, c->u, c->v))
+      continue;
+
+    if (!CheckFlip(s, c->u, c->v, &c->p) || !CheckFlip(s, c->v, c->u, &c->p))
+      continue;
+
+    Collapse(s, c->u, c->v, &c->p);
+
+    s->locked[c->u] = s->locked[c->v] = true;
+    progress = true;
+  }
+
+  return progress;
+}
+
+static MeshT *NewMeshFromSimplifier(SimplifierT *s, MeshT *orig) {
+  MeshT *work = s->mesh;
+  int32_t *remap = NewTable(int32_t, work->vertexNum);
+  size_t vertexNum = 0;
+  size_t i, j, k;
+  MeshT *mesh;
+
+  for (i = 0; i < work->vertexNum; i++)
+    remap[i] = -1;
+
+  for (i = 0; i < work->polygonNum; i++)
+    if (!s->dead[i])
+      for (k = 0; k < 3; k++)
+        remap[work->polygon[i].p[k]] = 0;
+
+  for (i = 0; i < work->vertexNum; i++)
+    if (remap[i] == 0)
+      remap[i] = vertexNum++;
+
+  mesh = NewMesh(vertexNum, s->alive, orig->surfaceNum);
+
+  if (orig->texCoord)
+    mesh->texCoord = NewTable(TexCoordT, vertexNum);
+
+  for (i = 0; i < work->vertexNum; i++) {
+    if (remap[i] >= 0) {
+      mesh->vertex[remap[i]] = work->vertex[i];
+
+      if (orig->texCoord)
+        mesh->texCoord[remap[i]] = orig->texCoord[i];
+    }
+  }
+
+  for (i = 0, j = 0; i < work->polygonNum; i++) {
+    if (!s->dead[i]) {
+      mesh->polygon[j].surface = work->polygon[i].surface;
+
+      for (k = 0; k < 3; k++)
+        mesh->polygon[j].p[k] = remap[work->polygon[i].p[k]];
+
+      j++;
+    }
+  }
+
+  for (i = 0; i < orig->surfaceNum; i++) {
+    mesh->surface[i].name = StrDup(orig->surface[i].name);
+    mesh->surface[i].sideness = orig->surface[i].sideness;
+    mesh->surface[i].color = orig->surface[i].color;
+  }
+
+  MemUnref(remap);
+
+  MeshCalculateEdges(mesh);
+  CalculateVertexToPolygonMap(mesh);
+
+  if (orig->surfaceNormal)
+    CalculateSurfaceNormals(mesh);
+  if (orig->vertexNormal)
+    CalculateVertexNormals(mesh);
+
+  mesh->radius = orig->radius;
+
+  return mesh;
+}
+
+MeshT *NewSimplifiedMesh(MeshT *orig, size_t target) {
+  SimplifierT s;
+  CollapseT *collapse;
+  MeshT *mesh;
+  size_t i, k;
+
+  ASSERT(orig->vertex, "Cannot simplify quantized mesh %p.", orig);
+  ASSERT(!orig->morphNum, "Cannot simplify mesh %p with morph targets.", orig);
+
+  s.mesh = NewMesh(orig->vertexNum, orig->polygonNum, 0);
+  s.alive = orig->polygonNum;
+  s.quadric = NewTable(QuadricT, orig->vertexNum);
+  s.dead = NewTable(bool, orig->polygonNum);
+  s.valence = NewTable(uint16_t, orig->polygonNum * 3);
+  s.locked = NewTable(bool, orig->vertexNum);
+  s.mark = NewTable(uint32_t, orig->vertexNum);
+  s.markEpoch = 0;
+
+  MemCopy(s.mesh->vertex, orig->vertex,
+          sizeof(Vector3D) * orig->vertexNum);
+  MemCopy(s.mesh->polygon, orig->polygon,
+          sizeof(TriangleT) * orig->polygonNum);
+
+  collapse = NewTable(CollapseT, orig->polygonNum * 3);
+
+  /* Each vertex accumulates planes of adjacent polygons weighted by area. */
+  for (i = 0; i < orig->polygonNum; i++) {
+    TriangleT *polygon = &orig->polygon[i];
+    Vector3D *vertex = orig->vertex;
+    Vector3D *p0 = &vertex[polygon->p[0]];
+    Vector3D n;
+    float area;
+
+    PolygonNormal(&n, p0, &vertex[polygon->p[1]], &vertex[polygon->p[2]]);
+
+    area = V3D_Length(&n);
+
+    if (area > 0.0f) {
+      V3D_Scale(&n, &n, 1.0f / area);
+
+      for (k = 0; k < 3; k++)
+        QuadricAddPlane(&s.quadric[polygon->p[k]], &n, -V3D_Dot(&n, p0),
+                        area * 0.5f);
+    }
+  }
+
+  while (s.alive > target && SimplifyPass(&s, target, collapse));
+
+  mesh = NewMeshFromSimplifier(&s, orig);
+
+  LOG("Simplified mesh %p: %d -> %d polygons, %d -> %d vertices.",
+      orig, (int)orig->polygonNum, (int)mesh->polygonNum,
+      (int)orig->vertexNum, (int)mesh->vertexNum);
+
+  MemUnref(collapse);
+  MemUnref(s.mark);
+  MemUnref(s.locked);
+  MemUnref(s.valence);
+  MemUnref(s.dead);
+  MemUnref(s.quadric);
+  MemUnref(s.mesh);
+
+  return mesh;
+}
+
+void MeshGenerateLOD(MeshT *mesh, size_t levels) {
+  MeshT *prev = mesh;
+  size_t i;
+
+  ASSERT(!mesh->lod, "Mesh %p already has levels of detail.", mesh);
+
+  mesh->radius = 0.0f;
+
+  for (i = 0; i < mesh->vertexNum; i++) {
+    float r = V3D_Length(&mesh->vertex[i]);
+
+    if (r > mesh->radius)
+      mesh->radius = r;
+  }
+
+  for (i = 0; i < levels; i++) {
+    MeshT *lod = NewSimplifiedMesh(prev, prev->polygonNum / 2);
+
+    if (lod->polygonNum >= prev->polygonNum) {
+      MemUnref(lod);
+      break;
+    }
+
+    prev->lod = lod;
+    prev = lod;
+  }
+}
@@ -0,0 +1,18 @@
+#ifndef __ENGINE_SIMPLIFY_H__
+#define __ENGINE_SIMPLIFY_H__
+
+#include "engine/mesh.h"
+
+/*
+ * Returns a new mesh with (approximately) given number of polygons.  Edges
+ * are collapsed in order of quadric error metric.  Boundary edges are kept.
+ */
+MeshT *NewSimplifiedMesh(MeshT *mesh, size_t polygons);
+
+/*
+ * Builds a chain of coarser meshes, each with half of polygons of previous
+ * one, hanging from mesh->lod.  Has to be called before QuantizeMesh.
+ */
+void MeshGenerateLOD(MeshT *mesh, size_t levels);
+
+#endif
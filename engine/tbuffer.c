@@ -0,0 +1,198 @@
+#include <string.h>
+
+#include "std/debug.h"
+#include "std/math.h"
+#include "std/memory.h"
+#include "engine/tbuffer.h"
+
+static void DeleteTileBuffer(TileBufferT *self) {
+  MemUnref(self->triangle);
+  MemUnref(self->first);
+  MemUnref(self->index);
+}
+
+TYPEDECL(TileBufferT, (FreeFuncT)DeleteTileBuffer);
+
+TileBufferT *NewTileBuffer(size_t width, size_t height, size_t maxTriangles) {
+  TileBufferT *self = NewInstance(TileBufferT);
+
+  self->width = width;
+  self->height = height;
+  self->cols = (width + TILE_SIZE - 1) / TILE_SIZE;
+  self->rows = (height + TILE_SIZE - 1) / TILE_SIZE;
+  self->triangle = NewTable(TileTriangleT, maxTriangles);
+  self->first = NewTable(uint32_t, self->cols * self->rows + 1);
+  self->index = NewTable(uint16_t, maxTriangles);
+
+  return self;
+}
+
+void TileBufferReset(TileBufferT *self) {
+  self->triangleNum = 0;
+  self->trianglesIn = 0;
+  self->trianglesSkipped = 0;
+}
+
+void TileBufferAddTriangle(TileBufferT *self,
+                           EdgeScanT *e1, EdgeScanT *e2, EdgeScanT *e3,
+                           uint8_t color)
+{
+  TileTriangleT *triangle;
+  int xs, xe, ys, ye;
+
+  ys = min(e1->ys, min(e2->ys, e3->ys));
+  ye = max(e1->ye, max(e2->ye, e3->ye));
+
+  /*
+   * Spans are rounded from interpolated edges, so they may stick out of the
+   * box spanned by the vertices by a pixel.
+   */
+  xs = min(min(e1->xs, e1->xe), min(min(e2->xs, e2->xe), min(e3->xs, e3->xe)));
+  xe = max(max(e1->xs, e1->xe), max(max(e2->xs, e2->xe), max(e3->xs, e3->xe)));
+  xs -= 1;
+  xe += 1;
+
+  if (ys >= ye || ye <= 0 || ys >= (int)self->height ||
+      xe < 0 || xs >= (int)self->width)
+    return;
+
+  if (self->triangleNum == TableSize(self->triangle)) {
+    size_t size = max(self->triangleNum * 2, 16);
+
+    ASSERT(size <= 65536, "Too many triangles in tile buffer.");
+
+    self->triangle = TableResize(self->triangle, size);
+  }
+
+  triangle = &self->triangle[self->triangleNum++];
+  triangle->e[0] = *e1;
+  triangle->e[1] = *e2;
+  triangle->e[2] = *e3;
+  triangle->txs = max(xs, 0) / TILE_SIZE;
+  triangle->txe = min(xe, (int)self->width - 1) / TILE_SIZE;
+  triangle->tys = max(ys, 0) / TILE_SIZE;
+  triangle->tye = min(ye - 1, (int)self->height - 1) / TILE_SIZE;
+  triangle->color = color;
+}
+
+/*
+ * Counting sort of triangles by tile.  Order of triangles within a tile is
+ * preserved.
+ */
+static void TileBufferBin(TileBufferT *self) {
+  uint32_t *first = self->first;
+  size_t tiles = self->cols * self->rows;
+  size_t i, total = 0;
+  int x, y;
+
+  memset(first, 0, sizeof(uint32_t) * (tiles + 1));
+
+  for (i = 0; i < self->triangleNum; i++) {
+    TileTriangleT *triangle = &self->triangle[i];
+
+    for (y = triangle->tys; y <= triangle->tye; y++)
+      for (x = triangle->txs; x <= triangle->txe; x++)
+        first[y * self->cols + x + 1]++;
+  }
+
+  for (i = 1; i <= tiles; i++) {
+    total += first[i];
+    first[i] = total;
+  }
+
+  if (TableSize(self->index) < total) {
+    MemUnref(self->index);
+    self->index = NewTable(uint16_t, total);
+  }
+
+  /* Entries of first[] move by one tile while the index is filled. */
+  for (i = 0; i < self->triangleNum; i++) {
+    TileTriangleT *triangle = &self->triangle[i];
+
+    for (y = triangle->tys; y <= triangle->tye; y++)
+      for (x = triangle->txs; x <= triangle->txe; x++)
+        self->index[first[y * self->cols + x]++] = i;
+  }
+}
+
+static void TileRender(TileBufferT *self, TileT *tile, int begin, int end) {
+  const int area = tile->width * tile->height;
+  int i;
+
+  tile->covered = 0;
+
+  memset(tile->mask, 0, sizeof(tile->mask));
+
+  for (i = end - 1; i >= begin; i--) {
+    TileTriangleT *triangle = &self->triangle[self->index[i]];
+
+    if (tile->covered == area) {
+      self->trianglesSkipped += i - begin + 1;
+      break;
+    }
+
+    tile->color = triangle->color;
+
+    RasterizeTriangleTile(tile, &triangle->e[0], &triangle->e[1],
+                          &triangle->e[2]);
+
+    self->trianglesIn++;
+  }
+}
+
+static void TileCopy(TileT *tile, PixBufT *canvas) {
+  uint8_t *dst = canvas->data + tile->y * canvas->stride + tile->x;
+  uint8_t *src = tile->pixels;
+  uint8_t *mask = tile->mask;
+  int x, y;
+
+  if (tile->covered)
+    PixBufMarkDirty(canvas, tile->x, tile->y, tile->width, tile->height);
+
+  if (tile->covered == tile->width * tile->height) {
+    for (y = 0; y < tile->height; y++) {
+      memcpy(dst, src, tile->width);
+      dst += canvas->stride;
+      src += TILE_SIZE;
+    }
+  } else if (tile->covered) {
+    for (y = 0; y < tile->height; y++) {
+      for (x = 0; x < tile->width; x++)
+        if (mask[x])
+          dst[x] = src[x];
+
+      dst += canvas->stride;
+      src += TILE_SIZE;
+      mask += TILE_SIZE;
+    }
+  }
+}
+
+void TileBufferRender(TileBufferT *self, PixBufT *canvas) {
+  TileT *tile = &self->tile;
+  size_t tx, ty;
+
+  ASSERT(canvas->width == self->width && canvas->height == self->height,
+         "Canvas size does not match tile buffer size.");
+
+  TileBufferBin(self);
+
+  for (ty = 0; ty < self->rows; ty++) {
+    for (tx = 0; tx < self->cols; tx++) {
+      size_t i = ty * self->cols + tx;
+      int begin = (i > 0) ? self->first[i - 1] : 0;
+      int end = self->first[i];
+
+      if (begin == end)
+        continue;
+
+      tile->x = tx * TILE_SIZE;
+      tile->y = ty * TILE_SIZE;
+      tile->width = min(TILE_SIZE, (int)self->width - tile->x);
+      tile->height = min(TILE_SIZE, (int)self->height - tile->y);
+
+      TileRender(self, tile, begin, end);
+      TileCopy(tile, canvas);
+    }
+  }
+}
@@ -0,0 +1,49 @@
+#ifndef __ENGINE_TBUFFER_H__
+#define __ENGINE_TBUFFER_H__
+
+#include "gfx/pixbuf.h"
+#include "engine/triangle.h"
+
+typedef struct TileTriangle {
+  EdgeScanT e[3];
+  /* range of tiles covered by bounding box (inclusive) */
+  int16_t txs, tys, txe, tye;
+  uint8_t color;
+} TileTriangleT;
+
+/*
+ * Triangles are collected in back to front order and binned into tiles of
+ * TILE_SIZE x TILE_SIZE pixels.  Each tile is then rasterized front to back
+ * in a buffer small enough to stay in data cache, and the rest of triangles
+ * is skipped as soon as the tile is fully covered.  Tiles don't depend on
+ * each other.
+ */
+typedef struct TileBuffer {
+  size_t width, height;
+  size_t cols, rows;
+
+  TileTriangleT *triangle;
+  size_t triangleNum;
+
+  /* triangles binned into tile i are index[first[i]] .. index[first[i+1]-1] */
+  uint32_t *first;
+  uint16_t *index;
+
+  TileT tile;
+
+  /* statistics: triangles drawn into tiles vs. skipped in covered tiles */
+  uint32_t trianglesIn;
+  uint32_t trianglesSkipped;
+} TileBufferT;
+
+TileBufferT *NewTileBuffer(size_t width, size_t height, size_t maxTriangles);
+
+/* Edge scans are copied, so they can live on stack. */
+void TileBufferAddTriangle(TileBufferT *self,
+                           EdgeScanT *e1, EdgeScanT *e2, EdgeScanT *e3,
+                           uint8_t color);
+
+void TileBufferRender(TileBufferT *self, PixBufT *canvas);
+void TileBufferReset(TileBufferT *self);
+
+#endif
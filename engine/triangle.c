@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "engine/triangle.h"
 #include "std/debug.h"
 #include "std/math.h"
@@ -30,7 +32,7 @@ __attribute__((regparm(4))) static void
 RasterizeTriangleSegment(PixBufT *canvas, EdgeScanT *left, EdgeScanT *right,
                          int ys, int ye)
 {
-  uint8_t *pixels = canvas->data + ys * canvas->width;
+  uint8_t *pixels = canvas->data + ys * canvas->stride;
   register const uint8_t color = canvas->fgColor;
   register FP16 lx = left->x;
   register FP16 rx = right->x;
@@ -47,7 +49,7 @@ RasterizeTriangleSegment(PixBufT *canvas, EdgeScanT *left, EdgeScanT *right,
       *span++ = color;
     } while (--n > 0);
 
-    pixels += canvas->width;
+    pixels += canvas->stride;
 
     lx = FP16_add(lx, ldx);
     rx = FP16_add(rx, rdx);
@@ -59,8 +61,130 @@ RasterizeTriangleSegment(PixBufT *canvas, EdgeScanT *left, EdgeScanT *right,
   right->x = rx;
 }
 
-void RasterizeTriangle(PixBufT *canvas,
-                       EdgeScanT *e1, EdgeScanT *e2, EdgeScanT *e3)
+/*
+ * Used for triangles that cross the edge of the screen, but lie within the
+ * guard band.  Instead of clipping the triangle geometrically rows outside of
+ * canvas are skipped and spans are clamped.
+ */
+__attribute__((regparm(4))) static void
+RasterizeTriangleSegmentClipped(PixBufT *canvas,
+                                EdgeScanT *left, EdgeScanT *right,
+                                int ys, int ye)
+{
+  const uint8_t color = canvas->fgColor;
+  const int16_t width = canvas->width;
+  FP16 lx = left->x;
+  FP16 rx = right->x;
+  FP16 ldx = left->dx;
+  FP16 rdx = right->dx;
+  uint8_t *pixels;
+
+  /* Long edge is reused by the next segment, so it must end up at ye. */
+  if (ys < 0) {
+    int skip = min(ye, 0) - ys;
+
+    lx.v += ldx.v * skip;
+    rx.v += rdx.v * skip;
+    ys += skip;
+  }
+
+  pixels = canvas->data + ys * canvas->stride;
+
+  for (; ys < min(ye, canvas->height); ys++) {
+    int16_t xs = FP16_rintf(lx);
+    int16_t xe = FP16_rintf(rx);
+
+    /* Unclipped routine always draws at least one pixel. */
+    if (xe <= xs)
+      xe = xs + 1;
+    if (xs < 0)
+      xs = 0;
+    if (xe > width)
+      xe = width;
+
+    if (xs < xe)
+      memset(pixels + xs, color, xe - xs);
+
+    pixels += canvas->stride;
+
+    lx = FP16_add(lx, ldx);
+    rx = FP16_add(rx, rdx);
+  }
+
+  left->x = lx;
+  right->x = rx;
+}
+
+/*
+ * Same as above, but rows and spans are clamped to the tile and only pixels
+ * that were not covered by any triangle before are written.
+ */
+__attribute__((regparm(4))) static void
+RasterizeTriangleSegmentTile(TileT *tile, EdgeScanT *left, EdgeScanT *right,
+                             int ys, int ye)
+{
+  const uint8_t color = tile->color;
+  const int16_t x0 = tile->x;
+  const int16_t x1 = tile->x + tile->width;
+  const int16_t y0 = tile->y;
+  const int16_t y1 = tile->y + tile->height;
+  FP16 lx = left->x;
+  FP16 rx = right->x;
+  FP16 ldx = left->dx;
+  FP16 rdx = right->dx;
+  int covered = tile->covered;
+
+  if (ys < y0) {
+    int skip = min(ye, y0) - ys;
+
+    lx.v += ldx.v * skip;
+    rx.v += rdx.v * skip;
+    ys += skip;
+  }
+
+  for (; ys < min(ye, y1); ys++) {
+    int16_t xs = FP16_rintf(lx);
+    int16_t xe = FP16_rintf(rx);
+
+    if (xe <= xs)
+      xe = xs + 1;
+    if (xs < x0)
+      xs = x0;
+    if (xe > x1)
+      xe = x1;
+
+    if (xs < xe) {
+      int offset = (ys - y0) * TILE_SIZE - x0;
+      uint8_t *pixels = tile->pixels + offset;
+      uint8_t *mask = tile->mask + offset;
+
+      for (; xs < xe; xs++) {
+        if (!mask[xs]) {
+          mask[xs] = 1;
+          pixels[xs] = color;
+          covered++;
+        }
+      }
+    }
+
+    lx = FP16_add(lx, ldx);
+    rx = FP16_add(rx, rdx);
+  }
+
+  tile->covered = covered;
+
+  left->x = lx;
+  right->x = rx;
+}
+
+/* Target is either a canvas or a tile, depending on segment routine. */
+typedef __attribute__((regparm(4))) void
+  (*SegmentFuncT)(void *target, EdgeScanT *left, EdgeScanT *right,
+                  int ys, int ye);
+
+static inline void
+RasterizeTriangleWith(void *target, SegmentFuncT segmentFunc,
+                      EdgeScanT *e1, EdgeScanT *e2, EdgeScanT *e3)
 {
   if (e1->ys > e2->ys)
     swapr(e1, e2);
@@ -103,7 +227,7 @@ void RasterizeTriangle(PixBufT *canvas,
         LOG("top: xs = %d, xe = %d", FP16_i(left->x), FP16_i(right->x));
       }
 #endif
-      RasterizeTriangleSegment(canvas, left, right, l12.ys, l12.ye);
+      segmentFunc(target, left, right, l12.ys, l12.ye);
     }
 
     if (longOnRight) {
@@ -116,7 +240,43 @@ void RasterizeTriangle(PixBufT *canvas,
 #if 0
       ASSERT(FP16_i(left->x) <= FP16_i(right->x) + 1, "bottom: xs = %d, xe = %d", FP16_i(left->x), FP16_i(right->x));
 #endif
-      RasterizeTriangleSegment(canvas, left, right, l23.ys, l23.ye);
+      segmentFunc(target, left, right, l23.ys, l23.ye);
     }
   }
 }
+
+/* Any two edges share all three vertices, so they give the bounding box. */
+static void MarkDirty(PixBufT *canvas, EdgeScanT *e1, EdgeScanT *e2) {
+  if (PixBufTracksDirty(canvas)) {
+    int xmin = min(min(e1->xs, e1->xe), min(e2->xs, e2->xe));
+    int xmax = max(max(e1->xs, e1->xe), max(e2->xs, e2->xe));
+    int ymin = min(min(e1->ys, e1->ye), min(e2->ys, e2->ye));
+    int ymax = max(max(e1->ys, e1->ye), max(e2->ys, e2->ye));
+
+    PixBufMarkDirtyRect(canvas, xmin - 1, ymin, xmax - xmin + 3,
+                        ymax - ymin + 1);
+  }
+}
+
+void RasterizeTriangle(PixBufT *canvas,
+                       EdgeScanT *e1, EdgeScanT *e2, EdgeScanT *e3)
+{
+  MarkDirty(canvas, e1, e2);
+  RasterizeTriangleWith(canvas, (SegmentFuncT)RasterizeTriangleSegment,
+                        e1, e2, e3);
+}
+
+void RasterizeTriangleClipped(PixBufT *canvas,
+                              EdgeScanT *e1, EdgeScanT *e2, EdgeScanT *e3)
+{
+  MarkDirty(canvas, e1, e2);
+  RasterizeTriangleWith(canvas, (SegmentFuncT)RasterizeTriangleSegmentClipped,
+                        e1, e2, e3);
+}
+
+void RasterizeTriangleTile(TileT *tile,
+                           EdgeScanT *e1, EdgeScanT *e2, EdgeScanT *e3)
+{
+  RasterizeTriangleWith(tile, (SegmentFuncT)RasterizeTriangleSegmentTile,
+                        e1, e2, e3);
+}
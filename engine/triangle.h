@@ -13,13 +13,39 @@ typedef struct EdgeScan {
   FP16 x;
   FP16 dx;
 
+  /* frame in which the edge was set up */
+  uint32_t epoch;
+
   bool done;
 } EdgeScanT;
 
+#define TILE_SIZE 32
+
+/*
+ * Square part of the canvas that is rasterized in a small buffer.  A pixel is
+ * written only by the first triangle that covers it, so triangles have to be
+ * drawn front to back.
+ */
+typedef struct Tile {
+  int16_t x, y;
+  int16_t width, height;
+  uint8_t color;
+  /* number of pixels written so far */
+  uint16_t covered;
+
+  uint8_t pixels[TILE_SIZE * TILE_SIZE];
+  uint8_t mask[TILE_SIZE * TILE_SIZE];
+} TileT;
+
 __attribute__((regparm(4))) void
 InitEdgeScan(EdgeScanT *e, float ys, float ye, float xs, float xe);
 
 void RasterizeTriangle(PixBufT *canvas,
                        EdgeScanT *e1, EdgeScanT *e2, EdgeScanT *e3);
+void RasterizeTriangleClipped(PixBufT *canvas,
+                              EdgeScanT *e1, EdgeScanT *e2, EdgeScanT *e3);
+/* Covers exactly the same pixels as RasterizeTriangleClipped. */
+void RasterizeTriangleTile(TileT *tile,
+                           EdgeScanT *e1, EdgeScanT *e2, EdgeScanT *e3);
 
 #endif
@@ -3,7 +3,7 @@
 #include "std/fastmath.h"
 
 static inline void AddPixel(PixBufT *pixbuf, int x, int y, uint8_t c) {
-  uint8_t *p = &pixbuf->data[x + pixbuf->width * y];
+  uint8_t *p = &pixbuf->data[x + pixbuf->stride * y];
   uint16_t d = *p + c;
 
   if (d >= 256)
@@ -18,6 +18,10 @@ void DrawLineAA(PixBufT *canvas, float x0, float y0, float x1, float y1) {
   float gradient, intery;
   float xend, yend, xgap, yend_i, yend_f;
   int xpxl1, ypxl1, xpxl2, ypxl2, x;
+
+  /* With a margin for rounding and the second pixel of each pair. */
+  PixBufMarkDirty(canvas, (int)min(x0, x1) - 1, (int)min(y0, y1) - 1,
+                  (int)fabsf(x1 - x0) + 4, (int)fabsf(y1 - y0) + 4);
  
   if (steep) {
     swapf(x0, y0);
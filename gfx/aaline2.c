@@ -44,7 +44,7 @@ void DrawLineAA(PixBufT *canvas, int xs, int ys, int xe, int ye) {
 
   dy = ye - ys;
 
-  stride = canvas->width;
+  stride = canvas->stride;
   pixels = canvas->data + ys * stride + xs;
 
   /* (xs, ys, xe, ye) unused from now on */
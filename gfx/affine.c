@@ -0,0 +1,146 @@
+#include "std/debug.h"
+#include "gfx/affine.h"
+
+/*
+ * Destination is traversed in square tiles.  With rotation close to 90
+ * degrees consecutive pixels of a line map into distinct texture lines, so
+ * plain scanline order would touch a different cache line for each pixel.
+ */
+#define TILE 8
+
+typedef struct AffineSpan {
+  uint8_t *data;
+  int stride;
+  int width, height;
+  uint8_t *cmap;
+  /* 16.16 steps per destination pixel in x and y direction */
+  int32_t dudx, dvdx;
+  int32_t dudy, dvdy;
+} AffineSpanT;
+
+static inline int Clamp(int x, int limit) {
+  if (x < 0)
+    return 0;
+  if (x >= limit)
+    return limit - 1;
+  return x;
+}
+
+/*
+ * Edge and mode are constants at each call site, so each variant gets its
+ * own inner loop without any branches except for clamping.
+ */
+static inline void AffineTile(uint8_t *dst, int dstStride, int w, int h,
+                              int32_t u, int32_t v, AffineSpanT *span,
+                              const AffineEdgeT edge, const BlitModeT mode)
+{
+  const int umask = span->width - 1;
+  const int vmask = span->height - 1;
+  const int stride = span->stride;
+  uint8_t *data = span->data;
+  uint8_t *cmap = span->cmap;
+  int x, y;
+
+  for (y = 0; y < h; y++) {
+    int32_t uu = u, vv = v;
+
+    for (x = 0; x < w; x++) {
+      int tu, tv;
+      uint8_t c;
+
+      if (edge == AFFINE_WRAP) {
+        tu = (uu >> 16) & umask;
+        tv = (vv >> 16) & vmask;
+      } else {
+        tu = Clamp(uu >> 16, span->width);
+        tv = Clamp(vv >> 16, span->height);
+      }
+
+      c = data[tv * stride + tu];
+
+      if (mode == BLIT_COLOR_MAP)
+        dst[x] = cmap[(dst[x] << 8) | c];
+      else if (mode == BLIT_NORMAL || c)
+        dst[x] = c;
+
+      uu += span->dudx;
+      vv += span->dvdx;
+    }
+
+    dst += dstStride;
+    u += span->dudy;
+    v += span->dvdy;
+  }
+}
+
+#define AFFINE_LOOP(EDGE, MODE)                                         \
+  for (y = 0; y < dstBuf->height; y += TILE) {                          \
+    int32_t u = u0, v = v0;                                             \
+    uint8_t *dst = dstBuf->data + y * dstBuf->stride;                   \
+    int h = min(TILE, dstBuf->height - y);                              \
+                                                                        \
+    for (x = 0; x < dstBuf->width; x += TILE) {                         \
+      AffineTile(dst + x, dstBuf->stride, min(TILE, dstBuf->width - x), \
+                 h, u, v, &span, EDGE, MODE);                           \
+      u += TILE * span.dudx;                                            \
+      v += TILE * span.dvdx;                                            \
+    }                                                                   \
+                                                                        \
+    u0 += TILE * span.dudy;                                             \
+    v0 += TILE * span.dvdy;                                             \
+  }
+
+static inline bool IsPowerOfTwo(int x) {
+  return (x & (x - 1)) == 0;
+}
+
+void PixBufBlitAffine(PixBufT *dstBuf, PixBufT *texture, Matrix2D *m,
+                      AffineEdgeT edge)
+{
+  AffineSpanT span;
+  int32_t u0, v0;
+  int x, y;
+
+  ASSERT(texture->mode == BLIT_NORMAL || texture->mode == BLIT_TRANSPARENT ||
+         texture->mode == BLIT_COLOR_MAP,
+         "Blit mode (%d) not supported.", texture->mode);
+  ASSERT(edge == AFFINE_CLAMP ||
+         (IsPowerOfTwo(texture->width) && IsPowerOfTwo(texture->height)),
+         "Texture size (%d, %d) is not a power of two.",
+         texture->width, texture->height);
+
+  span.data = texture->data;
+  span.stride = texture->stride;
+  span.width = texture->width;
+  span.height = texture->height;
+  span.cmap = texture->blit.cmap;
+
+  /* Same convention as in Transform2D. */
+  span.dudx = (int32_t)((*m)[0][0] * 65536.0f);
+  span.dvdx = (int32_t)((*m)[0][1] * 65536.0f);
+  span.dudy = (int32_t)((*m)[1][0] * 65536.0f);
+  span.dvdy = (int32_t)((*m)[1][1] * 65536.0f);
+
+  u0 = (int32_t)((*m)[2][0] * 65536.0f);
+  v0 = (int32_t)((*m)[2][1] * 65536.0f);
+
+  PixBufMarkAllDirty(dstBuf);
+
+  if (edge == AFFINE_WRAP) {
+    if (texture->mode == BLIT_NORMAL) {
+      AFFINE_LOOP(AFFINE_WRAP, BLIT_NORMAL);
+    } else if (texture->mode == BLIT_TRANSPARENT) {
+      AFFINE_LOOP(AFFINE_WRAP, BLIT_TRANSPARENT);
+    } else {
+      AFFINE_LOOP(AFFINE_WRAP, BLIT_COLOR_MAP);
+    }
+  } else {
+    if (texture->mode == BLIT_NORMAL) {
+      AFFINE_LOOP(AFFINE_CLAMP, BLIT_NORMAL);
+    } else if (texture->mode == BLIT_TRANSPARENT) {
+      AFFINE_LOOP(AFFINE_CLAMP, BLIT_TRANSPARENT);
+    } else {
+      AFFINE_LOOP(AFFINE_CLAMP, BLIT_COLOR_MAP);
+    }
+  }
+}
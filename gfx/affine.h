@@ -0,0 +1,19 @@
+#ifndef __GFX_AFFINE_H__
+#define __GFX_AFFINE_H__
+
+#include "gfx/matrix2d.h"
+#include "gfx/pixbuf.h"
+
+typedef enum { AFFINE_WRAP, AFFINE_CLAMP } AffineEdgeT;
+
+/*
+ * Fills whole destination with texture, where matrix maps destination pixel
+ * coordinates into texture coordinates (i.e. it's the inverse of the
+ * transformation seen on screen).  Wrapping requires texture dimensions to
+ * be powers of two.  Supports BLIT_NORMAL, BLIT_TRANSPARENT and
+ * BLIT_COLOR_MAP modes of texture.
+ */
+void PixBufBlitAffine(PixBufT *dstBuf, PixBufT *texture, Matrix2D *m,
+                      AffineEdgeT edge);
+
+#endif
@@ -1,195 +1,8 @@
 #include "gfx/blit.h"
+#include "gfx/blitops.h"
 #include "gfx/raw.h"
 #include "std/debug.h"
 
-#if 0
-__attribute__((regparm(4))) static void
-PixBufBlitNormal(uint8_t *dst, uint8_t *src,
-                 const int width, const int height,
-                 const int sstride, const int dstride)
-{
-  int y = height;
-
-  do {
-    int x = width;
-
-    do {
-      *dst++ = *src++;
-    } while (--x);
-
-    src += sstride;
-    dst += dstride;
-  } while (--y);
-}
-#endif
-
-__attribute__((regparm(4))) static void
-PixBufBlitAdditive(uint8_t *dst, uint8_t *src,
-                   const int width, const int height,
-                   const int sstride, const int dstride)
-{
-  int y = height;
-
-  do {
-    int x = width;
-
-    do {
-      uint8_t a = *dst;
-      uint8_t b = *src++;
-
-      *dst++ = a + b;
-    } while (--x);
-
-    src += sstride;
-    dst += dstride;
-  } while (--y);
-}
-
-__attribute__((regparm(4))) static void
-PixBufBlitAdditiveClip(uint8_t *dst, uint8_t *src,
-                       const int width, const int height,
-                       const int sstride, const int dstride)
-{
-  int y = height;
-
-  do {
-    int x = width;
-
-    do {
-      uint8_t a = *dst;
-      uint8_t b = *src++;
-
-      if (a < (uint8_t)~b)
-        *dst++ = a + b;
-      else
-        *dst++ = 255;
-    } while (--x);
-
-    src += sstride;
-    dst += dstride;
-  } while (--y);
-}
-
-__attribute__((regparm(4))) static void
-PixBufBlitSubstractive(uint8_t *dst, uint8_t *src,
-                       const int width, const int height,
-                       const int sstride, const int dstride)
-{
-  int y = height;
-
-  do {
-    int x = width;
-
-    do {
-      uint8_t a = *dst;
-      uint8_t b = *src++;
-
-      *dst++ = a - b;
-    } while (--x);
-
-    src += sstride;
-    dst += dstride;
-  } while (--y);
-}
-
-__attribute__((regparm(4))) static void
-PixBufBlitSubstractiveClip(uint8_t *dst, uint8_t *src,
-                           const int width, const int height,
-                           const int sstride, const int dstride)
-{
-  int y = height;
-
-  do {
-    int x = width;
-
-    do {
-      uint8_t a = *dst;
-      uint8_t b = *src++;
-
-      if (a > b)
-        *dst++ = a - b;
-      else
-        *dst++ = 0;
-    } while (--x);
-
-    src += sstride;
-    dst += dstride;
-  } while (--y);
-}
-
-#if 0
-__attribute__((regparm(4))) static void
-PixBufBlitTransparent(uint8_t *dst, uint8_t *src,
-                      const int width, const int height,
-                      const int sstride, const int dstride)
-{
-  int y = height;
-
-  do {
-    int x = width;
-
-    do {
-      uint8_t c = *src++;
-
-      if (c != 0)
-        *dst++ = c;
-      else
-        dst++;
-    } while (--x);
-
-    src += sstride;
-    dst += dstride;
-  } while (--y);
-}
-
-__attribute__((regparm(4))) static void 
-PixBufBlitColorMap(uint8_t *dst, uint8_t *src,
-                   const int width, const int height,
-                   const int sstride, const int dstride,
-                   uint8_t *cmap, const int shift)
-{
-  int y = height;
-
-  do {
-    int x = width;
-
-    do {
-      int shade = shift + (*src++);
-
-      if (shade < 0)
-        shade = 0;
-      if (shade > 255)
-        shade = 255;
-
-      *dst++ = cmap[(*dst << 8) | shade];
-    } while (--x);
-
-    src += sstride;
-    dst += dstride;
-  } while (--y);
-}
-
-__attribute__((regparm(4))) static void 
-PixBufBlitColorFunc(uint8_t *dst, uint8_t *src,
-                    const int width, const int height,
-                    const int sstride, const int dstride,
-                    uint8_t *cfunc)
-{
-  int y = height;
-
-  do {
-    int x = width;
-
-    do {
-      *dst++ = cfunc[*src++];
-    } while (--x);
-
-    src += sstride;
-    dst += dstride;
-  } while (--y);
-}
-#endif
-
 static inline void ScaleLine(uint8_t *dst, uint8_t *src, int w, const int du2, bool check) {
   const int sx = sign(w);
   const int dx = abs(w);
@@ -225,7 +38,7 @@ void PixBufBlitScaled(PixBufT *dstBuf, size_t x, size_t y, int w, int h,
     const int du2 = 2 * srcBuf->width;
     const int dv2 = 2 * srcBuf->height;
 
-    const int sy = sign(h) * dstBuf->width;
+    const int sy = sign(h) * dstBuf->stride;
     const int dy = abs(h);
 
     uint8_t *src = srcBuf->data;
@@ -233,7 +46,9 @@ void PixBufBlitScaled(PixBufT *dstBuf, size_t x, size_t y, int w, int h,
 
     int error = dv2 - dy;
 
-    dst += ((h > 0) ? (y) : (y - h - 1)) * dstBuf->width;
+    PixBufMarkDirty(dstBuf, x, y, abs(w), dy);
+
+    dst += ((h > 0) ? (y) : (y - h - 1)) * dstBuf->stride;
     dst += (w > 0) ? (x) : (x - w - 1);
 
     h = dy;
@@ -242,7 +57,7 @@ void PixBufBlitScaled(PixBufT *dstBuf, size_t x, size_t y, int w, int h,
       ScaleLine(dst, src, w, du2, srcBuf->mode == BLIT_TRANSPARENT);
 
       while (error >= 0) {
-        src += srcBuf->width;
+        src += srcBuf->stride;
         error -= 2 * dy;
       }
 
@@ -281,19 +96,21 @@ void PixBufBlit(PixBufT *dbuf, int x, int y,
     h += y; sy -= y; y = 0;
   }
 
-  if (x + w > dbuf->width)
+  if (x + w > (int)dbuf->width)
     w = dbuf->width - x;
 
-  if (y + h > dbuf->height)
+  if (y + h > (int)dbuf->height)
     h = dbuf->height - y;
 
   /* blit */
   if (w > 0 && h > 0) {
-    size_t sstride = sbuf->width - w;
-    size_t dstride = dbuf->width - w;
+    size_t sstride = sbuf->stride - w;
+    size_t dstride = dbuf->stride - w;
+
+    uint8_t *src = &sbuf->data[sy * sbuf->stride + sx];
+    uint8_t *dst = &dbuf->data[y * dbuf->stride + x];
 
-    uint8_t *src = &sbuf->data[sy * sbuf->width + sx];
-    uint8_t *dst = &dbuf->data[y * dbuf->width + x];
+    PixBufMarkDirty(dbuf, x, y, w, h);
 
     switch (sbuf->mode) {
       case BLIT_NORMAL:
@@ -305,19 +122,19 @@ void PixBufBlit(PixBufT *dbuf, int x, int y,
         break;
 
       case BLIT_ADDITIVE:
-        PixBufBlitAdditive(dst, src, w, h, sstride, dstride);
+        BlitAdditive(dst, src, w, h, sstride, dstride);
         break;
 
       case BLIT_ADDITIVE_CLIP:
-        PixBufBlitAdditiveClip(dst, src, w, h, sstride, dstride);
+        BlitAdditiveClip(dst, src, w, h, sstride, dstride);
         break;
 
       case BLIT_SUBSTRACTIVE:
-        PixBufBlitSubstractive(dst, src, w, h, sstride, dstride);
+        BlitSubstractive(dst, src, w, h, sstride, dstride);
         break;
 
       case BLIT_SUBSTRACTIVE_CLIP:
-        PixBufBlitSubstractiveClip(dst, src, w, h, sstride, dstride);
+        BlitSubstractiveClip(dst, src, w, h, sstride, dstride);
         break;
 
       case BLIT_COLOR_MAP:
@@ -332,6 +149,9 @@ void PixBufBlit(PixBufT *dbuf, int x, int y,
 }
 
 void PixBufAddAndClamp(PixBufT *dstBuf, PixBufT *srcBuf, int value) {
+  ASSERT(PixBufIsContiguous(dstBuf) && PixBufIsContiguous(srcBuf),
+         "Views are not supported.");
+
   if (value < 0) {
     value = -value;
 
@@ -345,4 +165,6 @@ void PixBufAddAndClamp(PixBufT *dstBuf, PixBufT *srcBuf, int value) {
 
     RawAddAndClamp(dstBuf->data, srcBuf->data, srcBuf->width * srcBuf->height, value);
   }
+
+  PixBufMarkAllDirty(dstBuf);
 }
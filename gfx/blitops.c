@@ -0,0 +1,187 @@
+#include <string.h>
+
+#include "gfx/blitops.h"
+
+#define HI 0x80808080U
+#define LO 0x7f7f7f7fU
+
+/* Turns 0x80 in each byte into 0xff and leaves zero bytes intact. */
+static inline uint32_t ByteMask(uint32_t m) {
+  return (m << 1) - (m >> 7);
+}
+
+static inline uint32_t AddBytes(uint32_t a, uint32_t b) {
+  return ((a & LO) + (b & LO)) ^ ((a ^ b) & HI);
+}
+
+static inline uint32_t AddBytesClip(uint32_t a, uint32_t b) {
+  uint32_t s = AddBytes(a, b);
+  uint32_t carry = ((a & b) | ((a | b) & ~s)) & HI;
+
+  return s | ByteMask(carry);
+}
+
+static inline uint32_t SubBytes(uint32_t a, uint32_t b) {
+  return ((a | HI) - (b & LO)) ^ ((a ^ ~b) & HI);
+}
+
+static inline uint32_t SubBytesClip(uint32_t a, uint32_t b) {
+  uint32_t d = SubBytes(a, b);
+  uint32_t borrow = ((~a & b) | (~(a ^ b) & d)) & HI;
+
+  return d & ~ByteMask(borrow);
+}
+
+/*
+ * Rows are processed in three parts: pixels up to an aligned destination
+ * address, whole longwords and the remainder.  Source may be misaligned,
+ * which 68060 handles in hardware.
+ */
+#define BLIT_SWAR(PIXEL, WORD)                                  \
+  do {                                                          \
+    int x = width;                                              \
+                                                                \
+    while (x > 0 && ((size_t)dst & 3)) {                        \
+      uint8_t a = *dst;                                         \
+      uint8_t b = *src++;                                       \
+      *dst++ = PIXEL;                                           \
+      x--;                                                      \
+    }                                                           \
+                                                                \
+    for (; x >= 4; x -= 4, dst += 4, src += 4) {                \
+      uint32_t a = *(uint32_t *)dst;                            \
+      uint32_t b = *(uint32_t *)src;                            \
+      *(uint32_t *)dst = WORD;                                  \
+    }                                                           \
+                                                                \
+    while (x-- > 0) {                                           \
+      uint8_t a = *dst;                                         \
+      uint8_t b = *src++;                                       \
+      *dst++ = PIXEL;                                           \
+    }                                                           \
+                                                                \
+    src += sstride;                                             \
+    dst += dstride;                                             \
+  } while (--height)
+
+void BlitNormal(uint8_t *dst, uint8_t *src, int width, int height,
+                int sstride, int dstride)
+{
+  do {
+    memcpy(dst, src, width);
+
+    src += width + sstride;
+    dst += width + dstride;
+  } while (--height);
+}
+
+void BlitTransparent(uint8_t *dst, uint8_t *src, int width, int height,
+                     int sstride, int dstride)
+{
+  do {
+    int x = width;
+
+    while (x > 0 && ((size_t)dst & 3)) {
+      uint8_t c = *src++;
+
+      if (c)
+        *dst = c;
+      dst++;
+      x--;
+    }
+
+    for (; x >= 4; x -= 4, dst += 4, src += 4) {
+      uint32_t c = *(uint32_t *)src;
+
+      /* Copy whole longword if none of its bytes is zero. */
+      if (!((c - 0x01010101U) & ~c & HI)) {
+        *(uint32_t *)dst = c;
+      } else if (c) {
+        if (src[0]) dst[0] = src[0];
+        if (src[1]) dst[1] = src[1];
+        if (src[2]) dst[2] = src[2];
+        if (src[3]) dst[3] = src[3];
+      }
+    }
+
+    while (x-- > 0) {
+      uint8_t c = *src++;
+
+      if (c)
+        *dst = c;
+      dst++;
+    }
+
+    src += sstride;
+    dst += dstride;
+  } while (--height);
+}
+
+void BlitAdditive(uint8_t *dst, uint8_t *src, int width, int height,
+                  int sstride, int dstride)
+{
+  BLIT_SWAR(a + b, AddBytes(a, b));
+}
+
+void BlitAdditiveClip(uint8_t *dst, uint8_t *src, int width, int height,
+                      int sstride, int dstride)
+{
+  BLIT_SWAR((a < (uint8_t)~b) ? a + b : 255, AddBytesClip(a, b));
+}
+
+void BlitSubstractive(uint8_t *dst, uint8_t *src, int width, int height,
+                      int sstride, int dstride)
+{
+  BLIT_SWAR(a - b, SubBytes(a, b));
+}
+
+void BlitSubstractiveClip(uint8_t *dst, uint8_t *src, int width, int height,
+                          int sstride, int dstride)
+{
+  BLIT_SWAR((a > b) ? a - b : 0, SubBytesClip(a, b));
+}
+
+/* Table lookups don't vectorize here, so these are just unrolled. */
+void BlitColorMap(uint8_t *dst, uint8_t *src, int width, int height,
+                  int sstride, int dstride, uint8_t *cmap)
+{
+  do {
+    int x = width;
+
+    for (; x >= 4; x -= 4, dst += 4, src += 4) {
+      dst[0] = cmap[(dst[0] << 8) | src[0]];
+      dst[1] = cmap[(dst[1] << 8) | src[1]];
+      dst[2] = cmap[(dst[2] << 8) | src[2]];
+      dst[3] = cmap[(dst[3] << 8) | src[3]];
+    }
+
+    while (x-- > 0) {
+      *dst = cmap[(*dst << 8) | *src++];
+      dst++;
+    }
+
+    src += sstride;
+    dst += dstride;
+  } while (--height);
+}
+
+void BlitColorFunc(uint8_t *dst, uint8_t *src, int width, int height,
+                   int sstride, int dstride, uint8_t *cfunc)
+{
+  do {
+    int x = width;
+
+    for (; x >= 4; x -= 4, dst += 4, src += 4) {
+      dst[0] = cfunc[src[0]];
+      dst[1] = cfunc[src[1]];
+      dst[2] = cfunc[src[2]];
+      dst[3] = cfunc[src[3]];
+    }
+
+    while (x-- > 0)
+      *dst++ = cfunc[*src++];
+
+    src += sstride;
+    dst += dstride;
+  } while (--height);
+}
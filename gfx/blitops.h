@@ -0,0 +1,37 @@
+#ifndef __GFX_BLITOPS_H__
+#define __GFX_BLITOPS_H__
+
+#include "std/types.h"
+
+/*
+ * Portable implementations of every blit mode.  All of them take the same
+ * arguments as RawBlit* routines: width and height must be positive, and
+ * strides are the number of bytes skipped after each row.
+ *
+ * Arithmetic modes process four pixels at once in a 32-bit register (with
+ * carries kept from crossing byte boundaries), which is as close to SIMD as
+ * 68060 gets.
+ */
+void BlitNormal(uint8_t *dst, uint8_t *src, int width, int height,
+                int sstride, int dstride);
+/* Pixels of color 0 are not copied. */
+void BlitTransparent(uint8_t *dst, uint8_t *src, int width, int height,
+                     int sstride, int dstride);
+/* Sums and differences wrap around. */
+void BlitAdditive(uint8_t *dst, uint8_t *src, int width, int height,
+                  int sstride, int dstride);
+void BlitSubstractive(uint8_t *dst, uint8_t *src, int width, int height,
+                      int sstride, int dstride);
+/* Sums and differences saturate at 255 and 0. */
+void BlitAdditiveClip(uint8_t *dst, uint8_t *src, int width, int height,
+                      int sstride, int dstride);
+void BlitSubstractiveClip(uint8_t *dst, uint8_t *src, int width, int height,
+                          int sstride, int dstride);
+/* dst = cmap[dst * 256 + src] */
+void BlitColorMap(uint8_t *dst, uint8_t *src, int width, int height,
+                  int sstride, int dstride, uint8_t *cmap);
+/* dst = cfunc[src] */
+void BlitColorFunc(uint8_t *dst, uint8_t *src, int width, int height,
+                   int sstride, int dstride, uint8_t *cfunc);
+
+#endif
@@ -0,0 +1,124 @@
+#include <stdio.h>
+
+#include "std/debug.h"
+#include "std/memory.h"
+#include "gfx/colormap.h"
+
+static RGB Lighten(RGB *color, int level) {
+  float a = level / 255.0f;
+
+  return MakeRGB(color->r + (255 - color->r) * a,
+                 color->g + (255 - color->g) * a,
+                 color->b + (255 - color->b) * a);
+}
+
+static RGB Darken(RGB *color, int level) {
+  float a = level / 255.0f;
+
+  return MakeRGB(color->r * a, color->g * a, color->b * a);
+}
+
+static RGB Shade(RGB *color, int level) {
+  float a = 2.0f * level / 255.0f - 1.0f;
+
+  if (a >= 0.0f)
+    return MakeRGB(color->r + (255 - color->r) * a,
+                   color->g + (255 - color->g) * a,
+                   color->b + (255 - color->b) * a);
+
+  return MakeRGB(color->r * (1.0f + a), color->g * (1.0f + a),
+                 color->b * (1.0f + a));
+}
+
+static RGB Mix(RGB *color, RGB *other) {
+  return MakeRGB((color->r + other->r) / 2, (color->g + other->g) / 2,
+                 (color->b + other->b) / 2);
+}
+
+/*
+ * Indices that are not in the palette are left unchanged, so the map is
+ * always 256x256.
+ */
+PixBufT *NewColorMap(PaletteT *palette, ColorMapTypeT type) {
+  PixBufT *map = NewPixBuf(PIXBUF_GRAY, 256, 256);
+  uint8_t *data = map->data;
+  int x, y;
+
+  for (y = 0; y < 256; y++) {
+    RGB *color = PaletteGetColor(palette, y);
+
+    for (x = 0; x < 256; x++) {
+      RGB *other = (type == COLORMAP_TRANSPARENCY) ?
+        PaletteGetColor(palette, x) : NULL;
+      RGB result;
+
+      if (!color || (type == COLORMAP_TRANSPARENCY && !other)) {
+        *data++ = y;
+        continue;
+      }
+
+      switch (type) {
+        case COLORMAP_LIGHTEN:
+          result = Lighten(color, x);
+          break;
+        case COLORMAP_DARKEN:
+          result = Darken(color, x);
+          break;
+        case COLORMAP_SHADES:
+          result = Shade(color, x);
+          break;
+        default:
+          result = Mix(color, other);
+          break;
+      }
+
+      *data++ = PaletteFindNearest(palette, result);
+    }
+  }
+
+  PixBufCalculateHistogram(map);
+
+  return map;
+}
+
+/* FNV-1a over colors and their indices. */
+static uint32_t PaletteHash(PaletteT *palette, ColorMapTypeT type) {
+  uint32_t hash = 2166136261U ^ type;
+
+  for (; palette; palette = palette->next) {
+    uint8_t *byte = (uint8_t *)palette->colors;
+    size_t i;
+
+    hash = (hash ^ palette->start) * 16777619U;
+    hash = (hash ^ palette->count) * 16777619U;
+
+    for (i = 0; i < palette->count * sizeof(RGB); i++)
+      hash = (hash ^ byte[i]) * 16777619U;
+  }
+
+  return hash;
+}
+
+PixBufT *NewColorMapCached(PaletteT *palette, ColorMapTypeT type,
+                           const char *cacheDir)
+{
+  char path[256];
+  PixBufT *map;
+
+  snprintf(path, sizeof(path), "%s/cmap-%08x.8", cacheDir,
+           (unsigned)PaletteHash(palette, type));
+
+  if ((map = NewPixBufFromFile(path))) {
+    if (map->type == PIXBUF_GRAY && map->width == 256 && map->height == 256)
+      return map;
+
+    MemUnref(map);
+  }
+
+  LOG("Color map '%s' not cached, making it.", path);
+
+  map = NewColorMap(palette, type);
+  PixBufWriteToFile(map, path);
+
+  return map;
+}
@@ -0,0 +1,29 @@
+#ifndef __GFX_COLORMAP_H__
+#define __GFX_COLORMAP_H__
+
+#include "gfx/palette.h"
+#include "gfx/pixbuf.h"
+
+/*
+ * Color maps for BLIT_COLOR_MAP mode, same as made by scripts/colormap.py.
+ * Row is the color of destination pixel.  Column is a level (0 is black or
+ * original color, 255 is original color or white, shades go from black
+ * through original color to white), or another color for transparency.
+ */
+typedef enum {
+  COLORMAP_LIGHTEN,
+  COLORMAP_DARKEN,
+  COLORMAP_SHADES,
+  COLORMAP_TRANSPARENCY
+} ColorMapTypeT;
+
+PixBufT *NewColorMap(PaletteT *palette, ColorMapTypeT type);
+
+/*
+ * Reads the map from cache directory, if it was made before for a palette
+ * with the same colors.  Otherwise makes it and writes it there.
+ */
+PixBufT *NewColorMapCached(PaletteT *palette, ColorMapTypeT type,
+                           const char *cacheDir);
+
+#endif
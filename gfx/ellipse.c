@@ -34,11 +34,13 @@ void DrawEllipse(PixBufT *canvas, int xc, int yc, int a, int b) {
 
   SegmentT seg;
 
-  seg.stride = canvas->width;
+  seg.stride = canvas->stride;
   seg.color = canvas->fgColor;
   seg.upper = canvas->data + (yc - b) * seg.stride + xc;
   seg.lower = canvas->data + (yc + b) * seg.stride + xc;
 
+  PixBufMarkDirty(canvas, xc - a, yc - b, 2 * a, 2 * b + 1);
+
   while (dx < dy) {
     if (d > 0) {
       DrawEllipseSegment(&seg, x);
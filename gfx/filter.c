@@ -1,3 +1,6 @@
+#include <math.h>
+#include <string.h>
+
 #include "std/debug.h"
 #include "std/memory.h"
 #include "gfx/filter.h"
@@ -22,6 +25,8 @@ void BlurH3(PixBufT *dstBuf, PixBufT *srcBuf) {
   ASSERT(dstBuf->height == srcBuf->height,
          "Height does not match (%d != %d)", dstBuf->height, srcBuf->height);
 
+  PixBufMarkAllDirty(dstBuf);
+
   y = srcBuf->height;
 
   do {
@@ -41,26 +46,71 @@ void BlurH3(PixBufT *dstBuf, PixBufT *srcBuf) {
     /* give the last pixel special treatment: c[N] = c[N - 1] - src[N - 2] */
     *dst++ = DIV_BY_3(c);
 
-    prev += 2;
-    next += 2;
+    prev += 2 + srcBuf->stride - srcBuf->width;
+    next += 2 + srcBuf->stride - srcBuf->width;
+    dst += dstBuf->stride - dstBuf->width;
   } while (--y);
 }
 
-void BlurV3(PixBufT *dstBuf, PixBufT *srcBuf) {
+static void DeleteBlurBuffer(BlurBufferT *self) {
+  MemUnref(self->sum);
+  MemUnref(self->line);
+  MemUnref(self->ring);
+}
+
+TYPEDECL(BlurBufferT, (FreeFuncT)DeleteBlurBuffer);
+
+BlurBufferT *NewBlurBuffer(size_t width, size_t radius) {
+  BlurBufferT *self = NewInstance(BlurBufferT);
+
+  ASSERT(radius < 128, "Radius %d is too large.", (int)radius);
+
+  self->width = width;
+  self->radius = radius;
+  self->sum = NewTable(uint16_t, width);
+  self->line = NewTable(uint8_t, width + 2 * radius + 1);
+  self->ring = NewTable(uint8_t, width * (radius + 1));
+
+  return self;
+}
+
+static BlurBufferT *GetBlurBuffer(BlurBufferT *buffer, PixBufT *srcBuf,
+                                  size_t radius)
+{
+  if (!buffer)
+    return NewBlurBuffer(srcBuf->width, radius);
+
+  ASSERT(buffer->width >= srcBuf->width,
+         "Blur buffer too narrow (%d < %d).",
+         (int)buffer->width, srcBuf->width);
+  ASSERT(buffer->radius >= radius,
+         "Blur buffer radius too small (%d < %d).",
+         (int)buffer->radius, (int)radius);
+
+  return buffer;
+}
+
+void BlurV3(PixBufT *dstBuf, PixBufT *srcBuf, BlurBufferT *buffer) {
   uint8_t *dst = dstBuf->data;
   uint8_t *prev = srcBuf->data;
-  uint8_t *next = srcBuf->data + 2 * srcBuf->width;
+  uint8_t *next = srcBuf->data + 2 * srcBuf->stride;
   int16_t x, y;
 
+  BlurBufferT *scratch = GetBlurBuffer(buffer, srcBuf, 1);
+
   /* at any given moment keeps a sum of three pixels */
-  int16_t *line = NewTable(int16_t, srcBuf->width);
+  uint16_t *line = scratch->sum;
+
+  PixBufMarkAllDirty(dstBuf);
 
   /* initially line is a sum of srcLine[0] and srcLine[1] */
   for (x = 0; x < srcBuf->width; x++) {
-    line[x] = srcBuf->data[x] + srcBuf->data[x + srcBuf->width];
+    line[x] = srcBuf->data[x] + srcBuf->data[x + srcBuf->stride];
     *dst++ = DIV_BY_3(line[x]);
   }
 
+  dst += dstBuf->stride - dstBuf->width;
+
   ASSERT(dstBuf->width == srcBuf->width,
          "Width does not match (%d != %d)", dstBuf->width, srcBuf->width);
   ASSERT(dstBuf->height == srcBuf->height,
@@ -74,10 +124,189 @@ void BlurV3(PixBufT *dstBuf, PixBufT *srcBuf) {
       *dst++ = DIV_BY_3(line[x]);
       line[x] -= *prev++; 
     }
-  } while (--y >= 0);
+
+    prev += srcBuf->stride - srcBuf->width;
+    next += srcBuf->stride - srcBuf->width;
+    dst += dstBuf->stride - dstBuf->width;
+  } while (--y > 0);
 
   for (x = 0; x < srcBuf->width; x++)
     *dst++ = DIV_BY_3(line[x]);
 
-  MemUnref(line);
+  if (scratch != buffer)
+    MemUnref(scratch);
+}
+
+static inline void CheckSizes(PixBufT *dstBuf, PixBufT *srcBuf) {
+  ASSERT(dstBuf->width == srcBuf->width,
+         "Width does not match (%d != %d)", dstBuf->width, srcBuf->width);
+  ASSERT(dstBuf->height == srcBuf->height,
+         "Height does not match (%d != %d)", dstBuf->height, srcBuf->height);
+}
+
+/*
+ * Divides the sum of n = 2 * radius + 1 pixels by n, rounded to nearest.
+ * The reciprocal is 2^24 / n rounded up, which is exact for sums below 2^16
+ * and n up to 256.  Product is below 256 * 2^24, so it fits in 32 bits.
+ */
+#define BOX_SCALE(radius) \
+  (((1 << 24) + 2 * (radius)) / (2 * (radius) + 1))
+#define BOX_DIV(sum, radius, scale) \
+  ((((uint32_t)(sum) + (radius)) * (scale)) >> 24)
+
+/*
+ * Each row is copied to the buffer first, with edge pixels replicated on both
+ * sides.  That makes the inner loop branchless and works in place.
+ */
+void BlurBoxH(PixBufT *dstBuf, PixBufT *srcBuf, size_t radius,
+              BlurBufferT *buffer)
+{
+  BlurBufferT *scratch = GetBlurBuffer(buffer, srcBuf, radius);
+  const uint32_t scale = BOX_SCALE(radius);
+  const int16_t width = srcBuf->width;
+  const int16_t r = radius;
+  uint8_t *__restrict__ line = scratch->line;
+  int16_t x, y;
+
+  CheckSizes(dstBuf, srcBuf);
+
+  PixBufMarkAllDirty(dstBuf);
+
+  for (y = 0; y < srcBuf->height; y++) {
+    uint8_t *src = srcBuf->data + y * srcBuf->stride;
+    uint8_t *dst = dstBuf->data + y * dstBuf->stride;
+    uint16_t sum = 0;
+
+    memset(line, src[0], r);
+    memcpy(line + r, src, width);
+    memset(line + r + width, src[width - 1], r + 1);
+
+    for (x = 0; x <= 2 * r; x++)
+      sum += line[x];
+
+    for (x = 0; x < width; x++) {
+      *dst++ = BOX_DIV(sum, r, scale);
+      sum += line[x + 2 * r + 1] - line[x];
+    }
+  }
+
+  if (scratch != buffer)
+    MemUnref(scratch);
+}
+
+/*
+ * Keeps a sum of a column window per each pixel in a row.  Original contents
+ * of last (radius + 1) rows are saved in a ring buffer, since they have to be
+ * subtracted after they were overwritten by in place blur.
+ */
+void BlurBoxV(PixBufT *dstBuf, PixBufT *srcBuf, size_t radius,
+              BlurBufferT *buffer)
+{
+  BlurBufferT *scratch = GetBlurBuffer(buffer, srcBuf, radius);
+  const uint32_t scale = BOX_SCALE(radius);
+  const int16_t width = srcBuf->width;
+  const int16_t height = srcBuf->height;
+  const int16_t r = radius;
+  uint16_t *__restrict__ sum = scratch->sum;
+  uint8_t *ring = scratch->ring;
+  int16_t x, y;
+
+  CheckSizes(dstBuf, srcBuf);
+
+  PixBufMarkAllDirty(dstBuf);
+
+  /* window of first row, rows above the image replicate the first one */
+  for (x = 0; x < width; x++)
+    sum[x] = (r + 1) * srcBuf->data[x];
+
+  for (y = 1; y <= r; y++) {
+    uint8_t *src = srcBuf->data + min(y, height - 1) * srcBuf->stride;
+
+    for (x = 0; x < width; x++)
+      sum[x] += src[x];
+  }
+
+  for (y = 0; y < height; y++) {
+    uint8_t *src = srcBuf->data + y * srcBuf->stride;
+    uint8_t *dst = dstBuf->data + y * dstBuf->stride;
+    uint8_t *add, *sub;
+
+    memcpy(ring + (y % (r + 1)) * width, src, width);
+
+    for (x = 0; x < width; x++)
+      dst[x] = BOX_DIV(sum[x], r, scale);
+
+    if (y == height - 1)
+      break;
+
+    /* rows below current one have not been touched yet */
+    add = srcBuf->data + min(y + r + 1, height - 1) * srcBuf->stride;
+    sub = ring + (max(y - r, 0) % (r + 1)) * width;
+
+    for (x = 0; x < width; x++)
+      sum[x] += add[x] - sub[x];
+  }
+
+  if (scratch != buffer)
+    MemUnref(scratch);
+}
+
+void BlurBox(PixBufT *dstBuf, PixBufT *srcBuf, size_t radius,
+             BlurBufferT *buffer)
+{
+  BlurBufferT *scratch = GetBlurBuffer(buffer, srcBuf, radius);
+
+  BlurBoxH(dstBuf, srcBuf, radius, scratch);
+  BlurBoxV(dstBuf, dstBuf, radius, scratch);
+
+  if (scratch != buffer)
+    MemUnref(scratch);
+}
+
+/*
+ * Three boxes of width w or w + 2 are chosen, so that the variance of their
+ * convolution is closest to sigma squared.  Refer to "Fast Almost-Gaussian
+ * Filtering" by Peter Kovesi.
+ */
+static void GaussianBoxes(float sigma, size_t radius[3]) {
+  float var12 = 12.0f * sigma * sigma;
+  int wl = (int)sqrtf(var12 / 3.0f + 1.0f);
+  int m, i;
+
+  if (!(wl & 1))
+    wl--;
+
+  m = (int)((var12 - 3 * wl * wl - 12 * wl - 9) / (-4 * wl - 4) + 0.5f);
+
+  for (i = 0; i < 3; i++)
+    radius[i] = ((i < m) ? wl : wl + 2) / 2;
+}
+
+size_t BlurGaussianRadius(float sigma) {
+  size_t radius[3];
+
+  GaussianBoxes(sigma, radius);
+
+  return max(radius[0], radius[2]);
+}
+
+void BlurGaussian(PixBufT *dstBuf, PixBufT *srcBuf, float sigma,
+                  BlurBufferT *buffer)
+{
+  size_t radius[3];
+  BlurBufferT *scratch;
+
+  GaussianBoxes(sigma, radius);
+
+  scratch = GetBlurBuffer(buffer, srcBuf, max(radius[0], radius[2]));
+
+  BlurBoxH(dstBuf, srcBuf, radius[0], scratch);
+  BlurBoxH(dstBuf, dstBuf, radius[1], scratch);
+  BlurBoxH(dstBuf, dstBuf, radius[2], scratch);
+  BlurBoxV(dstBuf, dstBuf, radius[0], scratch);
+  BlurBoxV(dstBuf, dstBuf, radius[1], scratch);
+  BlurBoxV(dstBuf, dstBuf, radius[2], scratch);
+
+  if (scratch != buffer)
+    MemUnref(scratch);
 }
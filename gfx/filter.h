@@ -4,6 +4,41 @@
 #include "gfx/pixbuf.h"
 
 void BlurH3(PixBufT *dstBuf, PixBufT *srcBuf);
-void BlurV3(PixBufT *dstBuf, PixBufT *srcBuf);
+
+/*
+ * Scratch space for blurs of images up to given width and radius, so that
+ * they don't allocate memory on each call.  Radius must be less than 128.
+ */
+typedef struct BlurBuffer {
+  size_t width;
+  size_t radius;
+
+  uint16_t *sum;
+  uint8_t *line;
+  uint8_t *ring;
+} BlurBufferT;
+
+BlurBufferT *NewBlurBuffer(size_t width, size_t radius);
+
+/* Buffer may be NULL, then scratch space is allocated for the call. */
+void BlurV3(PixBufT *dstBuf, PixBufT *srcBuf, BlurBufferT *buffer);
+
+/*
+ * Box blur of any radius with constant cost per pixel.  Pixels beyond the
+ * edge are replicated.  Destination may be the same as source.
+ */
+void BlurBoxH(PixBufT *dstBuf, PixBufT *srcBuf, size_t radius,
+              BlurBufferT *buffer);
+void BlurBoxV(PixBufT *dstBuf, PixBufT *srcBuf, size_t radius,
+              BlurBufferT *buffer);
+void BlurBox(PixBufT *dstBuf, PixBufT *srcBuf, size_t radius,
+             BlurBufferT *buffer);
+
+/* Approximation by three box blurs in each direction. */
+void BlurGaussian(PixBufT *dstBuf, PixBufT *srcBuf, float sigma,
+                  BlurBufferT *buffer);
+
+/* Returns radius of the widest box used by BlurGaussian. */
+size_t BlurGaussianRadius(float sigma);
 
 #endif
@@ -21,7 +21,9 @@ void LayersCompose(PixBufT *canvas, PixBufT *composeMap,
                    PixBufT **layers, size_t no_layers)
 {
   uint8_t **src = alloca(sizeof(uint8_t *) * no_layers);
-  int i;
+  bool contiguous = PixBufIsContiguous(canvas) &&
+                    PixBufIsContiguous(composeMap);
+  int i, y;
 
   for (i = 0; i < no_layers; i++) {
     ASSERT(layers[i]->width == canvas->width,
@@ -31,9 +33,25 @@ void LayersCompose(PixBufT *canvas, PixBufT *composeMap,
            "Height does not match (%d != %d) for layer #%d.",
            layers[i]->height, canvas->height, i);
     src[i] = layers[i]->data;
+    contiguous &= PixBufIsContiguous(layers[i]);
   }
 
-  LayersComposeLoop(composeMap->data, canvas->data, src,
-                    canvas->width * canvas->height, no_layers,
-                    canvas->baseColor);
+  PixBufMarkAllDirty(canvas);
+
+  if (contiguous) {
+    LayersComposeLoop(composeMap->data, canvas->data, src,
+                      canvas->width * canvas->height, no_layers,
+                      canvas->baseColor);
+    return;
+  }
+
+  /* Some of buffers are views, so compose them row by row. */
+  for (y = 0; y < canvas->height; y++) {
+    LayersComposeLoop(composeMap->data + y * composeMap->stride,
+                      canvas->data + y * canvas->stride, src,
+                      canvas->width, no_layers, canvas->baseColor);
+
+    for (i = 0; i < no_layers; i++)
+      src[i] += layers[i]->stride;
+  }
 }
@@ -90,6 +90,8 @@ DrawLineUnsafe(PixBufT *canvas, int xs, int ys, int xe, int ye) {
     swapr(ys, ye);
   }
 
+  PixBufMarkDirty(canvas, min(xs, xe), ys, abs(xe - xs) + 1, ye - ys + 1);
+
   /*  quarters:
    *
    *  \ 1 | 3 /
@@ -115,7 +117,7 @@ DrawLineUnsafe(PixBufT *canvas, int xs, int ys, int xe, int ye) {
   dy = ye - ys;
 
   color = canvas->fgColor;
-  stride = canvas->width;
+  stride = canvas->stride;
   pixels = canvas->data + ys * stride + xs;
 
   /* (xs, ys, xe, ye) unused from now on */
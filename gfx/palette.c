@@ -8,6 +8,7 @@
 
 static void DeletePalette(PaletteT *palette) {
   MemUnref(palette->colors);
+  MemUnref(palette->inverse);
 
   if (palette->next)
     MemUnref(palette->next);
@@ -72,6 +73,8 @@ bool LinkPalettes(PaletteT *palette, ...) {
     palette->start = start;
     palette->next = next;
 
+    PaletteChanged(palette);
+
     start += palette->count;
 
     if (!next)
@@ -90,11 +93,12 @@ void UnlinkPalettes(PaletteT *palette) {
     PaletteT *next = palette->next;
 
     palette->next = NULL;
+    PaletteChanged(palette);
     palette = next;
   }
 }
 
-int PaletteFindNearest(PaletteT *palette, RGB color) {
+int PaletteFindNearestExact(PaletteT *palette, RGB color) {
   int16_t r = color.r;
   int16_t g = color.g;
   int16_t b = color.b;
@@ -123,6 +127,65 @@ int PaletteFindNearest(PaletteT *palette, RGB color) {
   return index;
 }
 
+RGB *PaletteGetColor(PaletteT *palette, int index) {
+  for (; palette; palette = palette->next)
+    if (index >= palette->start && index < palette->start + palette->count)
+      return &palette->colors[index - palette->start];
+
+  return NULL;
+}
+
+/* Strictly increasing, so no two states of a chain share a version. */
+static uint32_t Generation = 0;
+
+void PaletteChanged(PaletteT *palette) {
+  palette->version = ++Generation;
+}
+
+/*
+ * Relinking or unlinking changes 'next' of some palette in the chain, so any
+ * change to the chain is seen as a version newer than the inverse color map.
+ */
+static uint32_t ChainVersion(PaletteT *palette) {
+  uint32_t version = 0;
+
+  for (; palette; palette = palette->next)
+    version = max(version, palette->version);
+
+  return version;
+}
+
+#define INVERSE_UNKNOWN 0xffff
+
+int PaletteFindNearest(PaletteT *palette, RGB color) {
+  uint32_t version = ChainVersion(palette);
+  size_t cell =
+    ((color.r >> 3) << 10) | ((color.g >> 3) << 5) | (color.b >> 3);
+  uint16_t *inverse = palette->inverse;
+
+  if (!inverse || version > palette->inverseVersion) {
+    if (!inverse)
+      inverse = palette->inverse = NewTable(uint16_t, 32768);
+
+    memset(inverse, 0xff, sizeof(uint16_t) * 32768);
+    palette->inverseVersion = Generation;
+  }
+
+  if (inverse[cell] == INVERSE_UNKNOWN) {
+    /* Center of the cell stands for all colors within. */
+    RGB center = MakeRGB((color.r & ~7) | 4, (color.g & ~7) | 4,
+                         (color.b & ~7) | 4);
+    int index = PaletteFindNearestExact(palette, center);
+
+    if (index < 0)
+      return index;
+
+    inverse[cell] = index;
+  }
+
+  return inverse[cell];
+}
+
 void PaletteModify(PaletteT *dst, PaletteT *src, ColorModifyFuncT func) {
   int i = 0, j = 0;
 
@@ -136,7 +199,11 @@ void PaletteModify(PaletteT *dst, PaletteT *src, ColorModifyFuncT func) {
 
     if (j == dst->count) {
       j = 0;
+      PaletteChanged(dst);
       dst = dst->next;
     }
   }
+
+  if (dst && j)
+    PaletteChanged(dst);
 }
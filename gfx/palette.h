@@ -11,6 +11,17 @@ struct Palette {
   uint16_t start;
   uint16_t count;
   PaletteT *next;
+
+  /* Set by PaletteChanged from a global, strictly increasing generation. */
+  uint32_t version;
+
+  /*
+   * Inverse color map: nearest color for each cell of 15-bit RGB cube, filled
+   * in on demand.  Valid as long as no linked palette has a version newer
+   * than inverseVersion, the generation at the time it was cleared.
+   */
+  uint16_t *inverse;
+  uint32_t inverseVersion;
 };
 
 PaletteT *NewPalette(size_t count);
@@ -19,7 +30,22 @@ PaletteT *NewPaletteFromFile(const char *fileName);
 bool LinkPalettes(PaletteT *palette, ...);
 void UnlinkPalettes(PaletteT *palette);
 
+/*
+ * Looks up the inverse color map, which stores the entry nearest to the
+ * center of each 8x8x8 cell of RGB space.  Result may differ from
+ * exhaustive search for any color, and with dense palettes (e.g. gradients)
+ * several entries share a cell, so an exact palette color may not map back
+ * to itself.  Meant for bulk lookups; use PaletteFindNearestExact for a few
+ * colors that must match.
+ */
 int PaletteFindNearest(PaletteT *palette, RGB color);
+int PaletteFindNearestExact(PaletteT *palette, RGB color);
+
+/* Returns NULL if none of linked palettes has a color with given index. */
+RGB *PaletteGetColor(PaletteT *palette, int index);
+
+/* Must be called after colors are modified directly. */
+void PaletteChanged(PaletteT *palette);
 
 void PaletteModify(PaletteT *dst, PaletteT *src, ColorModifyFuncT func);
 
@@ -6,8 +6,13 @@
 #include "gfx/pixbuf.h"
 
 static void DeletePixBuf(PixBufT *pixbuf) {
+  ASSERT(!pixbuf->views, "Image still has %d views.", pixbuf->views);
+
+  if (pixbuf->parent)
+    pixbuf->parent->views--;
   if (pixbuf->ownership)
     MemUnref(pixbuf->data);
+  MemUnref(pixbuf->dirty);
 }
 
 TYPEDECL(PixBufT, (FreeFuncT)DeletePixBuf);
@@ -18,6 +23,7 @@ PixBufT *NewPixBuf(uint16_t type, size_t width, size_t height) {
   pixbuf->type = type;
   pixbuf->width = width;
   pixbuf->height = height;
+  pixbuf->stride = width;
 
   LOG("Creating %d-bit image of size (%d,%d).",
       (type >= PIXBUF_RGB) ? 24 : 8, (int)width, (int)height);
@@ -57,19 +63,51 @@ typedef struct DiskPixBuf {
   uint8_t  data[0];
 } DiskPixBufT;
 
+static size_t DiskPixBufLength(DiskPixBufT *file) {
+  size_t size = file->width * file->height;
+
+  switch (file->type) {
+    case PIXBUF_CLUT:
+    case PIXBUF_GRAY:
+      return sizeof(DiskPixBufT) + size;
+    case PIXBUF_RGB:
+      return sizeof(DiskPixBufT) + size * sizeof(RGB);
+    case PIXBUF_RGBA:
+      return sizeof(DiskPixBufT) + size * sizeof(RGBA);
+    default:
+      return 0;
+  }
+}
+
 PixBufT *NewPixBufFromFile(const char *fileName) {
-  DiskPixBufT *file = (DiskPixBufT *)ReadFileSimple(fileName);
+  RwOpsT *fh = RwOpsFromFile(fileName, "r");
+  PixBufT *pixbuf = NULL;
 
-  if (file) {
-    PixBufT *pixbuf = NewPixBuf(file->type, file->width, file->height);
+  if (fh) {
+    DiskPixBufT file;
+    int size = IoSize(fh);
 
-    pixbuf->mode = file->mode;
+    if (IoRead(fh, &file, sizeof(file)) == sizeof(file) &&
+        DiskPixBufLength(&file) == size)
+    {
+      size_t length = size - sizeof(file);
 
-    MemCopy(pixbuf->data, file->data, 
-            TableSize(pixbuf->data) * TableElemSize(pixbuf->data));
+      pixbuf = NewPixBuf(file.type, file.width, file.height);
+      pixbuf->mode = file.mode;
+
+      if (IoRead(fh, pixbuf->data, length) != length) {
+        MemUnref(pixbuf);
+        pixbuf = NULL;
+      }
+    }
 
-    MemUnref(file);
+    IoClose(fh);
 
+    if (!pixbuf)
+      LOG("Image '%s' is truncated or damaged.", fileName);
+  }
+
+  if (pixbuf) {
     if (pixbuf->type == PIXBUF_CLUT || pixbuf->type == PIXBUF_GRAY) {
       PixBufCalculateHistogram(pixbuf);
 
@@ -80,11 +118,32 @@ PixBufT *NewPixBufFromFile(const char *fileName) {
       LOG("True color image '%s' has size (%d,%d).",
           fileName, pixbuf->width, pixbuf->height);
     }
-
-    return pixbuf;
   }
 
-  return NULL;
+  return pixbuf;
+}
+
+void PixBufWriteToFile(PixBufT *pixbuf, const char *fileName) {
+  size_t size = pixbuf->width * pixbuf->height;
+  size_t length = sizeof(DiskPixBufT) + size;
+  DiskPixBufT *file;
+
+  ASSERT(pixbuf->type == PIXBUF_CLUT || pixbuf->type == PIXBUF_GRAY,
+         "Only 8-bit images can be written.");
+  ASSERT(PixBufIsContiguous(pixbuf), "Views are not supported.");
+
+  file = MemNew(length);
+
+  file->type = pixbuf->type;
+  file->mode = pixbuf->mode;
+  file->width = pixbuf->width;
+  file->height = pixbuf->height;
+
+  MemCopy(file->data, pixbuf->data, size);
+
+  WriteFileSimple(fileName, file, length);
+
+  MemUnref(file);
 }
 
 PixBufT *NewPixBufWrapper(size_t width, size_t height, uint8_t *data) {
@@ -93,6 +152,7 @@ PixBufT *NewPixBufWrapper(size_t width, size_t height, uint8_t *data) {
   pixbuf->type = PIXBUF_GRAY;
   pixbuf->width = width;
   pixbuf->height = height;
+  pixbuf->stride = width;
   pixbuf->ownership = false;
   pixbuf->data = data;
   pixbuf->lastColor = 255;
@@ -101,11 +161,133 @@ PixBufT *NewPixBufWrapper(size_t width, size_t height, uint8_t *data) {
   return pixbuf;
 }
 
+PixBufT *NewPixBufView(PixBufT *parent, const RectT *rect) {
+  PixBufT *pixbuf = NewInstance(PixBufT);
+  PixBufT *root = parent->parent ? parent->parent : parent;
+  size_t pixelSize = (parent->type == PIXBUF_RGBA) ? sizeof(RGBA) :
+                     (parent->type == PIXBUF_RGB) ? sizeof(RGB) : 1;
+
+  ASSERT(rect->x >= 0 && rect->y >= 0 && rect->w > 0 && rect->h > 0 &&
+         rect->x + rect->w <= parent->width &&
+         rect->y + rect->h <= parent->height,
+         "View (%d,%d,%d,%d) does not fit in image of size (%d,%d).",
+         rect->x, rect->y, rect->w, rect->h, parent->width, parent->height);
+
+  /* Inherit blit mode, colors, etc. */
+  *pixbuf = *parent;
+
+  pixbuf->width = rect->w;
+  pixbuf->height = rect->h;
+  pixbuf->ownership = false;
+  pixbuf->dirty = NULL;
+  pixbuf->data = parent->data +
+    (rect->y * parent->stride + rect->x) * pixelSize;
+
+  /* View of a view refers directly to the image owning pixels. */
+  pixbuf->parent = root;
+  pixbuf->parentX += rect->x;
+  pixbuf->parentY += rect->y;
+  pixbuf->views = 0;
+  root->views++;
+
+  return pixbuf;
+}
+
+void PixBufEnableDirty(PixBufT *pixbuf) {
+  size_t rows = (pixbuf->height + PIXBUF_DIRTY_H - 1) / PIXBUF_DIRTY_H;
+
+  ASSERT(pixbuf->width <= 32 * PIXBUF_DIRTY_W,
+         "Image too wide (%d) for dirty tracking.", pixbuf->width);
+  ASSERT(pixbuf->ownership, "Cannot track dirty blocks of a view.");
+
+  if (!pixbuf->dirty) {
+    pixbuf->dirty = NewTable(uint32_t, rows * 3);
+    PixBufMarkAllDirty(pixbuf);
+  }
+}
+
+void PixBufMarkDirtyRect(PixBufT *pixbuf, int x, int y, int w, int h) {
+  int x0 = max(x, 0);
+  int y0 = max(y, 0);
+  int x1 = min(x + w, (int)pixbuf->width);
+  int y1 = min(y + h, (int)pixbuf->height);
+
+  if (pixbuf->parent) {
+    if (x0 < x1 && y0 < y1)
+      PixBufMarkDirtyRect(pixbuf->parent, x0 + pixbuf->parentX,
+                          y0 + pixbuf->parentY, x1 - x0, y1 - y0);
+    return;
+  }
+
+  if (pixbuf->dirty && x0 < x1 && y0 < y1) {
+    int rows = (pixbuf->height + PIXBUF_DIRTY_H - 1) / PIXBUF_DIRTY_H;
+    int c0 = x0 / PIXBUF_DIRTY_W;
+    int c1 = (x1 - 1) / PIXBUF_DIRTY_W;
+    /* bits c0 .. c1 set, written so that c1 = 31 doesn't overflow */
+    uint32_t mask = ((2U << c1) - 1) & ~((1U << c0) - 1);
+    uint32_t *row = &pixbuf->dirty[y0 / PIXBUF_DIRTY_H];
+    uint32_t *last = &pixbuf->dirty[(y1 - 1) / PIXBUF_DIRTY_H];
+
+    do {
+      row[0] |= mask;
+      row[rows * 2] |= mask;
+    } while (++row <= last);
+  }
+}
+
+void PixBufEraseDirty(PixBufT *pixbuf, PixBufT *background) {
+  int rows = (pixbuf->height + PIXBUF_DIRTY_H - 1) / PIXBUF_DIRTY_H;
+  uint32_t *current = pixbuf->dirty;
+  uint32_t *drawn = pixbuf->dirty + rows * 2;
+  int r;
+
+  ASSERT(current, "Dirty tracking is not enabled.");
+  ASSERT(!background || (background->width == pixbuf->width &&
+                         background->height == pixbuf->height),
+         "Background size does not match (%d, %d).",
+         background->width, background->height);
+
+  for (r = 0; r < rows; r++) {
+    uint32_t mask = drawn[r];
+    int ys = r * PIXBUF_DIRTY_H;
+    int ye = min(ys + PIXBUF_DIRTY_H, (int)pixbuf->height);
+
+    /* Erased blocks change, so they must be converted again. */
+    current[r] |= mask;
+    drawn[r] = 0;
+
+    while (mask) {
+      int c0 = 0, c1, x, w, y;
+
+      while (!(mask & (1U << c0)))
+        c0++;
+      for (c1 = c0; c1 < 32 && (mask & (1U << c1)); c1++)
+        mask &= ~(1U << c1);
+
+      x = c0 * PIXBUF_DIRTY_W;
+      w = min(c1 * PIXBUF_DIRTY_W, (int)pixbuf->width) - x;
+
+      for (y = ys; y < ye; y++) {
+        uint8_t *d = pixbuf->data + y * pixbuf->stride + x;
+
+        if (background)
+          MemCopy(d, background->data + y * background->stride + x, w);
+        else
+          memset(d, pixbuf->bgColor, w);
+      }
+    }
+  }
+}
+
+/* Strictly increasing, so each call gives the color map a new version. */
+static uint32_t ColorMapGeneration = 0;
+
 void PixBufSetColorMap(PixBufT *pixbuf, PixBufT *colorMap) {
   ASSERT((colorMap->type == PIXBUF_GRAY || colorMap->type == PIXBUF_CLUT) &&
          colorMap->width == 256,
          "Color map must be 8-bit gray image of width 256.");
   pixbuf->blit.cmap = colorMap->data;
+  pixbuf->cmapVersion = ++ColorMapGeneration;
 }
 
 void PixBufSetColorFunc(PixBufT *pixbuf, uint8_t *colorFunc) {
@@ -125,10 +307,15 @@ void PixBufSwapData(PixBufT *buf1, PixBufT *buf2) {
          "Width does not match (%d != %d)", buf1->width, buf2->width);
   ASSERT(buf1->height == buf2->height,
          "Height does not match (%d != %d)", buf1->height, buf2->height);
+  ASSERT(buf1->stride == buf2->stride,
+         "Stride does not match (%d != %d)", buf1->stride, buf2->stride);
 
   tmp = buf1->data;
   buf1->data = buf2->data;
   buf2->data = tmp;
+
+  PixBufMarkAllDirty(buf1);
+  PixBufMarkAllDirty(buf2);
 }
 
 void PixBufCopy(PixBufT *dst, PixBufT *src) {
@@ -136,11 +323,33 @@ void PixBufCopy(PixBufT *dst, PixBufT *src) {
          "Width does not match (%d != %d)", src->width, dst->width);
   ASSERT(src->height == dst->height,
          "Height does not match (%d != %d)", src->height, dst->height);
-  MemCopy(dst->data, src->data, src->width * src->height);
+
+  if (PixBufIsContiguous(dst) && PixBufIsContiguous(src)) {
+    MemCopy(dst->data, src->data, src->width * src->height);
+  } else {
+    uint8_t *d = dst->data;
+    uint8_t *s = src->data;
+    int y;
+
+    for (y = 0; y < src->height; y++, d += dst->stride, s += src->stride)
+      MemCopy(d, s, src->width);
+  }
+
+  PixBufMarkAllDirty(dst);
 }
 
 void PixBufClear(PixBufT *pixbuf) {
-  memset(pixbuf->data, pixbuf->bgColor, pixbuf->width * pixbuf->height);
+  if (PixBufIsContiguous(pixbuf)) {
+    memset(pixbuf->data, pixbuf->bgColor, pixbuf->width * pixbuf->height);
+  } else {
+    uint8_t *d = pixbuf->data;
+    int y;
+
+    for (y = 0; y < pixbuf->height; y++, d += pixbuf->stride)
+      memset(d, pixbuf->bgColor, pixbuf->width);
+  }
+
+  PixBufMarkAllDirty(pixbuf);
 }
 
 void PixBufRemap(PixBufT *pixbuf, PaletteT *palette) {
@@ -153,29 +362,36 @@ void PixBufRemap(PixBufT *pixbuf, PaletteT *palette) {
 
   {
     int color = palette->start - pixbuf->baseColor;
-    int i;
+    int x, y;
 
     LOG("Remapping by %d colors.", color);
 
-    for (i = 0; i < pixbuf->width * pixbuf->height; i++) {
-      if ((pixbuf->mode == BLIT_TRANSPARENT) && (pixbuf->data[i] == 0))
-          continue;
+    for (y = 0; y < pixbuf->height; y++) {
+      uint8_t *data = &pixbuf->data[y * pixbuf->stride];
+
+      for (x = 0; x < pixbuf->width; x++) {
+        if ((pixbuf->mode == BLIT_TRANSPARENT) && (data[x] == 0))
+            continue;
 
-      pixbuf->data[i] += color;
+        data[x] += color;
+      }
     }
 
     pixbuf->baseColor = palette->start;
     pixbuf->lastColor = palette->start + palette->count - 1;
   }
+
+  PixBufMarkAllDirty(pixbuf);
 }
 
 void PixBufCalculateHistogram(PixBufT *pixbuf) {
   if (pixbuf->type == PIXBUF_CLUT || pixbuf->type == PIXBUF_GRAY) {
     uint32_t *histogram = NewTable(uint32_t, 256);
-    uint32_t i;
+    uint32_t i, x, y;
 
-    for (i = 0; i < pixbuf->width * pixbuf->height; i++)
-      histogram[pixbuf->data[i]]++;
+    for (y = 0; y < pixbuf->height; y++)
+      for (x = 0; x < pixbuf->width; x++)
+        histogram[pixbuf->data[y * pixbuf->stride + x]]++;
 
     /* Calculate unique colors. */
     for (i = 0; i < 256; i++) {
@@ -202,12 +418,12 @@ void PixBufCalculateHistogram(PixBufT *pixbuf) {
 }
 
 __regargs int GetFilteredPixel(PixBufT *pixbuf, FP16 x, FP16 y) {
-  uint8_t *data = &pixbuf->data[pixbuf->width * FP16_i(y) + FP16_i(x)];
+  uint8_t *data = &pixbuf->data[pixbuf->stride * FP16_i(y) + FP16_i(x)];
 
   int p1 = data[0];
   int p2 = data[1];
-  int p3 = data[pixbuf->width];
-  int p4 = data[pixbuf->width + 1];
+  int p3 = data[pixbuf->stride];
+  int p4 = data[pixbuf->stride + 1];
 
   int d31 = p1 + ((p3 - p1) * FP16_f(y) >> 16);
   int d42 = p2 + ((p4 - p2) * FP16_f(y) >> 16);
@@ -2,6 +2,7 @@
 #define __GFX_PIXBUF_H__
 
 #include "std/types.h"
+#include "gfx/common.h"
 #include "gfx/palette.h"
 #include "std/fp16.h"
 
@@ -23,16 +24,36 @@ typedef enum {
 
 typedef struct PixBuf PixBufT;
 
+/* Dirty blocks match c2p granularity: 32 pixels wide, 8 rows high. */
+#define PIXBUF_DIRTY_W 32
+#define PIXBUF_DIRTY_H 8
+
 struct PixBuf {
   /* Basic information. */
   uint16_t type;
   BlitModeT mode;
   uint32_t width, height;
+  /* Distance between rows in pixels, greater than width for views. */
+  uint32_t stride;
 
   /* Pixel data. */
-  bool ownership; /* false if PixBuf wraps a table */
+  bool ownership; /* false if PixBuf wraps a table or is a view */
   uint8_t *data;
 
+  /*
+   * One mask per row of dirty blocks, bit n stands for n-th block column.
+   * Masks of the current frame are followed by masks of the previous one
+   * and masks of blocks drawn since last PixBufEraseDirty.  NULL if tracking
+   * is disabled.  Views have none, they forward marks to their parent.
+   */
+  uint32_t *dirty;
+
+  /* Image that a view is part of, marks are forwarded there. */
+  PixBufT *parent;
+  uint16_t parentX, parentY;
+  /* Views of the image, it must not be deleted before them. */
+  uint16_t views;
+
   /* Valid only in GRAY or CLUT mode. */
   uint16_t uniqueColors;  /* stores number of unique colors in the image */
   uint8_t baseColor;
@@ -48,35 +69,78 @@ struct PixBuf {
     /* For BLIT_COLOR_FUNC mode. */
     uint8_t *cfunc;
   } blit;
+
+  /* Set by PixBufSetColorMap, tables derived from the map check it. */
+  uint32_t cmapVersion;
 };
 
 PixBufT *NewPixBuf(uint16_t type, size_t width, size_t height);
+/* Returns NULL if the file is missing, truncated or has a broken header. */
 PixBufT *NewPixBufFromFile(const char *fileName);
 PixBufT *NewPixBufWrapper(size_t width, size_t height, uint8_t *data);
+/*
+ * Wraps a rectangle of another PixBuf without copying.  Deleting the parent
+ * before the view fails an assertion.  Blocks drawn into the view are marked
+ * dirty in the parent.
+ */
+PixBufT *NewPixBufView(PixBufT *parent, const RectT *rect);
+
+static inline bool PixBufIsContiguous(PixBufT *pixbuf) {
+  return pixbuf->stride == pixbuf->width;
+}
+
+/* Width of the image must not exceed 32 dirty blocks. */
+void PixBufEnableDirty(PixBufT *pixbuf);
+void PixBufMarkDirtyRect(PixBufT *pixbuf, int x, int y, int w, int h);
+
+static inline bool PixBufTracksDirty(PixBufT *pixbuf) {
+  return pixbuf->dirty || (pixbuf->parent && pixbuf->parent->dirty);
+}
+
+static inline void PixBufMarkDirty(PixBufT *pixbuf,
+                                   int x, int y, int w, int h) {
+  if (PixBufTracksDirty(pixbuf))
+    PixBufMarkDirtyRect(pixbuf, x, y, w, h);
+}
+
+static inline void PixBufMarkAllDirty(PixBufT *pixbuf) {
+  if (PixBufTracksDirty(pixbuf))
+    PixBufMarkDirtyRect(pixbuf, 0, 0, pixbuf->width, pixbuf->height);
+}
+
+/*
+ * Use instead of PixBufClear, if little is drawn each frame.  Blocks drawn
+ * since previous call are copied from background, or filled with bgColor if
+ * it's NULL.  Other blocks are left intact and won't need c2p.
+ */
+void PixBufEraseDirty(PixBufT *pixbuf, PixBufT *background);
 
 void PixBufSwapData(PixBufT *buf1, PixBufT *buf2);
 void PixBufCopy(PixBufT *dst, PixBufT *src);
 void PixBufClear(PixBufT *pixbuf);
+/* Call again if contents of the color map were changed in place. */
 void PixBufSetColorMap(PixBufT *pixbuf, PixBufT *colorMap);
 void PixBufSetColorFunc(PixBufT *pixbuf, uint8_t *colorFunc);
 BlitModeT PixBufSetBlitMode(PixBufT *pixbuf, BlitModeT mode);
 void PixBufRemap(PixBufT *pixbuf, PaletteT *palette);
 void PixBufCalculateHistogram(PixBufT *pixbuf);
+/* Writes 8-bit image in format read by NewPixBufFromFile. */
+void PixBufWriteToFile(PixBufT *pixbuf, const char *fileName);
 
 static inline void PutPixel(PixBufT *pixbuf, int x, int y, uint8_t c) {
-  pixbuf->data[x + pixbuf->width * y] = c;
+  pixbuf->data[x + pixbuf->stride * y] = c;
 }
 
 static inline uint8_t GetPixel(PixBufT *pixbuf, int x, int y) {
-  return pixbuf->data[x + pixbuf->width * y];
+  return pixbuf->data[x + pixbuf->stride * y];
 }
 
 static inline void PutPixelRGB(PixBufT *pixbuf, int x, int y, RGB c) {
-  ((uint32_t *)pixbuf->data)[x + pixbuf->width * y] = *(uint32_t *)&c;
+  ((uint32_t *)pixbuf->data)[x + pixbuf->stride * y] = *(uint32_t *)&c;
 }
 
 static inline RGB GetPixelRGB(PixBufT *pixbuf, int x, int y) {
-  return *(RGB *)&pixbuf->data[x + pixbuf->width * y];
+  return *(RGB *)&pixbuf->data[x + pixbuf->stride * y];
 }
 
 __regargs int GetFilteredPixel(PixBufT *pixbuf, FP16 x, FP16 y);
@@ -1,134 +1,300 @@
-#include "std/array.h"
-#include "std/memory.h"
+#include <string.h>
 
-#include "gfx/colors.h"
+#include "std/debug.h"
+#include "std/memory.h"
 #include "gfx/quantize.h"
 
-typedef struct Color {
-  int r, g, b;
-} ColorT;
+/* Pixels with the same 15-bit color. */
+typedef struct Bucket {
+  uint32_t count;
+  /* sums of components */
+  uint32_t r, g, b;
+} BucketT;
+
+/* Range of buckets that will be represented by a single color. */
+typedef struct Box {
+  size_t begin, end;
+  RGB color;
+  int axis;
+  /* mean and sum of squared distances from it along the axis */
+  float mean;
+  float weight;
+} BoxT;
+
+static inline float BucketComponent(BucketT *bucket, int axis) {
+  uint32_t sum = (axis == 0) ? bucket->r : (axis == 1) ? bucket->g : bucket->b;
+
+  return (float)sum / bucket->count;
+}
+
+static inline size_t Bucket15(RGB *color) {
+  return ((color->r >> 3) << 10) | ((color->g >> 3) << 5) | (color->b >> 3);
+}
+
+static void AddImage(BucketT *histogram, PixBufT *image) {
+  size_t x, y;
+
+  ASSERT(image->type == PIXBUF_RGB || image->type == PIXBUF_RGBA,
+         "Cannot quantize %d-bit image.", (image->type >= PIXBUF_RGB) ? 24 : 8);
+
+  for (y = 0; y < image->height; y++) {
+    for (x = 0; x < image->width; x++) {
+      RGB color;
+      BucketT *bucket;
+
+      if (image->type == PIXBUF_RGBA) {
+        RGBA *pixel = (RGBA *)image->data + y * image->stride + x;
 
-static size_t ColorFindMaxComponent(ColorT *color, int *value) {
-  int v = color->r;
-  int i = 0;
+        if (pixel->a < 128)
+          continue;
 
-  if (v < color->g) {
-    v = color->g;
-    i = 1;
+        color = MakeRGB(pixel->r, pixel->g, pixel->b);
+      } else {
+        color = ((RGB *)image->data)[y * image->stride + x];
+      }
+
+      bucket = &histogram[Bucket15(&color)];
+      bucket->count++;
+      bucket->r += color.r;
+      bucket->g += color.g;
+      bucket->b += color.b;
+    }
   }
+}
 
-  if (v < color->b) {
-    v = color->b;
-    i = 2;
+/* Finds mean color and the axis with greatest spread. */
+static void BoxUpdate(BoxT *box, BucketT *bucket) {
+  float sum[3] = { 0.0f, 0.0f, 0.0f };
+  float error[3] = { 0.0f, 0.0f, 0.0f };
+  float mean[3];
+  uint32_t count = 0;
+  size_t i;
+  int axis;
+
+  for (i = box->begin; i < box->end; i++) {
+    count += bucket[i].count;
+    sum[0] += bucket[i].r;
+    sum[1] += bucket[i].g;
+    sum[2] += bucket[i].b;
   }
 
-  *value = v;
+  for (axis = 0; axis < 3; axis++)
+    mean[axis] = sum[axis] / count;
 
-  return i;
+  for (i = box->begin; i < box->end; i++) {
+    for (axis = 0; axis < 3; axis++) {
+      float d = BucketComponent(&bucket[i], axis) - mean[axis];
+
+      error[axis] += d * d * bucket[i].count;
+    }
+  }
+
+  box->color = MakeRGB(mean[0] + 0.5f, mean[1] + 0.5f, mean[2] + 0.5f);
+  box->axis = (error[0] >= error[1]) ? 0 : 1;
+  if (error[2] > error[box->axis])
+    box->axis = 2;
+  box->mean = mean[box->axis];
+  box->weight = error[box->axis];
 }
 
-typedef struct ColorBox {
-  ArrayT *colors;
+/* Moves buckets below (or equal to) the value to the front of the range. */
+static size_t Partition(BucketT *bucket, size_t i, size_t j, int axis,
+                        float value, bool inclusive)
+{
+  while (i < j) {
+    float c = BucketComponent(&bucket[i], axis);
+
+    if (c < value || (inclusive && c == value)) {
+      i++;
+    } else {
+      BucketT tmp = bucket[i];
+
+      bucket[i] = bucket[--j];
+      bucket[j] = tmp;
+    }
+  }
 
-  size_t begin;
-  size_t end;
-  size_t count;
+  return i;
+}
 
-  ColorT average;
-  ColorT color;
-  ColorT variance;
+/*
+ * Since the weight is positive, there are buckets on both sides of the mean,
+ * unless it was rounded to the lowest value.
+ */
+static void BoxSplit(BoxT *box, BoxT *other, BucketT *bucket) {
+  size_t i = Partition(bucket, box->begin, box->end, box->axis, box->mean,
+                       false);
 
-  size_t axis;
-  int weight;
-} ColorBoxT;
+  if (i == box->begin)
+    i = Partition(bucket, box->begin, box->end, box->axis, box->mean, true);
 
-static void ColorBoxCalcAverage(ColorBoxT *box);
-static void ColorBoxCalcVariance(ColorBoxT *box);
+  other->begin = i;
+  other->end = box->end;
+  box->end = i;
 
-ColorBoxT *NewColorBox(ArrayT *colors, size_t begin, size_t end, ColorT *average) {
-  ColorBoxT *box = NewRecord(ColorBoxT);
+  BoxUpdate(box, bucket);
+  BoxUpdate(other, bucket);
+}
+
+static inline int Luma(RGB *color) {
+  return 299 * color->r + 587 * color->g + 114 * color->b;
+}
 
-  box->colors = colors;
-  box->begin  = begin;
-  box->end    = end;
+PaletteT *QuantizePalette(PixBufT **images, size_t num, size_t colors) {
+  BucketT *bucket = NewTable(BucketT, 32768);
+  BoxT *box = NewTable(BoxT, colors);
+  PaletteT *palette;
+  bool transparent = false;
+  size_t i, j, n = 0, boxes = 1;
 
-  if (average) {
-    box->average = *average;
-  } else {
-    ColorBoxCalcAverage(box);
+  for (i = 0; i < num; i++) {
+    AddImage(bucket, images[i]);
+    transparent |= (images[i]->type == PIXBUF_RGBA);
   }
-    
-  box->count = end - begin + 1;
 
-  box->color.r = box->average.r / box->count;
-  box->color.g = box->average.g / box->count;
-  box->color.b = box->average.b / box->count;
+  if (transparent)
+    colors--;
 
-  ColorBoxCalcVariance(box);
+  /* Only non-empty buckets are split. */
+  for (i = 0; i < 32768; i++)
+    if (bucket[i].count)
+      bucket[n++] = bucket[i];
 
-  box->axis = ColorFindMaxComponent(&box->variance, &box->weight);
+  ASSERT(n > 0, "No opaque pixels to quantize.");
 
-  return box;
-}
+  box[0].begin = 0;
+  box[0].end = n;
+  BoxUpdate(&box[0], bucket);
 
-static void ColorBoxCalcAverage(ColorBoxT *box) {
-  void Add(RGB *color) {
-    box->average.r += (int)color->r;
-    box->average.g += (int)color->b;
-    box->average.b += (int)color->b;
-  }
+  while (boxes < colors) {
+    BoxT *widest = &box[0];
 
-  ArrayForEachInRange(box->colors, box->begin, box->end, (IterFuncT)Add, NULL);
-}
+    for (i = 1; i < boxes; i++)
+      if (box[i].weight > widest->weight)
+        widest = &box[i];
+
+    /* All boxes have a single color. */
+    if (widest->weight <= 0.0f)
+      break;
 
-static void ColorBoxCalcVariance(ColorBoxT *box) {
-  void AddSqrDiff(RGB *color) {
-    ColorT diff = {
-      (int)color->r - box->color.r,
-      (int)color->g - box->color.g,
-      (int)color->b - box->color.b
-    };
-
-    box->variance.r += diff.r * diff.r;
-    box->variance.g += diff.g * diff.g;
-    box->variance.b += diff.b * diff.b;
+    BoxSplit(widest, &box[boxes++], bucket);
   }
 
-  ArrayForEachInRange(box->colors, box->begin, box->end, (IterFuncT)AddSqrDiff, NULL);
-}
+  LOG("Split %d colors into %d boxes.", (int)n, (int)boxes);
 
-void ColorBoxSplit(ColorBoxT *box, ColorBoxT **leftBoxPtr, ColorBoxT **rightBoxPtr) {
-  size_t axis = box->axis;
-  size_t i;
+  palette = NewPalette(boxes);
+  palette->start = transparent ? 1 : 0;
 
-  int median = ((int *)&box->color)[axis];
+  /* Insertion sort by luminance. */
+  for (i = 0; i < boxes; i++) {
+    RGB color = box[i].color;
 
-  CmpT CompareColor(RGB *color) {
-    uint8_t c = ((uint8_t *)color)[axis];
+    for (j = i; j > 0 && Luma(&palette->colors[j - 1]) > Luma(&color); j--)
+      palette->colors[j] = palette->colors[j - 1];
 
-    if (c < median)
-      return CMP_LT;
-    else if (c > median)
-      return CMP_GT;
-    else
-      return CMP_EQ;
+    palette->colors[j] = color;
   }
 
-  i = ArrayPartition(box->colors, box->begin, box->end, NULL);
+  MemUnref(box);
+  MemUnref(bucket);
 
-  {
-    ColorBoxT *leftBox = NewColorBox(box->colors, box->begin, i, NULL);
-    ColorBoxT *rightBox;
-
-    ColorT rightAverage = {
-      box->average.r - leftBox->average.r,
-      box->average.g - leftBox->average.b,
-      box->average.b - leftBox->average.b
-    };
+  return palette;
+}
 
-    rightBox = NewColorBox(box->colors, i + 1, box->end, &rightAverage);
+static inline uint8_t Clamp(int v) {
+  return (v < 0) ? 0 : ((v > 255) ? 255 : v);
+}
 
-    *leftBoxPtr = leftBox;
-    *rightBoxPtr = rightBox;
+static const int8_t Bayer4x4[4][4] = {
+  {  0,  8,  2, 10 },
+  { 12,  4, 14,  6 },
+  {  3, 11,  1,  9 },
+  { 15,  7, 13,  5 }
+};
+
+PixBufT *QuantizeImage(PixBufT *image, PaletteT *palette, DitherT dither) {
+  PixBufT *output = NewPixBuf(PIXBUF_CLUT, image->width, image->height);
+  /* Floyd-Steinberg errors for current and next row, with a margin. */
+  int16_t *error = NewTable(int16_t, (image->width + 2) * 3 * 2);
+  int16_t *cur = error + 3;
+  int16_t *next = error + 3 + (image->width + 2) * 3;
+  size_t x, y;
+
+  ASSERT(image->type == PIXBUF_RGB || image->type == PIXBUF_RGBA,
+         "Cannot quantize %d-bit image.", (image->type >= PIXBUF_RGB) ? 24 : 8);
+
+  for (y = 0; y < image->height; y++) {
+    uint8_t *dst = output->data + y * output->stride;
+
+    for (x = 0; x < image->width; x++) {
+      int r, g, b, index;
+      RGB *chosen;
+
+      if (image->type == PIXBUF_RGBA) {
+        RGBA *pixel = (RGBA *)image->data + y * image->stride + x;
+
+        if (pixel->a < 128) {
+          dst[x] = 0;
+          continue;
+        }
+
+        r = pixel->r; g = pixel->g; b = pixel->b;
+      } else {
+        RGB *pixel = (RGB *)image->data + y * image->stride + x;
+
+        r = pixel->r; g = pixel->g; b = pixel->b;
+      }
+
+      if (dither == DITHER_ORDERED) {
+        /* Amplitude of about one step of the inverse color map. */
+        int d = Bayer4x4[y & 3][x & 3] - 8;
+
+        r += d; g += d; b += d;
+      } else if (dither == DITHER_FLOYD_STEINBERG) {
+        r += cur[x * 3 + 0] / 16;
+        g += cur[x * 3 + 1] / 16;
+        b += cur[x * 3 + 2] / 16;
+      }
+
+      r = Clamp(r); g = Clamp(g); b = Clamp(b);
+
+      index = PaletteFindNearest(palette, MakeRGB(r, g, b));
+      dst[x] = index;
+
+      if (dither == DITHER_FLOYD_STEINBERG) {
+        int16_t *e = &next[x * 3];
+        int c;
+
+        chosen = PaletteGetColor(palette, index);
+
+        r -= chosen->r;
+        g -= chosen->g;
+        b -= chosen->b;
+
+        /* 7/16 to the right, 3/16, 5/16 and 1/16 to the row below. */
+        for (c = 0; c < 3; c++) {
+          int v = (c == 0) ? r : (c == 1) ? g : b;
+
+          cur[x * 3 + 3 + c] += v * 7;
+          e[c - 3] += v * 3;
+          e[c] += v * 5;
+          e[c + 3] += v;
+        }
+      }
+    }
+
+    if (dither == DITHER_FLOYD_STEINBERG) {
+      int16_t *tmp = cur;
+
+      cur = next;
+      next = tmp;
+      memset(next - 3, 0, sizeof(int16_t) * (image->width + 2) * 3);
+    }
   }
+
+  MemUnref(error);
+
+  PixBufCalculateHistogram(output);
+
+  return output;
 }
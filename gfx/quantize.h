@@ -1,4 +1,28 @@
 #ifndef __GFX_QUANTIZE_H__
 #define __GFX_QUANTIZE_H__
 
+#include "gfx/palette.h"
+#include "gfx/pixbuf.h"
+
+typedef enum {
+  DITHER_NONE,
+  DITHER_ORDERED,
+  DITHER_FLOYD_STEINBERG
+} DitherT;
+
+/*
+ * Median-cut quantization of colors found in RGB or RGBA images, so that a
+ * few images can share a palette.  Pixels are counted in 15-bit buckets
+ * first, hence time spent on splitting doesn't depend on image size.  Colors
+ * are sorted by luminance.  If any image has alpha channel, color 0 is left
+ * for transparent pixels and the palette starts at 1.
+ */
+PaletteT *QuantizePalette(PixBufT **images, size_t num, size_t colors);
+
+/*
+ * Converts an RGB or RGBA image to CLUT one.  Pixels with alpha below 128
+ * become color 0.
+ */
+PixBufT *QuantizeImage(PixBufT *image, PaletteT *palette, DitherT dither);
+
 #endif
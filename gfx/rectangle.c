@@ -1,8 +1,12 @@
 #include "gfx/rectangle.h"
 
 void DrawRectangle(PixBufT *canvas,
-                   int x, int y, unsigned int w, unsigned int h)
+                   int x, int y, unsigned int width, unsigned int height)
 {
+  /* signed, so that rectangles off the left or top edge are rejected */
+  int w = width;
+  int h = height;
+
   /* clipping */
   if (x < 0) {
     w += x;
@@ -14,18 +18,20 @@ void DrawRectangle(PixBufT *canvas,
     y = 0;
   }
 
-  if (x + w > canvas->width)
+  if (x + w > (int)canvas->width)
     w = canvas->width - x;
 
-  if (y + h > canvas->height)
+  if (y + h > (int)canvas->height)
     h = canvas->height - y;
 
   /* drawing */
   if (w > 0 && h > 0) {
-    uint32_t dstride = canvas->width - w;
-    uint8_t *dst = &canvas->data[y * canvas->width + x];
+    uint32_t dstride = canvas->stride - w;
+    uint8_t *dst = &canvas->data[y * canvas->stride + x];
     uint8_t c = canvas->fgColor;
 
+    PixBufMarkDirty(canvas, x, y, w, h);
+
     do {
       int n = w;
 
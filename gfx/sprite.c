@@ -0,0 +1,259 @@
+#include <string.h>
+
+#include "std/debug.h"
+#include "std/memory.h"
+#include "gfx/blitops.h"
+#include "gfx/raw.h"
+#include "gfx/sprite.h"
+
+static void DeleteSpriteBatch(SpriteBatchT *self) {
+  MemUnref(self->sprite);
+  MemUnref(self->first);
+  MemUnref(self->index);
+}
+
+TYPEDECL(SpriteBatchT, (FreeFuncT)DeleteSpriteBatch);
+
+SpriteBatchT *NewSpriteBatch(size_t width, size_t height, size_t maxSprites) {
+  SpriteBatchT *self = NewInstance(SpriteBatchT);
+
+  self->width = width;
+  self->height = height;
+  self->bands = (height + SPRITE_BAND - 1) / SPRITE_BAND;
+  self->sprite = NewTable(BatchSpriteT, maxSprites);
+  self->first = NewTable(uint32_t, self->bands + 1);
+  self->index = NewTable(uint16_t, maxSprites);
+
+  return self;
+}
+
+void SpriteBatchSetImage(SpriteBatchT *self, size_t id, PixBufT *image) {
+  ASSERT(id < SPRITE_MAX_IMAGES, "Image id %d out of range.", (int)id);
+
+  self->image[id] = image;
+}
+
+void SpriteBatchReset(SpriteBatchT *self) {
+  self->spriteNum = 0;
+}
+
+void SpriteBatchAdd(SpriteBatchT *self, PointT *position, uint8_t *image,
+                    uint8_t *mode, size_t n)
+{
+  const int width = self->width;
+  const int height = self->height;
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    PixBufT *img = self->image[image[i]];
+    int w = img->width;
+    int h = img->height;
+    int x = position[i].x - w / 2;
+    int y = position[i].y - h / 2;
+    int sx = 0, sy = 0;
+    BatchSpriteT *sprite;
+
+    if (x < 0) {
+      w += x; sx -= x; x = 0;
+    }
+
+    if (y < 0) {
+      h += y; sy -= y; y = 0;
+    }
+
+    if (x + w > width)
+      w = width - x;
+
+    if (y + h > height)
+      h = height - y;
+
+    if (w <= 0 || h <= 0)
+      continue;
+
+    if (self->spriteNum == TableSize(self->sprite)) {
+      size_t size = max(self->spriteNum * 2, 16);
+
+      ASSERT(size <= 65536, "Too many sprites in batch.");
+
+      self->sprite = TableResize(self->sprite, size);
+    }
+
+    sprite = &self->sprite[self->spriteNum++];
+    sprite->src = &img->data[sy * img->stride + sx];
+    sprite->x = x;
+    sprite->y = y;
+    sprite->w = w;
+    sprite->h = h;
+    sprite->image = image[i];
+    sprite->mode = mode ? mode[i] : img->mode;
+  }
+}
+
+/*
+ * Counting sort of sprites by band.  A sprite spanning a few bands is put
+ * into each of them.  Order of sprites within a band is preserved.
+ */
+static void BinSprites(SpriteBatchT *self) {
+  uint32_t *first = self->first;
+  size_t i, total = 0;
+
+  memset(first, 0, sizeof(uint32_t) * (self->bands + 1));
+
+  for (i = 0; i < self->spriteNum; i++) {
+    BatchSpriteT *sprite = &self->sprite[i];
+    int b = sprite->y / SPRITE_BAND;
+    int e = (sprite->y + sprite->h - 1) / SPRITE_BAND;
+
+    for (; b <= e; b++)
+      first[b + 1]++;
+  }
+
+  for (i = 1; i <= self->bands; i++) {
+    total += first[i];
+    first[i] = total;
+  }
+
+  if (TableSize(self->index) < total)
+    self->index = TableResize(self->index, total);
+
+  for (i = 0; i < self->spriteNum; i++) {
+    BatchSpriteT *sprite = &self->sprite[i];
+    int b = sprite->y / SPRITE_BAND;
+    int e = (sprite->y + sprite->h - 1) / SPRITE_BAND;
+
+    for (; b <= e; b++)
+      self->index[first[b]++] = i;
+  }
+
+  memmove(first + 1, first, sizeof(uint32_t) * self->bands);
+  first[0] = 0;
+}
+
+typedef struct Piece {
+  uint8_t *dst, *src;
+  int w, h;
+  int sstride, dstride;
+  PixBufT *image;
+} PieceT;
+
+/* Part of a sprite that falls into rows [top, bottom). */
+static inline void GetPiece(SpriteBatchT *self, PixBufT *canvas, size_t i,
+                            int top, int bottom, PieceT *piece)
+{
+  BatchSpriteT *sprite = &self->sprite[i];
+  PixBufT *image = self->image[sprite->image];
+  int ys = max(sprite->y, top);
+  int ye = min(sprite->y + sprite->h, bottom);
+
+  piece->src = sprite->src + (ys - sprite->y) * image->stride;
+  piece->dst = &canvas->data[ys * canvas->stride + sprite->x];
+  piece->w = sprite->w;
+  piece->h = ye - ys;
+  piece->sstride = image->stride - sprite->w;
+  piece->dstride = canvas->stride - sprite->w;
+  piece->image = image;
+}
+
+/* Sprites index[0] .. index[n-1] share the blit mode. */
+static void RenderRun(SpriteBatchT *self, PixBufT *canvas,
+                      uint16_t *index, size_t n, int top, int bottom)
+{
+  PieceT p;
+  size_t i;
+
+  switch (self->sprite[index[0]].mode) {
+    case BLIT_NORMAL:
+      for (i = 0; i < n; i++) {
+        GetPiece(self, canvas, index[i], top, bottom, &p);
+        RawBlitNormal(p.dst, p.src, p.w, p.h, p.sstride, p.dstride);
+      }
+      break;
+
+    case BLIT_TRANSPARENT:
+      for (i = 0; i < n; i++) {
+        GetPiece(self, canvas, index[i], top, bottom, &p);
+        RawBlitTransparent(p.dst, p.src, p.w, p.h, p.sstride, p.dstride);
+      }
+      break;
+
+    case BLIT_ADDITIVE:
+      for (i = 0; i < n; i++) {
+        GetPiece(self, canvas, index[i], top, bottom, &p);
+        BlitAdditive(p.dst, p.src, p.w, p.h, p.sstride, p.dstride);
+      }
+      break;
+
+    case BLIT_ADDITIVE_CLIP:
+      for (i = 0; i < n; i++) {
+        GetPiece(self, canvas, index[i], top, bottom, &p);
+        BlitAdditiveClip(p.dst, p.src, p.w, p.h, p.sstride, p.dstride);
+      }
+      break;
+
+    case BLIT_SUBSTRACTIVE:
+      for (i = 0; i < n; i++) {
+        GetPiece(self, canvas, index[i], top, bottom, &p);
+        BlitSubstractive(p.dst, p.src, p.w, p.h, p.sstride, p.dstride);
+      }
+      break;
+
+    case BLIT_SUBSTRACTIVE_CLIP:
+      for (i = 0; i < n; i++) {
+        GetPiece(self, canvas, index[i], top, bottom, &p);
+        BlitSubstractiveClip(p.dst, p.src, p.w, p.h, p.sstride, p.dstride);
+      }
+      break;
+
+    case BLIT_COLOR_MAP:
+      for (i = 0; i < n; i++) {
+        GetPiece(self, canvas, index[i], top, bottom, &p);
+        RawBlitColorMap(p.dst, p.src, p.w, p.h, p.sstride, p.dstride,
+                        p.image->blit.cmap);
+      }
+      break;
+
+    case BLIT_COLOR_FUNC:
+      for (i = 0; i < n; i++) {
+        GetPiece(self, canvas, index[i], top, bottom, &p);
+        RawBlitColorFunc(p.dst, p.src, p.w, p.h, p.sstride, p.dstride,
+                         p.image->blit.cfunc);
+      }
+      break;
+  }
+}
+
+void SpriteBatchRender(SpriteBatchT *self, PixBufT *canvas) {
+  size_t b;
+
+  ASSERT(canvas->width == self->width && canvas->height == self->height,
+         "Canvas size doesn't match the batch.");
+
+  if (PixBufTracksDirty(canvas)) {
+    for (b = 0; b < self->spriteNum; b++) {
+      BatchSpriteT *sprite = &self->sprite[b];
+
+      PixBufMarkDirtyRect(canvas, sprite->x, sprite->y, sprite->w, sprite->h);
+    }
+  }
+
+  BinSprites(self);
+
+  for (b = 0; b < self->bands; b++) {
+    int top = b * SPRITE_BAND;
+    int bottom = min(top + SPRITE_BAND, (int)self->height);
+    size_t k = self->first[b];
+    size_t end = self->first[b + 1];
+
+    while (k < end) {
+      uint8_t mode = self->sprite[self->index[k]].mode;
+      size_t run = k + 1;
+
+      while (run < end && self->sprite[self->index[run]].mode == mode)
+        run++;
+
+      RenderRun(self, canvas, &self->index[k], run - k, top, bottom);
+
+      k = run;
+    }
+  }
+}
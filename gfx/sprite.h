@@ -0,0 +1,55 @@
+#ifndef __GFX_SPRITE_H__
+#define __GFX_SPRITE_H__
+
+#include "gfx/common.h"
+#include "gfx/pixbuf.h"
+
+#define SPRITE_MAX_IMAGES 16
+#define SPRITE_BAND       16
+
+typedef struct BatchSprite {
+  /* first visible pixel of the image */
+  uint8_t *src;
+  /* visible part of the sprite in canvas coordinates */
+  int16_t x, y, w, h;
+  uint8_t image;
+  uint8_t mode;
+} BatchSpriteT;
+
+/*
+ * Sprites are clipped as they're added, then binned into bands of
+ * SPRITE_BAND rows.  Rendering goes band by band, so the piece of canvas
+ * being written stays in data cache, and blit mode is dispatched once per
+ * run of sprites using the same mode.  Sprites are drawn in the order they
+ * were added, hence the result is the same as with PixBufBlit.
+ */
+typedef struct SpriteBatch {
+  size_t width, height;
+  size_t bands;
+
+  PixBufT *image[SPRITE_MAX_IMAGES];
+
+  BatchSpriteT *sprite;
+  size_t spriteNum;
+
+  /* sprites binned into band i are index[first[i]] .. index[first[i+1]-1] */
+  uint32_t *first;
+  uint16_t *index;
+} SpriteBatchT;
+
+SpriteBatchT *NewSpriteBatch(size_t width, size_t height, size_t maxSprites);
+
+/* Images are not owned by the batch. */
+void SpriteBatchSetImage(SpriteBatchT *self, size_t id, PixBufT *image);
+
+/*
+ * Adds n sprites centered at given positions.  If mode is NULL, then blit
+ * mode of the image is used.
+ */
+void SpriteBatchAdd(SpriteBatchT *self, PointT *position, uint8_t *image,
+                    uint8_t *mode, size_t n);
+
+void SpriteBatchRender(SpriteBatchT *self, PixBufT *canvas);
+void SpriteBatchReset(SpriteBatchT *self);
+
+#endif
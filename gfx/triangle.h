@@ -7,6 +7,21 @@ typedef struct {
   float x, y;
 } TriPoint;
 
+/* Bounding box has a margin, since rounding differs per rasterizer. */
+static inline void MarkTriangleDirty(PixBufT *canvas, float x1, float y1,
+                                     float x2, float y2, float x3, float y3)
+{
+  if (PixBufTracksDirty(canvas)) {
+    float xmin = min(x1, min(x2, x3));
+    float xmax = max(x1, max(x2, x3));
+    float ymin = min(y1, min(y2, y3));
+    float ymax = max(y1, max(y2, y3));
+
+    PixBufMarkDirtyRect(canvas, (int)xmin - 1, (int)ymin - 1,
+                        (int)(xmax - xmin) + 3, (int)(ymax - ymin) + 3);
+  }
+}
+
 void DrawTriangle(PixBufT *canvas,
                   TriPoint *p1, TriPoint *p2, TriPoint *p3);
 
@@ -17,5 +32,19 @@ typedef struct {
 
 void DrawTriangleC(PixBufT *canvas,
                    TriPointC *p1, TriPointC *p2, TriPointC *p3);
+/* Original floating point version, kept for comparison. */
+void DrawTriangleCF(PixBufT *canvas,
+                    TriPointC *p1, TriPointC *p2, TriPointC *p3);
+
+/* z is an inverse depth, (u, v) are texture coordinates in texels. */
+typedef struct {
+  float x, y;
+  float z;
+  float u, v;
+} TriPointUV;
+
+/* Shade is a color map column, see triangle_uv.c. */
+void DrawTriangleUV(PixBufT *canvas, PixBufT *texture,
+                    TriPointUV *p1, TriPointUV *p2, TriPointUV *p3, int shade);
 
 #endif
@@ -6,6 +6,11 @@
 #include "std/debug.h"
 #include "std/math.h"
 
+/*
+ * Original floating point Gouraud filler, kept as a reference for
+ * DrawTriangleC.  Each span interpolates between colors of its edges.
+ */
+
 /* EdgeScan structure & routines. */
 
 typedef struct EdgeScan {
@@ -58,16 +63,14 @@ static inline bool CmpEdgeScan(EdgeScanT *e1, EdgeScanT *e2) {
 }
 
 /* Segment routines. */
-static inline void 
-DrawTriangleSpan(uint8_t *pixels, int xs, int xe, float cs, float ce, int y)
+static inline void
+DrawTriangleSpan(uint8_t *pixels, int xs, int xe, float cs, float ce)
 {
   float dc = 0.0f;
   int n = xe - xs;
 
   pixels += xs;
 
-  LOG("Line: (%d, %d..%d)", y, xs, xe);
-
   if (n > 0)
     dc = (ce - cs) / n;
 
@@ -81,15 +84,15 @@ __attribute__((regparm(4))) static void
 DrawTriangleSegment(PixBufT *canvas, EdgeScanT *left, EdgeScanT *right,
                     int ys, int h)
 {
-  uint8_t *pixels = canvas->data + ys * canvas->width;
-  int width = canvas->width;
+  uint8_t *pixels = canvas->data + ys * canvas->stride;
+  int stride = canvas->stride;
   int ye = ys + h;
 
   for (; ys < ye; ys++) {
     DrawTriangleSpan(pixels, lroundf(left->x), lroundf(right->x),
-                     left->c, right->c, ys);
+                     left->c, right->c);
 
-    pixels += width;
+    pixels += stride;
 
     IterEdgeScan(left);
     IterEdgeScan(right);
@@ -97,12 +100,14 @@ DrawTriangleSegment(PixBufT *canvas, EdgeScanT *left, EdgeScanT *right,
 }
 
 /* Triangle rasterization routine. */
-void DrawTriangleC(PixBufT *canvas,
-                   TriPointC *p1, TriPointC *p2, TriPointC *p3)
+void DrawTriangleCF(PixBufT *canvas,
+                    TriPointC *p1, TriPointC *p2, TriPointC *p3)
 {
   EdgeScanT l12, l13, l23;
   bool longOnRight;
 
+  MarkTriangleDirty(canvas, p1->x, p1->y, p2->x, p2->y, p3->x, p3->y);
+
   if (p1->y > p2->y)
     swapr(p1, p2);
 
@@ -112,9 +117,6 @@ void DrawTriangleC(PixBufT *canvas,
   if (p2->y > p3->y)
     swapr(p2, p3);
 
-  LOG("Triangle: (%f, %f) (%f, %f) (%f, %f).",
-      p1->x, p1->y, p2->x, p2->y, p3->x, p3->y);
-
   InitEdgeScan(&l12, p1, p2);
   InitEdgeScan(&l13, p1, p3);
   InitEdgeScan(&l23, p2, p3);
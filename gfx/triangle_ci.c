@@ -0,0 +1,224 @@
+#ifndef NDEBUG
+#define NDEBUG
+#endif
+
+#include "gfx/triangle.h"
+#include "std/debug.h"
+#include "std/math.h"
+
+/*
+ * Gouraud shaded triangle rasterizer.  Setup is done with floats, but edges
+ * and spans are walked in 16.16 fixed point.  Color gradient along x axis is
+ * constant for the whole triangle, so spans don't need any divisions.
+ */
+
+typedef int32_t fixed_t;
+
+static inline fixed_t float_to_fx(float v) {
+  return (fixed_t)(v * 65536.0f);
+}
+
+static inline int fx_rint(fixed_t v) {
+  return (v + 0x8000) >> 16;
+}
+
+/*
+ * Pixel rows are sampled at their centers, so a row is the first one whose
+ * center (y + 0.5) is not above y.  Unlike lroundf this is also right for y
+ * exactly halfway between rows.
+ */
+static inline int y_to_row(float y) {
+  return (int)ceil(y - 0.5f);
+}
+
+#define FX_ONE  0x10000
+#define FX_MAXC (255 * FX_ONE + 0xffff)
+
+/* EdgeScan structure & routines. */
+
+typedef struct EdgeScan {
+  int height, width;
+  fixed_t x, dx;
+  fixed_t c, dc;
+} EdgeScanT;
+
+__regargs static void InitEdgeScan(EdgeScanT *e, TriPointC *ps, TriPointC *pe) {
+  float xs = ps->x;
+  float ys = ps->y;
+  float xe = pe->x;
+  float ye = pe->y;
+
+  float height = ye - ys;
+
+  e->height = y_to_row(ye) - y_to_row(ys);
+  e->width = lroundf(xe) - lroundf(xs);
+
+  if (height) {
+    float dx = (xe - xs) / height;
+    float dc = (pe->c - ps->c) / height;
+    float ys_centered = ys + 0.5f;
+    float ys_prestep = ceil(ys_centered) - ys_centered;
+
+    e->x = float_to_fx(xs + dx * ys_prestep);
+    e->c = float_to_fx(ps->c + dc * ys_prestep);
+    e->dx = float_to_fx(dx);
+    e->dc = float_to_fx(dc);
+  } else {
+    e->x = float_to_fx(xs);
+    e->c = float_to_fx(ps->c);
+    e->dx = 0;
+    e->dc = 0;
+  }
+}
+
+static inline void IterEdgeScan(EdgeScanT *e) {
+  e->x += e->dx;
+  e->c += e->dc;
+}
+
+static inline bool CmpEdgeScan(EdgeScanT *e1, EdgeScanT *e2) {
+  return e1->dx < e2->dx;
+}
+
+/*
+ * Color gradient along x axis is the same for each span of a triangle, so
+ * calculate it on the widest span, i.e. the one passing through the middle
+ * vertex.  Points must be sorted by y.  Slivers, where the widest span is
+ * narrower than a pixel, get no gradient.  Extrapolating a steep one half a
+ * pixel off the edge would give colors far outside those of the vertices.
+ */
+static fixed_t CalcColorGradient(TriPointC *p1, TriPointC *p2, TriPointC *p3) {
+  float height = p3->y - p1->y;
+
+  if (height > 0.0f) {
+    float t = (p2->y - p1->y) / height;
+    float width = p2->x - (p1->x + (p3->x - p1->x) * t);
+    float dc = p2->c - (p1->c + (p3->c - p1->c) * t);
+
+    if (fabsf(width) < 1.0f)
+      return 0;
+
+    return float_to_fx(dc / width);
+  }
+
+  return 0;
+}
+
+/* Segment routines. */
+__attribute__((regparm(4))) static void
+DrawTriangleSpan(uint8_t *pixels, int n, fixed_t c, fixed_t dc)
+{
+  /*
+   * Colors of pixels next to the edges are extrapolated and may leave [0, 255]
+   * range.  Such spans are rare, so clamp them per pixel in a slower loop.
+   * Changing the slope instead would shift colors of the whole span.
+   */
+  {
+    fixed_t ce = c + dc * (n - 1);
+
+    if (c < 0 || c > FX_MAXC || ce < 0 || ce > FX_MAXC) {
+      do {
+        *pixels++ = (c < 0) ? 0 : (min(c, FX_MAXC) >> 16);
+        c += dc;
+      } while (--n);
+      return;
+    }
+  }
+
+  switch (n & 3) {
+    case 3:
+      *pixels++ = c >> 16; c += dc;
+    case 2:
+      *pixels++ = c >> 16; c += dc;
+    case 1:
+      *pixels++ = c >> 16; c += dc;
+    default:
+      break;
+  }
+
+  n >>= 2;
+
+  while (--n >= 0) {
+    pixels[0] = c >> 16; c += dc;
+    pixels[1] = c >> 16; c += dc;
+    pixels[2] = c >> 16; c += dc;
+    pixels[3] = c >> 16; c += dc;
+    pixels += 4;
+  }
+}
+
+__attribute__((regparm(4))) static void
+DrawTriangleSegment(PixBufT *canvas, EdgeScanT *left, EdgeScanT *right,
+                    int ys, int h, const fixed_t dcdx)
+{
+  uint8_t *pixels = canvas->data + ys * canvas->stride;
+  int stride = canvas->stride;
+  int ye = ys + h;
+
+  for (; ys < ye; ys++) {
+    int xs = fx_rint(left->x);
+    int xe = fx_rint(right->x);
+
+    if (xs <= xe) {
+      /* Sub-pixel prestep (within [-0.5, 0.5]) from the edge to the pixel. */
+      fixed_t prestep = (xs << 16) - left->x;
+      fixed_t c = left->c + (((prestep >> 1) * (dcdx >> 8)) >> 7);
+
+      DrawTriangleSpan(pixels + xs, xe - xs + 1, c, dcdx);
+    }
+
+    pixels += stride;
+
+    IterEdgeScan(left);
+    IterEdgeScan(right);
+  }
+}
+
+/* Triangle rasterization routine. */
+void DrawTriangleC(PixBufT *canvas,
+                   TriPointC *p1, TriPointC *p2, TriPointC *p3)
+{
+  EdgeScanT l12, l13, l23;
+  fixed_t dcdx;
+  bool longOnRight;
+
+  MarkTriangleDirty(canvas, p1->x, p1->y, p2->x, p2->y, p3->x, p3->y);
+
+  if (p1->y > p2->y)
+    swapr(p1, p2);
+
+  if (p1->y > p3->y)
+    swapr(p1, p3);
+
+  if (p2->y > p3->y)
+    swapr(p2, p3);
+
+  InitEdgeScan(&l12, p1, p2);
+  InitEdgeScan(&l13, p1, p3);
+  InitEdgeScan(&l23, p2, p3);
+
+  dcdx = CalcColorGradient(p1, p2, p3);
+
+  if (l12.height == 0)
+    longOnRight = (l12.width < 0);
+  else if (l23.height == 0)
+    longOnRight = (l23.width > 0);
+  else
+    longOnRight = CmpEdgeScan(&l12, &l13);
+
+  {
+    EdgeScanT *left  = longOnRight ? &l12 : &l13;
+    EdgeScanT *right = longOnRight ? &l13 : &l12;
+
+    DrawTriangleSegment(canvas, left, right, y_to_row(p1->y), l12.height,
+                        dcdx);
+
+    if (longOnRight)
+      left = &l23;
+    else
+      right = &l23;
+
+    DrawTriangleSegment(canvas, left, right, y_to_row(p2->y), l23.height,
+                        dcdx);
+  }
+}
@@ -69,15 +69,15 @@ __attribute__((regparm(4))) static void
 DrawTriangleSegment(PixBufT *canvas, EdgeScanT *left, EdgeScanT *right,
                     int ys, int h)
 {
-  uint8_t *pixels = canvas->data + ys * canvas->width;
+  uint8_t *pixels = canvas->data + ys * canvas->stride;
   const uint8_t color = canvas->fgColor;
-  int width = canvas->width;
+  int stride = canvas->stride;
   int ye = ys + h;
 
   for (; ys < ye; ys++) {
     DrawTriangleSpan(pixels, color, lroundf(left->x), lroundf(right->x), ys);
 
-    pixels += width;
+    pixels += stride;
 
     IterEdgeScan(left);
     IterEdgeScan(right);
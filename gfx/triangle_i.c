@@ -161,9 +161,10 @@ __attribute__((regparm(4))) static void
 DrawTriangleSegment(PixBufT *canvas, EdgeScanT *left, EdgeScanT *right,
                     int ys, int h)
 {
-  uint8_t *pixels = canvas->data + ys * canvas->width;
+  uint8_t *pixels = canvas->data + ys * canvas->stride;
   const uint8_t color = canvas->fgColor;
   int width = canvas->width;
+  int stride = canvas->stride;
   int height = canvas->height;
   int ye = ys + h;
 
@@ -171,7 +172,7 @@ DrawTriangleSegment(PixBufT *canvas, EdgeScanT *left, EdgeScanT *right,
     if (ys >= 0 && ys < height && left->x < width && right->x >= 0)
       DrawTriangleSpan(pixels, color, left->x, right->x, width - 1);
 
-    pixels += width;
+    pixels += stride;
 
     IterEdgeScan(left);
     IterEdgeScan(right);
@@ -196,6 +197,8 @@ void DrawTriangle(PixBufT *canvas,
   _TriPoint *p2 = &points[1];
   _TriPoint *p3 = &points[2];
 
+  MarkTriangleDirty(canvas, p1f->x, p1f->y, p2f->x, p2f->y, p3f->x, p3f->y);
+
   if (p1->y > p2->y)
     swapr(p1, p2);
 
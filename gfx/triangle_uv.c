@@ -0,0 +1,311 @@
+#ifndef NDEBUG
+#define NDEBUG
+#endif
+
+#include "gfx/triangle.h"
+#include "std/debug.h"
+#include "std/math.h"
+
+/*
+ * Texture coordinates are interpolated affinely within subspans of
+ * (1 << SUBDIV_SHIFT) pixels.  Perspective correct values are calculated only
+ * at subspan boundaries.  Use 3 for 8-pixel subspans.
+ */
+#define SUBDIV_SHIFT 4
+#define SUBDIV (1 << SUBDIV_SHIFT)
+
+/* Values interpolated linearly in screen space. */
+typedef struct Gradients {
+  float z, u, v;
+} GradientsT;
+
+/* EdgeScan structure & routines. */
+
+typedef struct EdgeScan {
+  int height, width, y;
+  float x, dx;
+  float z, dz;
+  float u, du;
+  float v, dv;
+} EdgeScanT;
+
+__regargs static void InitEdgeScan(EdgeScanT *e, TriPointUV *ps, TriPointUV *pe) {
+  float xs = ps->x;
+  float ys = ps->y;
+  float xe = pe->x;
+  float ye = pe->y;
+
+  float height = ye - ys;
+  float width = xe - xs;
+
+  e->height = lroundf(ye) - lroundf(ys);
+  e->width = lroundf(xe) - lroundf(xs);
+
+  e->x = xs;
+  e->z = ps->z;
+  e->u = ps->u * ps->z;
+  e->v = ps->v * ps->z;
+  e->y = lroundf(ys);
+
+  if (height) {
+    float ys_centered = ys + 0.5f;
+    float ys_prestep = ceil(ys_centered) - ys_centered;
+
+    e->dx = width / height;
+    e->dz = (pe->z - ps->z) / height;
+    e->du = (pe->u * pe->z - ps->u * ps->z) / height;
+    e->dv = (pe->v * pe->z - ps->v * ps->z) / height;
+
+    e->x += e->dx * ys_prestep;
+    e->z += e->dz * ys_prestep;
+    e->u += e->du * ys_prestep;
+    e->v += e->dv * ys_prestep;
+  }
+}
+
+static inline void IterEdgeScan(EdgeScanT *e) {
+  e->x += e->dx;
+  e->z += e->dz;
+  e->u += e->du;
+  e->v += e->dv;
+  e->y++;
+}
+
+static inline bool CmpEdgeScan(EdgeScanT *e1, EdgeScanT *e2) {
+  return e1->dx < e2->dx;
+}
+
+/*
+ * Calculates constant gradients (along x axis) of values that are linear in
+ * screen space.  Returns false for degenerate triangles.
+ */
+static bool CalcGradients(GradientsT *d,
+                          TriPointUV *p1, TriPointUV *p2, TriPointUV *p3)
+{
+  float x1 = p2->x - p1->x;
+  float y1 = p2->y - p1->y;
+  float x2 = p3->x - p1->x;
+  float y2 = p3->y - p1->y;
+  float det = x1 * y2 - x2 * y1;
+
+  if (fabsf(det) < 1e-3f)
+    return false;
+
+  det = 1.0f / det;
+
+  {
+    float z1 = p2->z - p1->z;
+    float z2 = p3->z - p1->z;
+    float u1 = p2->u * p2->z - p1->u * p1->z;
+    float u2 = p3->u * p3->z - p1->u * p1->z;
+    float v1 = p2->v * p2->z - p1->v * p1->z;
+    float v2 = p3->v * p3->z - p1->v * p1->z;
+
+    d->z = (z1 * y2 - z2 * y1) * det;
+    d->u = (u1 * y2 - u2 * y1) * det;
+    d->v = (v1 * y2 - v2 * y1) * det;
+  }
+
+  return true;
+}
+
+/* Texture mapping state. */
+typedef struct TextureMapper {
+  uint8_t *texels;
+  uint8_t *cmap;
+  int shade;
+  int ushift;
+  int umask, vmask;
+  GradientsT d;
+} TextureMapperT;
+
+static inline int Log2(int n) {
+  int i = 0;
+
+  while ((1 << i) < n)
+    i++;
+
+  return i;
+}
+
+/* Segment routines. */
+__attribute__((regparm(4))) static void
+DrawTriangleSpan(TextureMapperT *tm, uint8_t *pixels, EdgeScanT *left,
+                 int xs, int xe)
+{
+  uint8_t *texels = tm->texels;
+  const uint8_t *cmap = tm->cmap;
+  const int shade = tm->shade;
+  const int ushift = tm->ushift;
+  const int umask = tm->umask;
+  const int vmask = tm->vmask;
+  const float dz = tm->d.z * SUBDIV;
+  const float du = tm->d.u * SUBDIV;
+  const float dv = tm->d.v * SUBDIV;
+
+  int n = xe - xs;
+  int32_t u0, v0;
+  float z, uz, vz;
+
+  /* Move to the center of the first pixel. */
+  {
+    float prestep = (float)xs + 0.5f - left->x;
+
+    z = left->z + tm->d.z * prestep;
+    uz = left->u + tm->d.u * prestep;
+    vz = left->v + tm->d.v * prestep;
+  }
+
+  {
+    float rz = 1.0f / z;
+
+    u0 = (int32_t)(uz * rz * 65536.0f);
+    v0 = (int32_t)(vz * rz * 65536.0f);
+  }
+
+  pixels += xs;
+
+  while (n > 0) {
+    int len = min(n, SUBDIV);
+    int32_t u1, v1, su, sv;
+
+    if (len == SUBDIV) {
+      z += dz;
+      uz += du;
+      vz += dv;
+    } else {
+      z += tm->d.z * len;
+      uz += tm->d.u * len;
+      vz += tm->d.v * len;
+    }
+
+    {
+      float rz = 1.0f / z;
+
+      u1 = (int32_t)(uz * rz * 65536.0f);
+      v1 = (int32_t)(vz * rz * 65536.0f);
+    }
+
+    if (len == SUBDIV) {
+      su = (u1 - u0) >> SUBDIV_SHIFT;
+      sv = (v1 - v0) >> SUBDIV_SHIFT;
+    } else {
+      su = (u1 - u0) / len;
+      sv = (v1 - v0) / len;
+    }
+
+    n -= len;
+
+    if (cmap) {
+      do {
+        int texel = texels[(((v0 >> 16) & vmask) << ushift) |
+                           ((u0 >> 16) & umask)];
+        *pixels++ = cmap[(texel << 8) | shade];
+        u0 += su;
+        v0 += sv;
+      } while (--len);
+    } else {
+      do {
+        *pixels++ = texels[(((v0 >> 16) & vmask) << ushift) |
+                           ((u0 >> 16) & umask)];
+        u0 += su;
+        v0 += sv;
+      } while (--len);
+    }
+
+    u0 = u1;
+    v0 = v1;
+  }
+}
+
+__attribute__((regparm(4))) static void
+DrawTriangleSegment(PixBufT *canvas, TextureMapperT *tm,
+                    EdgeScanT *left, EdgeScanT *right, int ys, int h)
+{
+  uint8_t *pixels = canvas->data + ys * canvas->stride;
+  int width = canvas->width;
+  int stride = canvas->stride;
+  int height = canvas->height;
+  int ye = ys + h;
+
+  for (; ys < ye; ys++) {
+    if (ys >= 0 && ys < height) {
+      int xs = lroundf(left->x);
+      int xe = lroundf(right->x);
+
+      if (xs < 0)
+        xs = 0;
+      if (xe > width)
+        xe = width;
+
+      if (xs < xe)
+        DrawTriangleSpan(tm, pixels, left, xs, xe);
+    }
+
+    pixels += stride;
+
+    IterEdgeScan(left);
+    IterEdgeScan(right);
+  }
+}
+
+/*
+ * Texture must have power of two dimensions and stride (so a view into an
+ * atlas works too), which is not checked here as this file is built without
+ * assertions.  If canvas has a color map set then each texel is shaded with
+ * cmap[(texel << 8) | shade], i.e. shade selects a column of the same color
+ * map layout that flat shading uses for surface colors.
+ */
+void DrawTriangleUV(PixBufT *canvas, PixBufT *texture,
+                   TriPointUV *p1, TriPointUV *p2, TriPointUV *p3, int shade)
+{
+  EdgeScanT l12, l13, l23;
+  TextureMapperT tm;
+  bool longOnRight;
+
+  if (!CalcGradients(&tm.d, p1, p2, p3))
+    return;
+
+  MarkTriangleDirty(canvas, p1->x, p1->y, p2->x, p2->y, p3->x, p3->y);
+
+  tm.texels = texture->data;
+  tm.cmap = canvas->blit.cmap;
+  tm.shade = (shade < 0) ? 0 : ((shade > 255) ? 255 : shade);
+  tm.ushift = Log2(texture->stride);
+  tm.umask = texture->width - 1;
+  tm.vmask = texture->height - 1;
+
+  if (p1->y > p2->y)
+    swapr(p1, p2);
+
+  if (p1->y > p3->y)
+    swapr(p1, p3);
+
+  if (p2->y > p3->y)
+    swapr(p2, p3);
+
+  InitEdgeScan(&l12, p1, p2);
+  InitEdgeScan(&l13, p1, p3);
+  InitEdgeScan(&l23, p2, p3);
+
+  if (l12.height == 0)
+    longOnRight = (l12.width < 0);
+  else if (l23.height == 0)
+    longOnRight = (l23.width > 0);
+  else
+    longOnRight = CmpEdgeScan(&l12, &l13);
+
+  {
+    EdgeScanT *left  = longOnRight ? &l12 : &l13;
+    EdgeScanT *right = longOnRight ? &l13 : &l12;
+
+    DrawTriangleSegment(canvas, &tm, left, right, lroundf(p1->y), l12.height);
+
+    if (longOnRight)
+      left = &l23;
+    else
+      right = &l23;
+
+    DrawTriangleSegment(canvas, &tm, left, right, lroundf(p2->y), l23.height);
+  }
+}
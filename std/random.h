@@ -17,7 +17,7 @@ static inline int32_t RandomInt32(int32_t *i) {
 static inline float RandomFloat(int32_t *i) {
   int32_t n = RandomInt32(i);
   float f;
-  n &= ~0x7fffff;
+  n &= 0x7fffff;
   n |= 0x3f800000;
   f = *(float *)&n;
   return f - 1.0;
@@ -0,0 +1,250 @@
+#include "std/debug.h"
+#include "std/memory.h"
+#include "system/c2p.h"
+
+size_t C2PBytesConverted;
+
+void c2p1x1_8_ref(uint8_t *chunky, struct BitMap *bitmap,
+                  uint16_t width, uint16_t height,
+                  uint16_t offsetX, uint16_t offsetY)
+{
+  int x, y, i, b;
+
+  for (y = 0; y < height; y++) {
+    size_t offset = (offsetY + y) * bitmap->BytesPerRow + offsetX / 8;
+
+    for (x = 0; x < width; x += 8, offset++) {
+      uint8_t planes[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+      /* Leftmost pixel goes to the most significant bit. */
+      for (i = 0; i < 8; i++) {
+        uint8_t c = *chunky++;
+
+        for (b = 0; b < 8; b++)
+          planes[b] = (planes[b] << 1) | ((c >> b) & 1);
+      }
+
+      for (b = 0; b < 8; b++)
+        bitmap->Planes[b][offset] = planes[b];
+    }
+  }
+}
+
+struct BitMap *NewC2PBitMap(size_t width, size_t height) {
+  struct BitMap *bitmap = NewRecord(struct BitMap);
+  int i;
+
+  bitmap->BytesPerRow = width / 8;
+  bitmap->Rows = height;
+  bitmap->Depth = 8;
+
+  for (i = 0; i < 8; i++)
+    bitmap->Planes[i] = NewTable(uint8_t, width / 8 * height);
+
+  return bitmap;
+}
+
+void DeleteC2PBitMap(struct BitMap *bitmap) {
+  int i;
+
+  for (i = 0; i < 8; i++)
+    MemUnref(bitmap->Planes[i]);
+
+  MemUnref(bitmap);
+}
+
+static void C2PAssembly(uint8_t *chunky, struct BitMap *bitmap,
+                        uint16_t width, uint16_t height,
+                        uint16_t offsetX, uint16_t offsetY)
+{
+  c2p1x1_8_c5_bm(chunky, bitmap, width, height, offsetX, offsetY);
+}
+
+/*
+ * Consecutive rows of blocks that are dirty across whole width are converted
+ * with a single call.  Otherwise each run of dirty blocks is converted line
+ * by line, since c2p routine expects chunky rows to be exactly as wide as
+ * converted area.
+ */
+size_t C2PDirty(PixBufT *canvas, struct BitMap *bitmap, C2PFuncT convert) {
+  const int width = canvas->width;
+  const int height = canvas->height;
+  const int rows = (height + PIXBUF_DIRTY_H - 1) / PIXBUF_DIRTY_H;
+  const uint32_t full = (2U << ((width - 1) / PIXBUF_DIRTY_W)) - 1;
+  uint32_t *current = canvas->dirty;
+  uint32_t *previous = canvas->dirty + rows;
+  size_t bytes = 0;
+  int r = 0;
+
+  ASSERT(current, "Dirty tracking is not enabled.");
+  ASSERT((width & (PIXBUF_DIRTY_W - 1)) == 0,
+         "Width (%d) must be a multiple of %d.", width, PIXBUF_DIRTY_W);
+
+  if (!convert)
+    convert = C2PAssembly;
+
+  while (r < rows) {
+    uint32_t mask = current[r] | previous[r];
+    int ys = r * PIXBUF_DIRTY_H;
+    int ye;
+
+    if (mask == full) {
+      do {
+        previous[r] = current[r];
+        current[r] = 0;
+        r++;
+      } while (r < rows && (current[r] | previous[r]) == full);
+
+      ye = min(r * PIXBUF_DIRTY_H, height);
+
+      convert(canvas->data + ys * width, bitmap, width, ye - ys, 0, ys);
+      bytes += width * (ye - ys);
+      continue;
+    }
+
+    previous[r] = current[r];
+    current[r] = 0;
+    r++;
+
+    ye = min(r * PIXBUF_DIRTY_H, height);
+
+    while (mask) {
+      int c0 = 0, c1, x, w, y;
+
+      while (!(mask & (1U << c0)))
+        c0++;
+      for (c1 = c0; c1 < 32 && (mask & (1U << c1)); c1++)
+        mask &= ~(1U << c1);
+
+      x = c0 * PIXBUF_DIRTY_W;
+      w = (c1 - c0) * PIXBUF_DIRTY_W;
+
+      for (y = ys; y < ye; y++)
+        convert(canvas->data + y * width + x, bitmap, w, 1, x, y);
+
+      bytes += w * (ye - ys);
+    }
+  }
+
+  C2PBytesConverted = bytes;
+
+  return bytes;
+}
+
+static void DeleteC2PDelta(C2PDeltaT *self) {
+  MemUnref(self->frame[0]);
+  MemUnref(self->frame[1]);
+}
+
+TYPEDECL(C2PDeltaT, (FreeFuncT)DeleteC2PDelta);
+
+C2PDeltaT *NewC2PDelta(size_t width, size_t height) {
+  C2PDeltaT *self = NewInstance(C2PDeltaT);
+
+  ASSERT((width & 31) == 0, "Width (%d) must be a multiple of 32.", (int)width);
+
+  self->width = width;
+  self->height = height;
+  self->frame[0] = NewTable(uint8_t, width * height);
+  self->frame[1] = NewTable(uint8_t, width * height);
+
+  return self;
+}
+
+/* Returns index of the frame that was last converted into bitmap. */
+static int FindFrame(C2PDeltaT *self, struct BitMap *bitmap) {
+  int i;
+
+  if (self->bitmap[0] == bitmap)
+    return 0;
+  if (self->bitmap[1] == bitmap)
+    return 1;
+
+  /* A new bitmap replaces both, unless the second one is still missing. */
+  i = (self->bitmap[0] && !self->bitmap[1]) ? 1 : 0;
+
+  self->bitmap[i] = bitmap;
+  if (i == 0)
+    self->bitmap[1] = NULL;
+
+  return -1 - i;
+}
+
+/* Converts run of changed groups that ends just before group x. */
+static size_t ConvertRun(PixBufT *canvas, struct BitMap *bitmap,
+                         C2PFuncT convert, int x, int y, int run)
+{
+  int xs = (x - run) * 32;
+
+  convert(canvas->data + y * canvas->width + xs, bitmap, run * 32, 1, xs, y);
+
+  return run * 32;
+}
+
+size_t C2PDeltaConvert(C2PDeltaT *self, PixBufT *canvas,
+                       struct BitMap *bitmap, C2PFuncT convert)
+{
+  const int width = self->width;
+  const int height = self->height;
+  const int groups = width / 32;
+  uint32_t *src = (uint32_t *)canvas->data;
+  uint32_t *last;
+  size_t bytes = 0, skipped = 0;
+  int i, x, y;
+
+  ASSERT(canvas->width == width && canvas->height == height,
+         "Canvas size does not match (%d, %d).", width, height);
+  ASSERT(PixBufIsContiguous(canvas), "Views are not supported.");
+
+  if (!convert)
+    convert = C2PAssembly;
+
+  i = FindFrame(self, bitmap);
+
+  /* Contents of a bitmap seen for the first time are unknown. */
+  if (i < 0) {
+    i = -1 - i;
+    convert(canvas->data, bitmap, width, height, 0, 0);
+    MemCopy(self->frame[i], canvas->data, width * height);
+    self->groups += groups * height;
+    return C2PBytesConverted = width * height;
+  }
+
+  last = (uint32_t *)self->frame[i];
+
+  for (y = 0; y < height; y++) {
+    /* number of changed groups just before x */
+    int run = 0;
+
+    for (x = 0; x < groups; x++, src += 8, last += 8) {
+      uint32_t diff = (src[0] ^ last[0]) | (src[1] ^ last[1]) |
+                      (src[2] ^ last[2]) | (src[3] ^ last[3]) |
+                      (src[4] ^ last[4]) | (src[5] ^ last[5]) |
+                      (src[6] ^ last[6]) | (src[7] ^ last[7]);
+
+      if (diff) {
+        last[0] = src[0]; last[1] = src[1];
+        last[2] = src[2]; last[3] = src[3];
+        last[4] = src[4]; last[5] = src[5];
+        last[6] = src[6]; last[7] = src[7];
+        run++;
+        continue;
+      }
+
+      skipped++;
+
+      if (run) {
+        bytes += ConvertRun(canvas, bitmap, convert, x, y, run);
+        run = 0;
+      }
+    }
+
+    if (run)
+      bytes += ConvertRun(canvas, bitmap, convert, groups, y, run);
+  }
+
+  self->groups += groups * height;
+  self->skipped += skipped;
+
+  return C2PBytesConverted = bytes;
+}
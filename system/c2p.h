@@ -4,9 +4,59 @@
 #include <graphics/gfx.h>
 
 #include "std/types.h"
+#include "gfx/pixbuf.h"
 
 void c2p1x1_8_c5_bm(uint8_t *chunky asm("a0"), struct BitMap *bitmap asm("a1"),
                     uint16_t width asm("d0"), uint16_t height asm("d1"),
                     uint16_t offsetX asm("d2"), uint16_t offsetY asm("d3"));
 
+/* Portable equivalent of the routine above, slow but easy to verify. */
+void c2p1x1_8_ref(uint8_t *chunky, struct BitMap *bitmap,
+                  uint16_t width, uint16_t height,
+                  uint16_t offsetX, uint16_t offsetY);
+
+/*
+ * Bitmap with 8 planes in any memory.  Not for display, but a target for c2p
+ * routines in tests and benchmarks.
+ */
+struct BitMap *NewC2PBitMap(size_t width, size_t height);
+void DeleteC2PBitMap(struct BitMap *bitmap);
+
+typedef void (*C2PFuncT)(uint8_t *chunky, struct BitMap *bitmap,
+                         uint16_t width, uint16_t height,
+                         uint16_t offsetX, uint16_t offsetY);
+
+/* Number of chunky bytes converted by the last call to C2PDirty. */
+extern size_t C2PBytesConverted;
+
+/*
+ * Converts only dirty blocks of the canvas (see PixBufEnableDirty) and
+ * clears them.  Since the display is double buffered, blocks that were dirty
+ * in the previous frame are converted again.  NULL selects the assembly
+ * routine.  Returns number of bytes converted.
+ */
+size_t C2PDirty(PixBufT *canvas, struct BitMap *bitmap, C2PFuncT convert);
+
+/*
+ * Keeps chunky frames last converted into each of two bitmaps and converts
+ * only 32-pixel groups that differ from them.  Works for any drawing code,
+ * at the cost of comparing whole frame.
+ */
+typedef struct C2PDelta {
+  size_t width, height;
+
+  struct BitMap *bitmap[2];
+  uint8_t *frame[2];
+
+  /* number of 32-pixel groups compared and skipped so far */
+  size_t groups;
+  size_t skipped;
+} C2PDeltaT;
+
+C2PDeltaT *NewC2PDelta(size_t width, size_t height);
+
+/* Same arguments and result as C2PDirty. */
+size_t C2PDeltaConvert(C2PDeltaT *self, PixBufT *canvas,
+                       struct BitMap *bitmap, C2PFuncT convert);
+
 #endif
@@ -1,8 +1,21 @@
+#include "engine/hashgrid.h"
+#include "engine/matrix3d.h"
+#include "engine/particles.h"
+#include "engine/quantized.h"
+#include "gfx/affine.h"
+#include "gfx/blit.h"
+#include "gfx/colormap.h"
+#include "gfx/filter.h"
 #include "gfx/pixbuf.h"
+#include "gfx/quantize.h"
 #include "gfx/line.h"
+#include "gfx/palette.h"
+#include "gfx/sprite.h"
+#include "gfx/triangle.h"
 #include "std/debug.h"
 #include "std/memory.h"
 #include "std/random.h"
+#include "system/c2p.h"
 #include "tools/profiling.h"
 
 typedef struct Line {
@@ -10,12 +23,114 @@ typedef struct Line {
   int x2, y2;
 } LineT;
 
+static void CountPair(PtrT data, size_t i UNUSED, size_t j UNUSED) {
+  (*(int *)data)++;
+}
+
+/* Fills the system up, so that every step processes capacity particles. */
+static ParticleSystemT *NewFullParticleSystem(size_t capacity) {
+  ParticleSystemT *ps = NewParticleSystem(capacity);
+  PointEmitterT emitter = {
+    { 0.0f, 0.0f, 0.0f }, 1.0f, capacity, 0xffff, 0x2bad5eed
+  };
+
+  ps->gravity.y = -0.1f;
+  ps->drag = 0.01f;
+
+  EmitFromPoint(ps, &emitter);
+
+  return ps;
+}
+
+#define FRAMES 16
+
+/*
+ * Generates a synthetic sequence of frames: a few sprites moving over static
+ * background, or (if sprites is zero) noise that changes every pixel.
+ */
+static PixBufT **NewSyntheticFrames(PixBufT *sprite, int sprites) {
+  PixBufT **frame = NewTable(PixBufT *, FRAMES);
+  int r = 0x7e57f00d;
+  int i, j;
+
+  for (i = 0; i < FRAMES; i++) {
+    PixBufT *canvas = NewPixBuf(PIXBUF_GRAY, 256, 256);
+
+    for (j = 0; j < 256 * 256; j++)
+      canvas->data[j] = sprites ? (j ^ (j >> 8)) : RandomInt32(&r);
+
+    for (j = 0; j < sprites; j++)
+      PixBufBlit(canvas, (j * 37 + i * 3) & 255, (j * 91 + i * 2) & 255,
+                 sprite, NULL);
+
+    frame[i] = canvas;
+  }
+
+  return frame;
+}
+
+static void DeleteFrames(PixBufT **frame) {
+  int i;
+
+  for (i = 0; i < FRAMES; i++)
+    MemUnref(frame[i]);
+
+  MemUnref(frame);
+}
+
+/* Each run blits the same number of pixels regardless of sprite size. */
+#define PROFILE_BLIT(NAME, MODE, SIZE)                          \
+  PixBufSetBlitMode(sprite ## SIZE, MODE);                      \
+  PROFILE (NAME ## SIZE)                                        \
+    for (i = 0; i < 4 * 65536 / (SIZE * SIZE); i++)             \
+      PixBufBlit(canvas, 0, 0, sprite ## SIZE, NULL);
+
+#define PROFILE_BLIT_MODE(NAME, MODE)                           \
+  PROFILE_BLIT(NAME, MODE, 16)                                  \
+  PROFILE_BLIT(NAME, MODE, 64)                                  \
+  PROFILE_BLIT(NAME, MODE, 256)
+
+typedef struct Triangle {
+  TriPointUV p[3];
+} TriangleT;
+
+typedef struct ShadedTriangle {
+  TriPointC p[3];
+} ShadedTriangleT;
+
 int main() {
   int n = 100000;
+  int m = 10000;
+  int k = 10000;
+  int l = 50000;
+  int f = 2000;
+  int pairs = 0;
   int i;
 
   PixBufT *canvas = NewPixBuf(PIXBUF_GRAY, 256, 256);
+  PixBufT *texture = NewPixBuf(PIXBUF_GRAY, 256, 256);
   LineT *lines = NewTable(LineT, n);
+  TriangleT *triangles = NewTable(TriangleT, m);
+  ShadedTriangleT *shaded = NewTable(ShadedTriangleT, m);
+  Vector3D *vertices = NewTable(Vector3D, k);
+  QuantVertexT *qVertices = NewTable(QuantVertexT, k);
+  Vector3D *transformed = NewTable(Vector3D, k);
+  Vector3D *transformedAffine = NewTable(Vector3D, k);
+  Vector3D qScale = { 1.0f / 32767.0f, 1.0f / 32767.0f, 1.0f / 32767.0f };
+  Vector3D qOffset = { 0.0f, 0.0f, 0.0f };
+  Matrix3D *matrix = NewMatrix3D();
+  Matrix3D *product = NewMatrix3D();
+  Affine3D affine;
+  Vector3D *particles = NewTable(Vector3D, l);
+  HashGridT *grid = NewHashGrid(1.0f, 65536);
+  PixBufT *flare = NewPixBuf(PIXBUF_GRAY, 16, 16);
+  PointT *flares = NewTable(PointT, f);
+  uint8_t *flareImage = NewTable(uint8_t, f);
+  SpriteBatchT *sprites = NewSpriteBatch(256, 256, f);
+  PixBufT *sprite16 = NewPixBuf(PIXBUF_GRAY, 16, 16);
+  PixBufT *sprite64 = NewPixBuf(PIXBUF_GRAY, 64, 64);
+  PixBufT *sprite256 = NewPixBuf(PIXBUF_GRAY, 256, 256);
+  uint8_t *colorMap = NewTable(uint8_t, 65536);
 
   LOG("Generating %d random lines.", n);
 
@@ -29,6 +144,109 @@ int main() {
     line->y2 = RandomInt32(&r) & 255;
   }
 
+  {
+    static int r = 0x1f2e3d4c;
+    float area = 0.0f;
+
+    LOG("Generating %d random textured triangles.", m);
+
+    for (i = 0; i < m; i++) {
+      TriPointUV *p = triangles[i].p;
+      int j;
+
+      for (j = 0; j < 3; j++) {
+        p[j].x = RandomInt32(&r) & 255;
+        p[j].y = RandomInt32(&r) & 255;
+        p[j].z = 1.0f / (1.0f + (RandomInt32(&r) & 3));
+        p[j].u = RandomInt32(&r) & 255;
+        p[j].v = RandomInt32(&r) & 255;
+
+        /* Same triangles for Gouraud fillers, shaded with texture u. */
+        shaded[i].p[j].x = p[j].x;
+        shaded[i].p[j].y = p[j].y;
+        shaded[i].p[j].c = p[j].u;
+      }
+
+      area += fabsf((p[1].x - p[0].x) * (p[2].y - p[0].y) -
+                    (p[2].x - p[0].x) * (p[1].y - p[0].y)) * 0.5f;
+    }
+
+    /* Divide by timing of DrawTriangleUV to get the fill rate. */
+    LOG("Textured triangles cover %d pixels.", (int)area);
+  }
+
+  {
+    static int r = 0x5a5a1234;
+
+    LOG("Generating %d random vertices (%d bytes as floats, "
+        "%d bytes quantized).", k, (int)(sizeof(Vector3D) * k),
+        (int)(sizeof(QuantVertexT) * k));
+
+    for (i = 0; i < k; i++) {
+      qVertices[i].x = RandomInt32(&r);
+      qVertices[i].y = RandomInt32(&r);
+      qVertices[i].z = RandomInt32(&r);
+      vertices[i].x = qVertices[i].x * qScale.x;
+      vertices[i].y = qVertices[i].y * qScale.y;
+      vertices[i].z = qVertices[i].z * qScale.z;
+    }
+
+    LoadRotation3D(matrix, 0.5f, 1.0f, 1.5f);
+    LoadAffine3D(&affine, matrix);
+  }
+
+  {
+    static int r = 0x600dcafe;
+
+    LOG("Generating %d random particles.", l);
+
+    for (i = 0; i < l; i++) {
+      particles[i].x = (RandomInt32(&r) & 1023) * (1.0f / 8.0f);
+      particles[i].y = (RandomInt32(&r) & 1023) * (1.0f / 8.0f);
+      particles[i].z = (RandomInt32(&r) & 1023) * (1.0f / 8.0f);
+    }
+  }
+
+  {
+    static int r = 0x0f1a2e5;
+
+    LOG("Generating %d random flares.", f);
+
+    for (i = 0; i < f; i++) {
+      flares[i].x = (RandomInt32(&r) & 255);
+      flares[i].y = (RandomInt32(&r) & 255);
+    }
+
+    for (i = 0; i < 16 * 16; i++)
+      flare->data[i] = RandomInt32(&r) & 31;
+
+    PixBufSetBlitMode(flare, BLIT_ADDITIVE_CLIP);
+    SpriteBatchSetImage(sprites, 0, flare);
+  }
+
+  {
+    static int r = 0x3b17c0de;
+
+    LOG("Generating sprites for each blit mode.");
+
+    for (i = 0; i < 65536; i++) {
+      /* A quarter of pixels is transparent. */
+      uint8_t c = (RandomInt32(&r) & 3) ? RandomInt32(&r) : 0;
+
+      sprite256->data[i] = c;
+      if (i < 64 * 64)
+        sprite64->data[i] = c;
+      if (i < 16 * 16)
+        sprite16->data[i] = c;
+      colorMap[i] = RandomInt32(&r);
+    }
+
+    /* Color map and function share a pointer. */
+    sprite16->blit.cmap = colorMap;
+    sprite64->blit.cmap = colorMap;
+    sprite256->blit.cmap = colorMap;
+  }
+
   StartProfiling();
 
   PROFILE (DrawLineUnsafe)
@@ -45,9 +263,318 @@ int main() {
       DrawLineAA(canvas, line->x1, line->y1, line->x2, line->y2);
     }
 
+  PROFILE (DrawTriangleC)
+    for (i = 0; i < m; i++) {
+      TriPointC *p = shaded[i].p;
+
+      DrawTriangleC(canvas, &p[0], &p[1], &p[2]);
+    }
+
+  PROFILE (DrawTriangleCF)
+    for (i = 0; i < m; i++) {
+      TriPointC *p = shaded[i].p;
+
+      DrawTriangleCF(canvas, &p[0], &p[1], &p[2]);
+    }
+
+  PROFILE (DrawTriangleUV)
+    for (i = 0; i < m; i++) {
+      TriPointUV *p = triangles[i].p;
+
+      DrawTriangleUV(canvas, texture, &p[0], &p[1], &p[2], 0);
+    }
+
+  PROFILE (PixBufBlit)
+    for (i = 0; i < f; i++)
+      PixBufBlit(canvas, flares[i].x - 8, flares[i].y - 8, flare, NULL);
+
+  PROFILE (SpriteBatchRender)
+    {
+      SpriteBatchReset(sprites);
+      SpriteBatchAdd(sprites, flares, flareImage, NULL, f);
+      SpriteBatchRender(sprites, canvas);
+    }
+
+  PROFILE_BLIT_MODE(BlitNormal, BLIT_NORMAL)
+  PROFILE_BLIT_MODE(BlitTransparent, BLIT_TRANSPARENT)
+  PROFILE_BLIT_MODE(BlitAdditive, BLIT_ADDITIVE)
+  PROFILE_BLIT_MODE(BlitAdditiveClip, BLIT_ADDITIVE_CLIP)
+  PROFILE_BLIT_MODE(BlitSubstractive, BLIT_SUBSTRACTIVE)
+  PROFILE_BLIT_MODE(BlitSubstractiveClip, BLIT_SUBSTRACTIVE_CLIP)
+  PROFILE_BLIT_MODE(BlitColorMap, BLIT_COLOR_MAP)
+  PROFILE_BLIT_MODE(BlitColorFunc, BLIT_COLOR_FUNC)
+
+  PROFILE (Transform3D)
+    Transform3D(transformed, vertices, k, matrix);
+
+  PROFILE (TransformQuantized3D)
+    TransformQuantized3D(transformed, qVertices, k, matrix, &qScale, &qOffset);
+
+  PROFILE (TransformAffine3D)
+    TransformAffine3D(transformedAffine, vertices, k, &affine);
+
+  PROFILE (Multiply3D)
+    for (i = 0; i < k; i++)
+      Multiply3D(product, matrix, matrix);
+
+  PROFILE (MultiplyAffine3D)
+    for (i = 0; i < k; i++)
+      MultiplyAffine3D(product, matrix, matrix);
+
+  PROFILE (HashGridBuild)
+    HashGridBuild(grid, particles, l);
+
+  PROFILE (HashGridForEachPair)
+    HashGridForEachPair(grid, 1.0f, CountPair, &pairs);
+
+  {
+    ParticleSystemT *ps;
+
+    ps = NewFullParticleSystem(1000);
+    PROFILE (ParticleSystemStep1k)
+      ParticleSystemStep(ps, 0.02f);
+    MemUnref(ps);
+
+    ps = NewFullParticleSystem(10000);
+    PROFILE (ParticleSystemStep10k)
+      ParticleSystemStep(ps, 0.02f);
+    MemUnref(ps);
+
+    ps = NewFullParticleSystem(100000);
+    PROFILE (ParticleSystemStep100k)
+      ParticleSystemStep(ps, 0.02f);
+    MemUnref(ps);
+
+    /* Takes about 28MiB. */
+    ps = NewFullParticleSystem(1000000);
+    PROFILE (ParticleSystemStep1M)
+      ParticleSystemStep(ps, 0.02f);
+    MemUnref(ps);
+  }
+
+  {
+    SphereT sphere[4] = {
+      { { 0.5f, 0.0f, 0.0f }, 0.1f }, { { -0.5f, 0.0f, 0.0f }, 0.1f },
+      { { 0.0f, 0.5f, 0.0f }, 0.1f }, { { 0.0f, -0.5f, 0.0f }, 0.1f }
+    };
+    CollisionActorT actor[4];
+    ParticleSystemT *ps;
+
+    for (i = 0; i < 4; i++)
+      SphereActorInit(&actor[i], &sphere[i]);
+
+    ps = NewFullParticleSystem(50000);
+    ParticleSystemSetActors(ps, actor, 4);
+    PROFILE (ParticleSystemCollide50k)
+      ParticleSystemStep(ps, 0.02f);
+
+    ParticleSystemEnableGrid(ps, 0.25f);
+    PROFILE (ParticleSystemCollideGrid50k)
+      ParticleSystemStep(ps, 0.02f);
+    MemUnref(ps);
+  }
+
+  {
+    PixBufT **sprited, **noise;
+    C2PDeltaT *spritedDelta = NewC2PDelta(256, 256);
+    C2PDeltaT *noiseDelta = NewC2PDelta(256, 256);
+    struct BitMap *screen[2] = {
+      NewC2PBitMap(256, 256), NewC2PBitMap(256, 256)
+    };
+    int j = 0;
+
+    PixBufSetBlitMode(sprite16, BLIT_TRANSPARENT);
+    sprited = NewSyntheticFrames(sprite16, 16);
+    noise = NewSyntheticFrames(NULL, 0);
+
+    PROFILE (C2PFull)
+      for (i = 0; i < FRAMES; i++)
+        c2p1x1_8_c5_bm(sprited[i]->data, screen[i & 1], 256, 256, 0, 0);
+
+    PROFILE (C2PDeltaSprites)
+      for (i = 0; i < FRAMES; i++, j++)
+        C2PDeltaConvert(spritedDelta, sprited[i], screen[j & 1], NULL);
+
+    PROFILE (C2PDeltaNoise)
+      for (i = 0; i < FRAMES; i++, j++)
+        C2PDeltaConvert(noiseDelta, noise[i], screen[j & 1], NULL);
+
+    LOG("C2PDelta skipped %d%% of groups with sprites, %d%% with noise.",
+        (int)(spritedDelta->skipped * 100 / spritedDelta->groups),
+        (int)(noiseDelta->skipped * 100 / noiseDelta->groups));
+
+    DeleteC2PBitMap(screen[1]);
+    DeleteC2PBitMap(screen[0]);
+    MemUnref(noiseDelta);
+    MemUnref(spritedDelta);
+    DeleteFrames(noise);
+    DeleteFrames(sprited);
+  }
+
+  {
+    static int r = 0x2e6b9a11;
+    PaletteT *palette = NewPalette(256);
+    RGB *colors = NewTable(RGB, 65536);
+    uint8_t *remapped = NewTable(uint8_t, 65536);
+    int differ = 0;
+
+    for (i = 0; i < 256; i++)
+      palette->colors[i] = MakeRGB(RandomInt32(&r), RandomInt32(&r),
+                                   RandomInt32(&r));
+
+    for (i = 0; i < 65536; i++)
+      colors[i] = MakeRGB(RandomInt32(&r), RandomInt32(&r), RandomInt32(&r));
+
+    /* Both remap 65536 pixels, divide by timing to get the throughput. */
+    PROFILE (PaletteFindNearestExact)
+      for (i = 0; i < 65536; i++)
+        remapped[i] = PaletteFindNearestExact(palette, colors[i]);
+
+    PROFILE (PaletteFindNearest)
+      for (i = 0; i < 65536; i++)
+        remapped[i] = PaletteFindNearest(palette, colors[i]);
+
+    for (i = 0; i < 65536; i++)
+      if (remapped[i] != PaletteFindNearestExact(palette, colors[i]))
+        differ++;
+
+    LOG("Inverse color map differs from exhaustive search for %d of 65536 "
+        "colors.", differ);
+
+    /* From scratch, as at precalc time, including the inverse color map. */
+    PROFILE (NewColorMap)
+    {
+      PaletteChanged(palette);
+      MemUnref(NewColorMap(palette, COLORMAP_SHADES));
+    }
+
+    MemUnref(remapped);
+    MemUnref(colors);
+    MemUnref(palette);
+  }
+
+  {
+    static int r = 0x51ee7a9;
+    PixBufT *image = NewPixBuf(PIXBUF_RGB, 256, 256);
+    RGB *pixel = (RGB *)image->data;
+    PaletteT *palette = NULL;
+    PixBufT *quantized = NULL;
+
+    /* Smooth gradients with some noise, like a rendered texture. */
+    for (i = 0; i < 65536; i++)
+      pixel[i] = MakeRGB((i & 255) ^ (RandomInt32(&r) & 15), i >> 8,
+                         ((i & 255) + (i >> 8)) >> 1);
+
+    PROFILE (QuantizePalette)
+    {
+      MemUnref(palette);
+      palette = QuantizePalette(&image, 1, 256);
+    }
+
+    PROFILE (QuantizeImage)
+    {
+      MemUnref(quantized);
+      quantized = QuantizeImage(image, palette, DITHER_NONE);
+    }
+
+    PROFILE (QuantizeImageFloydSteinberg)
+    {
+      MemUnref(quantized);
+      quantized = QuantizeImage(image, palette, DITHER_FLOYD_STEINBERG);
+    }
+
+    MemUnref(quantized);
+    MemUnref(palette);
+    MemUnref(image);
+  }
+
+  {
+    static int r = 0x6b1c0ffe;
+    PixBufT *image = NewPixBuf(PIXBUF_GRAY, 256, 256);
+    BlurBufferT *buffer = NewBlurBuffer(256, BlurGaussianRadius(8.0f));
+
+    for (i = 0; i < 65536; i++)
+      image->data[i] = RandomInt32(&r);
+
+    /* Four passes of 3-tap blur have the same variance as sigma of 1.63. */
+    PROFILE (BlurH3V3x4)
+    {
+      int j;
+
+      for (j = 0; j < 4; j++) {
+        BlurH3(canvas, image);
+        BlurV3(image, canvas, buffer);
+      }
+    }
+
+    PROFILE (BlurBox2)
+      BlurBox(image, image, 2, buffer);
+
+    PROFILE (BlurGaussianNarrow)
+      BlurGaussian(image, image, 1.63f, buffer);
+
+    PROFILE (BlurGaussianWide)
+      BlurGaussian(image, image, 8.0f, buffer);
+
+    MemUnref(buffer);
+    MemUnref(image);
+  }
+
+  {
+    Matrix2D m;
+
+    /* Rotation by 90 degrees walks the texture along columns. */
+    LoadRotation2D(&m, 0.0f);
+    PROFILE (BlitAffine0)
+      PixBufBlitAffine(canvas, texture, &m, AFFINE_WRAP);
+
+    LoadRotation2D(&m, 90.0f);
+    PROFILE (BlitAffine90)
+      PixBufBlitAffine(canvas, texture, &m, AFFINE_WRAP);
+
+    LoadRotation2D(&m, 30.0f);
+    PROFILE (BlitAffineClamp)
+      PixBufBlitAffine(canvas, texture, &m, AFFINE_CLAMP);
+  }
+
   StopProfiling();
 
+  LOG("Found %d pairs of particles closer than 1.0.", pairs);
+
+  {
+    float error = 0.0f;
+
+    Transform3D(transformed, vertices, k, matrix);
+
+    for (i = 0; i < k; i++) {
+      error = max(error, fabsf(transformed[i].x - transformedAffine[i].x));
+      error = max(error, fabsf(transformed[i].y - transformedAffine[i].y));
+      error = max(error, fabsf(transformed[i].z - transformedAffine[i].z));
+    }
+
+    ASSERT(error < 1e-6f, "TransformAffine3D differs by %f.", error);
+  }
+
+  MemUnref(colorMap);
+  MemUnref(sprite256);
+  MemUnref(sprite64);
+  MemUnref(sprite16);
+  MemUnref(sprites);
+  MemUnref(flareImage);
+  MemUnref(flares);
+  MemUnref(flare);
+  MemUnref(grid);
+  MemUnref(particles);
+  MemUnref(product);
+  MemUnref(matrix);
+  MemUnref(transformedAffine);
+  MemUnref(transformed);
+  MemUnref(qVertices);
+  MemUnref(vertices);
+  MemUnref(triangles);
+  MemUnref(shaded);
   MemUnref(lines);
+  MemUnref(texture);
   MemUnref(canvas);
 
   return 0;
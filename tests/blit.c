@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "gfx/blitops.h"
+#include "gfx/pixbuf.h"
+#include "gfx/raw.h"
+#include "std/memory.h"
+#include "std/random.h"
+
+#define SIZE 256
+
+static const char *ModeName[] = {
+  "NORMAL", "TRANSPARENT", "ADDITIVE", "ADDITIVE_CLIP",
+  "SUBSTRACTIVE", "SUBSTRACTIVE_CLIP", "COLOR_MAP", "COLOR_FUNC"
+};
+
+/* Straightforward definition of each mode, one pixel at a time. */
+static uint8_t ReferencePixel(BlitModeT mode, uint8_t a, uint8_t b,
+                              uint8_t *lut)
+{
+  switch (mode) {
+    case BLIT_NORMAL:
+      return b;
+    case BLIT_TRANSPARENT:
+      return b ? b : a;
+    case BLIT_ADDITIVE:
+      return a + b;
+    case BLIT_ADDITIVE_CLIP:
+      return min(a + b, 255);
+    case BLIT_SUBSTRACTIVE:
+      return a - b;
+    case BLIT_SUBSTRACTIVE_CLIP:
+      return max(a - b, 0);
+    case BLIT_COLOR_MAP:
+      return lut[a * 256 + b];
+    case BLIT_COLOR_FUNC:
+      return lut[b];
+  }
+
+  return 0;
+}
+
+static void Reference(BlitModeT mode, uint8_t *dst, uint8_t *src,
+                      int w, int h, uint8_t *lut)
+{
+  int x, y;
+
+  for (y = 0; y < h; y++)
+    for (x = 0; x < w; x++)
+      dst[y * SIZE + x] = ReferencePixel(mode, dst[y * SIZE + x],
+                                         src[y * SIZE + x], lut);
+}
+
+static void Portable(BlitModeT mode, uint8_t *dst, uint8_t *src,
+                     int w, int h, uint8_t *lut)
+{
+  int stride = SIZE - w;
+
+  switch (mode) {
+    case BLIT_NORMAL:
+      BlitNormal(dst, src, w, h, stride, stride);
+      break;
+    case BLIT_TRANSPARENT:
+      BlitTransparent(dst, src, w, h, stride, stride);
+      break;
+    case BLIT_ADDITIVE:
+      BlitAdditive(dst, src, w, h, stride, stride);
+      break;
+    case BLIT_ADDITIVE_CLIP:
+      BlitAdditiveClip(dst, src, w, h, stride, stride);
+      break;
+    case BLIT_SUBSTRACTIVE:
+      BlitSubstractive(dst, src, w, h, stride, stride);
+      break;
+    case BLIT_SUBSTRACTIVE_CLIP:
+      BlitSubstractiveClip(dst, src, w, h, stride, stride);
+      break;
+    case BLIT_COLOR_MAP:
+      BlitColorMap(dst, src, w, h, stride, stride, lut);
+      break;
+    case BLIT_COLOR_FUNC:
+      BlitColorFunc(dst, src, w, h, stride, stride, lut);
+      break;
+  }
+}
+
+static bool HasAssembly(BlitModeT mode) {
+  return (mode == BLIT_NORMAL || mode == BLIT_TRANSPARENT ||
+          mode == BLIT_COLOR_MAP || mode == BLIT_COLOR_FUNC);
+}
+
+static void Assembly(BlitModeT mode, uint8_t *dst, uint8_t *src,
+                     int w, int h, uint8_t *lut)
+{
+  int stride = SIZE - w;
+
+  switch (mode) {
+    case BLIT_NORMAL:
+      RawBlitNormal(dst, src, w, h, stride, stride);
+      break;
+    case BLIT_TRANSPARENT:
+      RawBlitTransparent(dst, src, w, h, stride, stride);
+      break;
+    case BLIT_COLOR_MAP:
+      RawBlitColorMap(dst, src, w, h, stride, stride, lut);
+      break;
+    case BLIT_COLOR_FUNC:
+      RawBlitColorFunc(dst, src, w, h, stride, stride, lut);
+      break;
+    default:
+      break;
+  }
+}
+
+typedef struct Case {
+  int dx, dy, sx, sy, w, h;
+} CaseT;
+
+int main() {
+  uint8_t *src = NewTable(uint8_t, SIZE * SIZE);
+  uint8_t *dst = NewTable(uint8_t, SIZE * SIZE);
+  uint8_t *expected = NewTable(uint8_t, SIZE * SIZE);
+  uint8_t *lut = NewTable(uint8_t, SIZE * SIZE);
+  int cases = 200;
+  int failed = 0;
+  int r = 0x6b1e77;
+  int i, m;
+
+  for (i = 0; i < SIZE * SIZE; i++)
+    lut[i] = RandomInt32(&r);
+
+  for (m = BLIT_NORMAL; m <= BLIT_COLOR_FUNC; m++) {
+    int errors[2] = { 0, 0 };
+    int k, pass;
+
+    for (k = 0; k <= cases; k++) {
+      CaseT c;
+
+      if (k == 0) {
+        /* Every pair of pixel values: dst = row, src = column. */
+        c.dx = c.dy = c.sx = c.sy = 0;
+        c.w = c.h = SIZE;
+      } else {
+        /* Odd sizes and offsets exercise unaligned heads and tails. */
+        c.w = 1 + (RandomInt32(&r) & 63);
+        c.h = 1 + (RandomInt32(&r) & 15);
+        c.dx = RandomInt32(&r) & 127;
+        c.dy = RandomInt32(&r) & 127;
+        c.sx = RandomInt32(&r) & 127;
+        c.sy = RandomInt32(&r) & 127;
+      }
+
+      for (pass = 0; pass < (HasAssembly(m) ? 2 : 1); pass++) {
+        uint8_t *d = &dst[c.dy * SIZE + c.dx];
+        uint8_t *s = &src[c.sy * SIZE + c.sx];
+        uint8_t *e = &expected[c.dy * SIZE + c.dx];
+
+        for (i = 0; i < SIZE * SIZE; i++) {
+          if (k == 0) {
+            dst[i] = i / SIZE;
+            src[i] = i % SIZE;
+          } else {
+            dst[i] = RandomInt32(&r);
+            /* Plenty of zeros for transparency. */
+            src[i] = (RandomInt32(&r) & 3) ? RandomInt32(&r) : 0;
+          }
+        }
+
+        memcpy(expected, dst, SIZE * SIZE);
+        Reference(m, e, s, c.w, c.h, lut);
+
+        if (pass == 0)
+          Portable(m, d, s, c.w, c.h, lut);
+        else
+          Assembly(m, d, s, c.w, c.h, lut);
+
+        if (memcmp(expected, dst, SIZE * SIZE))
+          errors[pass]++;
+      }
+    }
+
+    printf("%-17s portable: %s, assembly: %s\n", ModeName[m],
+           errors[0] ? "FAILED" : "ok",
+           HasAssembly(m) ?
+           (errors[1] ? "FAILED" : "ok") : "n/a");
+
+    failed += errors[0] + errors[1];
+  }
+
+  MemUnref(lut);
+  MemUnref(expected);
+  MemUnref(dst);
+  MemUnref(src);
+
+  return failed ? 1 : 0;
+}
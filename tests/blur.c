@@ -0,0 +1,156 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "std/memory.h"
+#include "std/random.h"
+#include "gfx/filter.h"
+
+#define WIDTH 80
+#define HEIGHT 60
+
+typedef void (*BoxFuncT)(PixBufT *dstBuf, PixBufT *srcBuf, size_t radius,
+                         BlurBufferT *buffer);
+
+/* Naive box blur in one direction, pixels beyond the edge are replicated. */
+static void NaiveBox(PixBufT *dstBuf, PixBufT *srcBuf, int radius,
+                     bool vertical)
+{
+  PixBufT *copy = NewPixBuf(PIXBUF_GRAY, WIDTH, HEIGHT);
+  int n = 2 * radius + 1;
+  int x, y, i;
+
+  memcpy(copy->data, srcBuf->data, WIDTH * HEIGHT);
+
+  for (y = 0; y < HEIGHT; y++) {
+    for (x = 0; x < WIDTH; x++) {
+      int sum = 0;
+
+      for (i = -radius; i <= radius; i++) {
+        int sx = vertical ? x : min(max(x + i, 0), WIDTH - 1);
+        int sy = vertical ? min(max(y + i, 0), HEIGHT - 1) : y;
+
+        sum += copy->data[sy * WIDTH + sx];
+      }
+
+      dstBuf->data[y * WIDTH + x] = (sum + radius) / n;
+    }
+  }
+
+  MemUnref(copy);
+}
+
+/* Same boxes as BlurGaussian picks, refer to gfx/filter.c. */
+static void NaiveGaussian(PixBufT *dstBuf, PixBufT *srcBuf, float sigma) {
+  float var12 = 12.0f * sigma * sigma;
+  int wl = (int)sqrtf(var12 / 3.0f + 1.0f);
+  int radius[3];
+  int m, i;
+
+  if (!(wl & 1))
+    wl--;
+
+  m = (int)((var12 - 3 * wl * wl - 12 * wl - 9) / (-4 * wl - 4) + 0.5f);
+
+  for (i = 0; i < 3; i++)
+    radius[i] = ((i < m) ? wl : wl + 2) / 2;
+
+  NaiveBox(dstBuf, srcBuf, radius[0], false);
+  for (i = 1; i < 3; i++)
+    NaiveBox(dstBuf, dstBuf, radius[i], false);
+  for (i = 0; i < 3; i++)
+    NaiveBox(dstBuf, dstBuf, radius[i], true);
+}
+
+static int CountErrors(PixBufT *result, PixBufT *expected) {
+  int errors = 0;
+  int i;
+
+  for (i = 0; i < WIDTH * HEIGHT; i++)
+    if (result->data[i] != expected->data[i])
+      errors++;
+
+  return errors;
+}
+
+/* Both out of place and in place, for each radius up to the largest one. */
+static bool CheckBox(const char *name, BoxFuncT blur, bool vertical,
+                     PixBufT *image, BlurBufferT *buffer)
+{
+  PixBufT *expected = NewPixBuf(PIXBUF_GRAY, WIDTH, HEIGHT);
+  PixBufT *result = NewPixBuf(PIXBUF_GRAY, WIDTH, HEIGHT);
+  int errors = 0, flat = 0;
+  int radius;
+
+  for (radius = 0; radius < 128; radius++) {
+    NaiveBox(expected, image, radius, vertical);
+
+    blur(result, image, radius, buffer);
+    errors += CountErrors(result, expected);
+
+    memcpy(result->data, image->data, WIDTH * HEIGHT);
+    blur(result, result, radius, buffer);
+    errors += CountErrors(result, expected);
+
+    /* Flat image must stay unchanged. */
+    memset(result->data, 255, WIDTH * HEIGHT);
+    blur(result, result, radius, buffer);
+    memset(expected->data, 255, WIDTH * HEIGHT);
+    flat += CountErrors(result, expected);
+  }
+
+  printf("%-12s %d wrong pixels, %d in flat image, %s\n", name, errors, flat,
+         (errors || flat) ? "FAILED" : "ok");
+
+  MemUnref(expected);
+  MemUnref(result);
+
+  return !errors && !flat;
+}
+
+static bool CheckGaussian(PixBufT *image, BlurBufferT *buffer) {
+  static const float sigma[] = { 0.5f, 1.0f, 2.5f, 6.0f, 20.0f, 60.0f };
+  PixBufT *expected = NewPixBuf(PIXBUF_GRAY, WIDTH, HEIGHT);
+  PixBufT *result = NewPixBuf(PIXBUF_GRAY, WIDTH, HEIGHT);
+  int errors = 0;
+  int i;
+
+  for (i = 0; i < sizeof(sigma) / sizeof(sigma[0]); i++) {
+    NaiveGaussian(expected, image, sigma[i]);
+
+    BlurGaussian(result, image, sigma[i], buffer);
+    errors += CountErrors(result, expected);
+
+    memcpy(result->data, image->data, WIDTH * HEIGHT);
+    BlurGaussian(result, result, sigma[i], buffer);
+    errors += CountErrors(result, expected);
+  }
+
+  printf("%-12s %d wrong pixels, %s\n", "BlurGaussian", errors,
+         errors ? "FAILED" : "ok");
+
+  MemUnref(expected);
+  MemUnref(result);
+
+  return !errors;
+}
+
+int main() {
+  PixBufT *image = NewPixBuf(PIXBUF_GRAY, WIDTH, HEIGHT);
+  BlurBufferT *buffer = NewBlurBuffer(WIDTH, 127);
+  int32_t seed = 0xcafebabe;
+  bool ok;
+  int i;
+
+  for (i = 0; i < WIDTH * HEIGHT; i++)
+    image->data[i] = RandomInt32(&seed);
+
+  ok = CheckBox("BlurBoxH", BlurBoxH, false, image, buffer);
+  ok &= CheckBox("BlurBoxV", BlurBoxV, true, image, buffer);
+  ok &= CheckGaussian(image, buffer);
+
+  MemUnref(buffer);
+  MemUnref(image);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "gfx/line.h"
+#include "gfx/rectangle.h"
+#include "std/memory.h"
+#include "std/random.h"
+#include "system/c2p.h"
+
+#define WIDTH  320
+#define HEIGHT 256
+#define FRAMES 100
+
+static bool SamePlanes(struct BitMap *a, struct BitMap *b) {
+  int i;
+
+  for (i = 0; i < 8; i++)
+    if (memcmp(a->Planes[i], b->Planes[i], WIDTH / 8 * HEIGHT))
+      return false;
+
+  return true;
+}
+
+static int RandomBelow(int *seed, int n) {
+  return (RandomInt32(seed) & 0x7fffffff) % n;
+}
+
+/*
+ * A few small objects per frame, as in a typical sprite effect.  They're
+ * drawn into target, which is either the canvas or a view of it.
+ */
+static void DrawFrame(PixBufT *canvas, PixBufT *target, int *seed) {
+  int w = target->width;
+  int h = target->height;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    int x = RandomBelow(seed, w + 32) - 16;
+    int y = RandomBelow(seed, h + 32) - 16;
+
+    target->fgColor = RandomInt32(seed);
+    DrawRectangle(target, x, y, 1 + RandomBelow(seed, 24),
+                  1 + RandomBelow(seed, 24));
+  }
+
+  target->fgColor = RandomInt32(seed);
+  DrawLine(target,
+           RandomBelow(seed, w), RandomBelow(seed, h),
+           RandomBelow(seed, w), RandomBelow(seed, h));
+
+  /* Now and then everything changes. */
+  if (RandomBelow(seed, 25) == 0) {
+    canvas->bgColor = RandomInt32(seed);
+    PixBufClear(canvas);
+  }
+}
+
+/*
+ * Each frame is converted into one of two bitmaps by C2PDirty (or
+ * C2PDeltaConvert) and the result is compared with full conversion of the
+ * same frame.  With erase objects of previous frame are removed by
+ * restoring the background with PixBufEraseDirty.  With view objects are
+ * drawn into a view not aligned to dirty blocks.
+ */
+static bool Check(const char *name, C2PFuncT convert, bool delta,
+                  PixBufT *background, bool view)
+{
+  static const RectT rect = { 37, 21, 200, 150 };
+  PixBufT *canvas = NewPixBuf(PIXBUF_GRAY, WIDTH, HEIGHT);
+  PixBufT *target = view ? NewPixBufView(canvas, &rect) : canvas;
+  struct BitMap *screen[2] = {
+    NewC2PBitMap(WIDTH, HEIGHT), NewC2PBitMap(WIDTH, HEIGHT)
+  };
+  struct BitMap *expected = NewC2PBitMap(WIDTH, HEIGHT);
+  C2PDeltaT *c2p = NewC2PDelta(WIDTH, HEIGHT);
+  size_t total = 0;
+  int errors = 0;
+  int seed = 0x3c2f01;
+  int i;
+
+  if (background)
+    PixBufCopy(canvas, background);
+
+  if (!delta)
+    PixBufEnableDirty(canvas);
+
+  for (i = 0; i < FRAMES; i++) {
+    if (background)
+      PixBufEraseDirty(canvas, background);
+
+    DrawFrame(canvas, target, &seed);
+
+    if (delta)
+      total += C2PDeltaConvert(c2p, canvas, screen[i & 1], convert);
+    else
+      total += C2PDirty(canvas, screen[i & 1], convert);
+    c2p1x1_8_ref(canvas->data, expected, WIDTH, HEIGHT, 0, 0);
+
+    if (!SamePlanes(screen[i & 1], expected))
+      errors++;
+  }
+
+  printf("%-15s %s, converted %d%% of %d bytes per frame\n",
+         name, errors ? "FAILED" : "ok",
+         (int)(total * 100 / (FRAMES * WIDTH * HEIGHT)), WIDTH * HEIGHT);
+
+  if (delta)
+    printf("%-15s skipped %d%% of 32-pixel groups\n", "",
+           (int)(c2p->skipped * 100 / c2p->groups));
+
+  MemUnref(c2p);
+
+  if (view)
+    MemUnref(target);
+
+  DeleteC2PBitMap(expected);
+  DeleteC2PBitMap(screen[1]);
+  DeleteC2PBitMap(screen[0]);
+  MemUnref(canvas);
+
+  return errors == 0;
+}
+
+int main() {
+  PixBufT *background = NewPixBuf(PIXBUF_GRAY, WIDTH, HEIGHT);
+  bool ok;
+  int i;
+
+  for (i = 0; i < WIDTH * HEIGHT; i++)
+    background->data[i] = (i / WIDTH) ^ (i % WIDTH);
+
+  ok = Check("dirty portable", c2p1x1_8_ref, false, NULL, false);
+  ok &= Check("dirty assembly", NULL, false, NULL, false);
+  ok &= Check("erase portable", c2p1x1_8_ref, false, background, false);
+  ok &= Check("erase assembly", NULL, false, background, false);
+  ok &= Check("view portable", c2p1x1_8_ref, false, background, true);
+  ok &= Check("delta portable", c2p1x1_8_ref, true, NULL, false);
+  ok &= Check("delta assembly", NULL, true, NULL, false);
+
+  MemUnref(background);
+
+  return ok ? 0 : 1;
+}
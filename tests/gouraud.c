@@ -0,0 +1,202 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "gfx/pixbuf.h"
+#include "gfx/triangle.h"
+#include "std/memory.h"
+#include "std/random.h"
+
+#define WIDTH 320
+#define HEIGHT 256
+
+typedef void (*DrawTriangleFuncT)(PixBufT *canvas, TriPointC *p1,
+                                  TriPointC *p2, TriPointC *p3);
+
+static float RandomCoord(int *r, float range) {
+  return (RandomInt32(r) & 0xffff) * range / 65536.0f;
+}
+
+/* Triangle with vertices close to each other, like those of a mesh. */
+static void RandomTriangle(int *r, TriPointC *p, bool smooth) {
+  float x = 32.0f + RandomCoord(r, WIDTH - 64);
+  float y = 32.0f + RandomCoord(r, HEIGHT - 64);
+  int i;
+
+  for (i = 0; i < 3; i++) {
+    p[i].x = x + RandomCoord(r, 60.0f) - 30.0f;
+    p[i].y = y + RandomCoord(r, 60.0f) - 30.0f;
+
+    if (smooth)
+      p[i].c = 127.5f + 127.0f * sinf(p[i].x / 50.0f) * cosf(p[i].y / 40.0f);
+    else
+      p[i].c = RandomCoord(r, 255.0f);
+  }
+}
+
+/*
+ * Canvas is drawn twice, over black and over white, so that pixels that were
+ * not touched can be told apart from those drawn with either color.
+ */
+static void Draw(DrawTriangleFuncT draw, PixBufT *black, PixBufT *white,
+                 TriPointC *p)
+{
+  TriPointC q[3];
+
+  memset(black->data, 0, WIDTH * HEIGHT);
+  memset(white->data, 255, WIDTH * HEIGHT);
+
+  memcpy(q, p, sizeof(q));
+  draw(black, &q[0], &q[1], &q[2]);
+  memcpy(q, p, sizeof(q));
+  draw(white, &q[0], &q[1], &q[2]);
+}
+
+static inline bool Covered(PixBufT *black, PixBufT *white, int i) {
+  return black->data[i] != 0 || white->data[i] != 255;
+}
+
+/* Color plane through the triangle, evaluated in double precision. */
+typedef struct Plane {
+  double x, y, c;
+  double dx, dy;
+  double cmin, cmax;
+} PlaneT;
+
+static bool MakePlane(PlaneT *plane, TriPointC *p) {
+  double x1 = p[1].x - p[0].x, y1 = p[1].y - p[0].y;
+  double x2 = p[2].x - p[0].x, y2 = p[2].y - p[0].y;
+  double c1 = p[1].c - p[0].c, c2 = p[2].c - p[0].c;
+  double det = x1 * y2 - x2 * y1;
+
+  if (det == 0.0)
+    return false;
+
+  plane->x = p[0].x;
+  plane->y = p[0].y;
+  plane->c = p[0].c;
+  plane->dx = (c1 * y2 - c2 * y1) / det;
+  plane->dy = (c2 * x1 - c1 * x2) / det;
+  plane->cmin = min(p[0].c, min(p[1].c, p[2].c));
+  plane->cmax = max(p[0].c, max(p[1].c, p[2].c));
+
+  return true;
+}
+
+/* Pixel (x, y) is sampled at (x, y + 0.5), like DrawTriangleC does. */
+static int PlaneColor(PlaneT *plane, int x, int y) {
+  double c = plane->c + plane->dx * (x - plane->x) +
+             plane->dy * (y + 0.5 - plane->y);
+
+  return (c < 0.0) ? 0 : (c >= 256.0) ? 255 : (int)c;
+}
+
+/* True if the widest span of the triangle is narrower than a pixel. */
+static bool IsSliver(TriPointC *p) {
+  TriPointC *p1 = &p[0], *p2 = &p[1], *p3 = &p[2];
+  float t;
+
+  if (p1->y > p2->y)
+    swapr(p1, p2);
+  if (p1->y > p3->y)
+    swapr(p1, p3);
+  if (p2->y > p3->y)
+    swapr(p2, p3);
+
+  if (p3->y == p1->y)
+    return true;
+
+  t = (p2->y - p1->y) / (p3->y - p1->y);
+
+  return fabsf(p2->x - (p1->x + (p3->x - p1->x) * t)) < 1.0f;
+}
+
+/*
+ * Reference is the exact color plane of each triangle.  Every pixel drawn by
+ * DrawTriangleC must be within one shade of it.  Slivers are an exception:
+ * the plane is so steep there that half a pixel off the edge it gives any
+ * color, so their pixels must only stay within the colors of the vertices.
+ *
+ * The original floating point filler (DrawTriangleCF) is measured against the
+ * same reference, and coverage of both fillers is compared.
+ */
+int main() {
+  PixBufT *fixedBlack = NewPixBuf(PIXBUF_GRAY, WIDTH, HEIGHT);
+  PixBufT *fixedWhite = NewPixBuf(PIXBUF_GRAY, WIDTH, HEIGHT);
+  PixBufT *floatBlack = NewPixBuf(PIXBUF_GRAY, WIDTH, HEIGHT);
+  PixBufT *floatWhite = NewPixBuf(PIXBUF_GRAY, WIDTH, HEIGHT);
+  int triangles = 2000;
+  int pixels = 0, sliverPixels = 0, coverage = 0;
+  int fixedErrors = 0, sliverErrors = 0, floatErrors = 0, floatPixels = 0;
+  int maxDiff = 0;
+  int r = 0x7a11c0de;
+  int k, i;
+
+  for (k = 0; k < triangles; k++) {
+    TriPointC p[3];
+    PlaneT plane;
+    bool sliver;
+
+    RandomTriangle(&r, p, k & 1);
+
+    if (!MakePlane(&plane, p))
+      continue;
+
+    sliver = IsSliver(p);
+
+    Draw(DrawTriangleC, fixedBlack, fixedWhite, p);
+    Draw(DrawTriangleCF, floatBlack, floatWhite, p);
+
+    for (i = 0; i < WIDTH * HEIGHT; i++) {
+      bool fixedCovered = Covered(fixedBlack, fixedWhite, i);
+      bool floatCovered = Covered(floatBlack, floatWhite, i);
+      int exact = PlaneColor(&plane, i % WIDTH, i / WIDTH);
+
+      if (fixedCovered != floatCovered)
+        coverage++;
+
+      if (floatCovered && !sliver) {
+        floatPixels++;
+        if (abs(floatBlack->data[i] - exact) > 1)
+          floatErrors++;
+      }
+
+      if (!fixedCovered)
+        continue;
+
+      if (sliver) {
+        int c = fixedBlack->data[i];
+
+        sliverPixels++;
+        if (c < (int)plane.cmin - 1 || c > (int)plane.cmax + 1)
+          sliverErrors++;
+      } else {
+        int diff = abs(fixedBlack->data[i] - exact);
+
+        pixels++;
+        if (diff > 1)
+          fixedErrors++;
+        if (diff > maxDiff)
+          maxDiff = diff;
+      }
+    }
+  }
+
+  printf("DrawTriangleC vs exact color plane: %d triangles, %d pixels.\n",
+         triangles, pixels);
+  printf("Shade differs by more than one: %d pixels (max %d), %s\n",
+         fixedErrors, maxDiff, fixedErrors ? "FAILED" : "ok");
+  printf("Sliver pixels outside of vertex colors: %d of %d, %s\n",
+         sliverErrors, sliverPixels, sliverErrors ? "FAILED" : "ok");
+  printf("DrawTriangleCF differs by more than one: %d of %d pixels.\n",
+         floatErrors, floatPixels);
+  printf("Coverage of DrawTriangleC and DrawTriangleCF differs: %d pixels.\n",
+         coverage);
+
+  MemUnref(floatWhite);
+  MemUnref(floatBlack);
+  MemUnref(fixedWhite);
+  MemUnref(fixedBlack);
+
+  return (fixedErrors || sliverErrors) ? 1 : 0;
+}
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "engine/collision.h"
+#include "engine/hashgrid.h"
+#include "std/memory.h"
+#include "std/random.h"
+
+#define POINTS 1000
+#define RADIUS 0.8f
+
+static Vector3D Point[POINTS];
+static Vector3D After[POINTS];
+
+static bool IsWithin(Vector3D *a, Vector3D *b, float radius) {
+  float dx = a->x - b->x;
+  float dy = a->y - b->y;
+  float dz = a->z - b->z;
+
+  return dx * dx + dy * dy + dz * dz < radius * radius;
+}
+
+typedef struct PairCheck {
+  uint8_t *seen;
+  int pairs, errors;
+} PairCheckT;
+
+/* Each pair must be close enough and reported only once, in order. */
+static void CheckPair(PtrT data, size_t i, size_t j) {
+  PairCheckT *check = (PairCheckT *)data;
+  size_t bit = i * POINTS + j;
+
+  if (i >= j || !IsWithin(&Point[i], &Point[j], RADIUS) ||
+      (check->seen[bit >> 3] & (1 << (bit & 7))))
+    check->errors++;
+
+  check->seen[bit >> 3] |= 1 << (bit & 7);
+  check->pairs++;
+}
+
+static int TestForEachPair(HashGridT *grid) {
+  PairCheckT check = { NewTable(uint8_t, POINTS * POINTS / 8), 0, 0 };
+  int expected = 0;
+  int i, j;
+
+  HashGridForEachPair(grid, RADIUS, CheckPair, &check);
+
+  for (i = 0; i < POINTS; i++)
+    for (j = i + 1; j < POINTS; j++)
+      if (IsWithin(&Point[i], &Point[j], RADIUS))
+        expected++;
+
+  printf("HashGridForEachPair: %d of %d pairs, %d wrong, %s\n",
+         check.pairs, expected, check.errors,
+         (check.pairs != expected || check.errors) ? "FAILED" : "ok");
+
+  MemUnref(check.seen);
+
+  return check.pairs != expected || check.errors;
+}
+
+static int TestQuery(HashGridT *grid, Vector3D *center, float radius,
+                     size_t maxResults)
+{
+  uint32_t result[POINTS];
+  bool *expected = NewTable(bool, POINTS);
+  size_t hits, found = 0, errors = 0;
+  size_t i;
+
+  for (i = 0; i < POINTS; i++) {
+    expected[i] = IsWithin(&Point[i], center, radius);
+    if (expected[i])
+      found++;
+  }
+
+  hits = HashGridQuery(grid, center, radius, result, maxResults);
+
+  for (i = 0; i < min(hits, maxResults); i++) {
+    if (!expected[result[i]])
+      errors++;
+    expected[result[i]] = false;
+  }
+
+  printf("HashGridQuery (radius %.1f, max %d): %d of %d hits, "
+         "%d wrong, %s\n", radius, (int)maxResults, (int)hits, (int)found,
+         (int)errors, (hits != found || errors) ? "FAILED" : "ok");
+
+  MemUnref(expected);
+
+  return hits != found || errors;
+}
+
+static int TestCollide(HashGridT *grid, CollisionActorT *actor,
+                       Vector3D *center, float radius, size_t maxResults)
+{
+  uint32_t result[POINTS];
+  bool *expected = NewTable(bool, POINTS);
+  size_t hits, found = 0, errors = 0;
+  size_t i;
+
+  for (i = 0; i < POINTS; i++) {
+    expected[i] = IsWithin(&Point[i], center, radius) &&
+                  DetectCollision(actor, &Point[i], &After[i]);
+    if (expected[i])
+      found++;
+  }
+
+  hits = HashGridCollide(grid, actor, center, radius, After,
+                         result, maxResults);
+
+  for (i = 0; i < min(hits, maxResults); i++) {
+    if (!expected[result[i]])
+      errors++;
+    expected[result[i]] = false;
+  }
+
+  printf("HashGridCollide (radius %.1f, max %d): %d of %d hits, "
+         "%d wrong, %s\n", radius, (int)maxResults, (int)hits, (int)found,
+         (int)errors, (hits != found || errors) ? "FAILED" : "ok");
+
+  MemUnref(expected);
+
+  return hits != found || errors;
+}
+
+int main() {
+  HashGridT *grid = NewHashGrid(1.0f, 256);
+  SphereT sphere = { { 0.5f, -0.5f, 0.25f }, 3.0f };
+  Vector3D side = { 3.5f, -0.5f, 0.25f };
+  CollisionActorT actor;
+  int32_t r = 0xdeadbeef;
+  int i, failed = 0;
+
+  /* Points on both sides of zero, so negative cell coordinates are used. */
+  for (i = 0; i < POINTS; i++) {
+    Point[i].x = RandomFloat(&r) * 12.0f - 6.0f;
+    Point[i].y = RandomFloat(&r) * 12.0f - 6.0f;
+    Point[i].z = RandomFloat(&r) * 12.0f - 6.0f;
+    After[i].x = Point[i].x + RandomFloat(&r) - 0.5f;
+    After[i].y = Point[i].y + RandomFloat(&r) - 0.5f;
+    After[i].z = Point[i].z + RandomFloat(&r) - 0.5f;
+  }
+
+  HashGridBuild(grid, Point, POINTS);
+
+  failed |= TestForEachPair(grid);
+
+  /* Small radius visits buckets, large one falls back to linear scan. */
+  failed |= TestQuery(grid, &side, 1.5f, POINTS);
+  failed |= TestQuery(grid, &sphere.center, 4.0f, POINTS);
+  failed |= TestQuery(grid, &side, 1.5f, 2);
+  failed |= TestQuery(grid, &sphere.center, 4.0f, 4);
+
+  SphereActorInit(&actor, &sphere);
+
+  failed |= TestCollide(grid, &actor, &side, 1.5f, POINTS);
+  failed |= TestCollide(grid, &actor, &sphere.center, 4.0f, POINTS);
+  failed |= TestCollide(grid, &actor, &sphere.center, 4.0f, 4);
+
+  MemUnref(grid);
+
+  return failed;
+}
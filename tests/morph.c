@@ -0,0 +1,154 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "engine/mesh.h"
+#include "engine/morph.h"
+#include "std/memory.h"
+#include "std/random.h"
+
+#define SIZE 16
+#define TARGETS 3
+
+/* Flat grid of SIZE x SIZE vertices split into triangles. */
+static MeshT *NewGridMesh() {
+  MeshT *mesh = NewMesh(SIZE * SIZE, (SIZE - 1) * (SIZE - 1) * 2, 1);
+  int x, y, i = 0;
+
+  for (y = 0; y < SIZE; y++)
+    for (x = 0; x < SIZE; x++) {
+      mesh->vertex[y * SIZE + x].x = x;
+      mesh->vertex[y * SIZE + x].y = y;
+    }
+
+  for (y = 0; y < SIZE - 1; y++)
+    for (x = 0; x < SIZE - 1; x++) {
+      int p = y * SIZE + x;
+
+      mesh->polygon[i].p[0] = p;
+      mesh->polygon[i].p[1] = p + 1;
+      mesh->polygon[i].p[2] = p + SIZE;
+      i++;
+      mesh->polygon[i].p[0] = p + 1;
+      mesh->polygon[i].p[1] = p + SIZE + 1;
+      mesh->polygon[i].p[2] = p + SIZE;
+      i++;
+    }
+
+  CalculateSurfaceNormals(mesh);
+  CalculateVertexToPolygonMap(mesh);
+  CalculateVertexNormals(mesh);
+
+  return mesh;
+}
+
+/* Each target moves a random subset of vertices, some of them shared. */
+static Vector3D *NewShape(MeshT *mesh, int32_t *r) {
+  Vector3D *shape = MemClone(mesh->vertex);
+  size_t i;
+
+  for (i = 0; i < mesh->vertexNum; i++) {
+    if (RandomInt32(r) & 3)
+      continue;
+
+    shape[i].x += RandomFloat(r) - 0.5f;
+    shape[i].y += RandomFloat(r) - 0.5f;
+    shape[i].z += RandomFloat(r) * 4.0f - 2.0f;
+  }
+
+  return shape;
+}
+
+/* Blends all vertices of all targets, ignoring the sparse representation. */
+static float Compare(MorphStateT *state, Vector3D **shape) {
+  MeshT *mesh = state->mesh;
+  float error = 0.0f;
+  size_t i, j;
+
+  for (i = 0; i < mesh->vertexNum; i++) {
+    Vector3D v = mesh->vertex[i];
+
+    for (j = 0; j < mesh->morphNum; j++) {
+      float w = state->weight[j];
+
+      v.x += (shape[j][i].x - mesh->vertex[i].x) * w;
+      v.y += (shape[j][i].y - mesh->vertex[i].y) * w;
+      v.z += (shape[j][i].z - mesh->vertex[i].z) * w;
+    }
+
+    error = max(error, fabsf(v.x - state->vertex[i].x));
+    error = max(error, fabsf(v.y - state->vertex[i].y));
+    error = max(error, fabsf(v.z - state->vertex[i].z));
+  }
+
+  return error;
+}
+
+/* Weights must stay within [0, 1] and sum to at most one. */
+static bool CheckWeights(MorphStateT *state) {
+  float sum = 0.0f;
+  size_t i;
+
+  for (i = 0; i < state->mesh->morphNum; i++) {
+    float w = state->weight[i];
+
+    if (w < 0.0f || w > 1.0f)
+      return false;
+
+    sum += w;
+  }
+
+  return sum <= 1.0f + 1e-6f;
+}
+
+int main() {
+  MeshT *mesh = NewGridMesh();
+  Vector3D *shape[TARGETS];
+  MorphStateT *state;
+  float error = 0.0f;
+  int32_t r = 0x5eed1234;
+  int badWeights = 0;
+  int i, frames = 0;
+
+  for (i = 0; i < TARGETS; i++) {
+    shape[i] = NewShape(mesh, &r);
+    MeshAddMorphTarget(mesh, "target", shape[i]);
+  }
+
+  state = NewMorphState(mesh);
+
+  /* Keyframes, including ones out of range on both sides. */
+  for (i = -8; i <= (TARGETS + 2) * 4; i++) {
+    MorphStateSetKeyframe(state, i * 0.25f + 0.125f);
+    MorphStateUpdate(state);
+
+    if (!CheckWeights(state))
+      badWeights++;
+
+    error = max(error, Compare(state, shape));
+    frames++;
+  }
+
+  /* Arbitrary weights, changing only some of the targets at a time. */
+  for (i = 0; i < 100; i++) {
+    state->weight[RandomInt32(&r) & 1] = RandomFloat(&r);
+    state->weight[2] = (i & 4) ? RandomFloat(&r) : 0.0f;
+    MorphStateUpdate(state);
+
+    error = max(error, Compare(state, shape));
+    frames++;
+  }
+
+  printf("MorphStateUpdate vs dense blend: %d frames, %d vertices moved.\n",
+         frames, (int)state->movedNum);
+  printf("Keyframe weights out of range: %d, %s\n", badWeights,
+         badWeights ? "FAILED" : "ok");
+  printf("Maximum vertex error: %g, %s\n", error,
+         (error > 1e-4f) ? "FAILED" : "ok");
+
+  for (i = 0; i < TARGETS; i++)
+    MemUnref(shape[i]);
+  MemUnref(state);
+  MemUnref(mesh);
+
+  return (badWeights || error > 1e-4f) ? 1 : 0;
+}
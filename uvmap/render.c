@@ -34,73 +34,111 @@ static void RenderNormalUVMap(UVMapT *map, uint8_t *dst asm("a6")) {
 }
 #endif
 
-static void RenderAccurateUVMap(UVMapT *map, uint8_t *dst asm("a6")) {
+static void RenderAccurateUVMap(UVMapT *map, PixBufT *canvas) {
   FP16 *mapU = map->map.accurate.u;
   FP16 *mapV = map->map.accurate.v;
   PixBufT *texture = map->texture;
+  uint8_t *dst = canvas->data;
   int16_t offsetU = map->offsetV;
   int16_t offsetV = map->offsetU;
   int16_t textureW = map->textureW;
   int16_t textureH = map->textureH;
-  int n = map->width * map->height;
+  int y = map->height;
 
   do {
-    FP16 u = *mapU++;
-    FP16 v = *mapV++;
+    int x = map->width;
 
-    FP16_i(u) += offsetU;
-    FP16_f(v) += offsetV;
+    do {
+      FP16 u = *mapU++;
+      FP16 v = *mapV++;
 
-    if (FP16_i(u) < 0)
-      FP16_i(u) += textureW;
-    if (FP16_i(u) >= textureW)
-      FP16_i(u) -= textureW;
+      FP16_i(u) += offsetU;
+      FP16_f(v) += offsetV;
 
-    if (FP16_i(v) < 0)
-      FP16_i(v) += textureH;
-    if (FP16_i(v) >= textureH)
-      FP16_i(v) -= textureH;
+      if (FP16_i(u) < 0)
+        FP16_i(u) += textureW;
+      if (FP16_i(u) >= textureW)
+        FP16_i(u) -= textureW;
 
-    *dst++ = GetFilteredPixel(texture, u, v);
-  } while (--n);
+      if (FP16_i(v) < 0)
+        FP16_i(v) += textureH;
+      if (FP16_i(v) >= textureH)
+        FP16_i(v) -= textureH;
+
+      *dst++ = GetFilteredPixel(texture, u, v);
+    } while (--x);
+
+    dst += canvas->stride - map->width;
+  } while (--y);
+}
+
+/*
+ * Optimized renderers go through the map in one run.  If canvas is a view,
+ * they're called once per row, with pointers moved to the next row between
+ * calls.
+ */
+static inline void NextRow(UVMapRendererT *renderer, PixBufT *canvas,
+                           size_t elemSize)
+{
+  size_t n = renderer->mapSize;
+
+  renderer->mapU = (uint8_t *)renderer->mapU + n * elemSize;
+  renderer->mapV = (uint8_t *)renderer->mapV + n * elemSize;
+  renderer->pixmap += canvas->stride;
+  if (renderer->lightMap)
+    renderer->lightMap += n;
 }
 
 void UVMapRender(UVMapT *map, PixBufT *canvas) {
+  int rows = PixBufIsContiguous(canvas) ? 1 : map->height;
   UVMapRendererT renderer = {
     .mapU = map->map.fast.u,
     .mapV = map->map.fast.v,
     .texture = map->texture->data,
     .pixmap = canvas->data,
-    .mapSize = map->width * map->height,
+    .mapSize = map->width * map->height / rows,
     .offset = ((map->offsetU & 255) << 8) | (map->offsetV & 255)
   };
 
   ASSERT(map->texture, "No texture attached.");
 
+  PixBufMarkDirty(canvas, 0, 0, map->width, map->height);
+
   if (map->type == UV_FAST) {
     if (map->lightMap) {
       renderer.lightMap = map->lightMap->data;
       renderer.colorMap = map->lightMap->blit.cmap;
-      RenderFastUVMapWithLightOptimized(&renderer);
+
+      do {
+        RenderFastUVMapWithLightOptimized(&renderer);
+        NextRow(&renderer, canvas, sizeof(uint8_t));
+      } while (--rows);
     } else {
-      RenderFastUVMapOptimized(&renderer);
+      do {
+        RenderFastUVMapOptimized(&renderer);
+        NextRow(&renderer, canvas, sizeof(uint8_t));
+      } while (--rows);
     }
   } else if (map->type == UV_NORMAL) {
-    RenderNormalUVMapOptimized(&renderer);
+    do {
+      RenderNormalUVMapOptimized(&renderer);
+      NextRow(&renderer, canvas, sizeof(int16_t));
+    } while (--rows);
   } else if (map->type == UV_ACCURATE) {
-    RenderAccurateUVMap(map, canvas->data);
+    RenderAccurateUVMap(map, canvas);
   }
 }
 
 void UVMapComposeAndRender(UVMapT *map, PixBufT *canvas, PixBufT *composeMap,
                            uint8_t index)
 {
+  int rows = PixBufIsContiguous(canvas) ? 1 : map->height;
   UVMapRendererT renderer = {
     .mapU = map->map.fast.u,
     .mapV = map->map.fast.v,
     .texture = map->texture->data,
     .pixmap = canvas->data,
-    .mapSize = map->width * map->height,
+    .mapSize = map->width * map->height / rows,
     .offset = ((map->offsetU & 255) << 8) | (map->offsetV & 255),
     .colorMap = composeMap->data,
     .colorIndex = index
@@ -108,5 +146,11 @@ void UVMapComposeAndRender(UVMapT *map, PixBufT *canvas, PixBufT *composeMap,
 
   ASSERT(map->type == UV_FAST, "Source map must be fast.");
 
-  UVMapComposeAndRenderOptimized(&renderer);
+  PixBufMarkDirty(canvas, 0, 0, map->width, map->height);
+
+  do {
+    UVMapComposeAndRenderOptimized(&renderer);
+    NextRow(&renderer, canvas, sizeof(uint8_t));
+    renderer.colorMap += renderer.mapSize;
+  } while (--rows);
 }